@@ -0,0 +1,250 @@
+// allocator.h
+// Description: A size class pooled cv::MatAllocator that recycles Mat buffers through per-thread arenas so steady state processing does not hit malloc,
+//              along with per-thread counts of the heap allocations of the pool and of the calls to the global operator new for the allocations the pool does not cover
+// Assumptions: Mats are short lived and the images of a dataset have similar sizes, so freed buffers are soon needed again by the same thread
+
+#ifndef MAIN_ALLOCATOR_H
+#define MAIN_ALLOCATOR_H
+
+// Import the necessary libraries for opencv
+#include <new>
+#include <atomic>
+#include <cstdlib>
+#include <vector>
+#include <opencv2/core.hpp>
+
+// Declaring the namespaces that would be used throughout the program
+// We can use 2 namespaces as long as there aren't any conflicts
+using namespace std;
+using namespace cv;
+
+// Size classes are powers of two from 64 bytes up to 64 MB; bigger buffers bypass the pool
+const int MIN_SIZE_CLASS_SHIFT = 6;
+const int SIZE_CLASSES = 21;
+// Number of free buffers kept per size class and thread before they are returned to the system
+const size_t MAX_FREE_BUFFERS = 32;
+// Bytes of free buffers kept per thread before they are returned to the system, so a few large images do not pin hundreds of megabytes per thread
+const size_t MAX_ARENA_BYTES = size_t(256) << 20;
+// Images processed before the heap allocations are counted, so the pool has seen the size classes of more than one image
+const int ALLOCATION_WARM_UP_IMAGES = 16;
+
+// Number of calls to the global operator new made by the thread, by the containers and strings of the program and of OpenCV alike,
+// apart from those made within a LibraryAllocations scope, which are counted on their own
+// Memory OpenCV takes straight from malloc or fastMalloc outside of Mats (e.g. its AutoBuffers) is not counted
+thread_local long long thread_new_calls = 0, thread_library_new_calls = 0;
+thread_local int library_allocation_depth = 0;
+
+// Counts the calls to operator new made during its lifetime as OpenCV's own, for the OpenCV calls that build internal objects on every call
+// (the codec objects of imread and imdecode, and the candidate lists of detectMultiScale), which no buffer kept by the program can avoid
+struct LibraryAllocations {
+	LibraryAllocations() { library_allocation_depth += 1; }
+	~LibraryAllocations() { library_allocation_depth -= 1; }
+	LibraryAllocations(const LibraryAllocations&) = delete;
+	LibraryAllocations& operator=(const LibraryAllocations&) = delete;
+};
+
+// Counts a call to operator new against the calling thread
+void countNewCall() {
+	if (library_allocation_depth > 0) {
+		thread_library_new_calls += 1;
+	}
+	else {
+		thread_new_calls += 1;
+	}
+}
+
+// The global operator new and delete are replaced so every call can be counted; the memory itself still comes from malloc
+void* operator new(size_t size) {
+	countNewCall();
+	if (void* memory = malloc(size == 0 ? 1 : size)) {
+		return memory;
+	}
+	throw bad_alloc();
+}
+
+void* operator new(size_t size, align_val_t alignment) {
+	countNewCall();
+	// aligned_alloc expects a size that is a multiple of the alignment
+	const size_t ALIGNMENT = size_t(alignment);
+	if (void* memory = aligned_alloc(ALIGNMENT, (size + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT + (size == 0 ? ALIGNMENT : 0))) {
+		return memory;
+	}
+	throw bad_alloc();
+}
+
+void operator delete(void* memory) noexcept { free(memory); }
+
+void operator delete(void* memory, size_t) noexcept { free(memory); }
+
+void operator delete(void* memory, align_val_t) noexcept { free(memory); }
+
+void operator delete(void* memory, size_t, align_val_t) noexcept { free(memory); }
+
+// Returns the size class of a buffer, or SIZE_CLASSES if it is too big to be pooled
+int sizeClass(const size_t SIZE) {
+	int size_class = 0;
+	while (size_class < SIZE_CLASSES && (size_t(1) << (size_class + MIN_SIZE_CLASS_SHIFT)) < SIZE) {
+		size_class += 1;
+	}
+	return size_class;
+}
+
+// Free buffers and UMatData headers owned by one thread, along with the bytes held by the free buffers
+// Buffers freed by another thread than the one that allocated them simply join the arena of the freeing thread
+struct PoolArena {
+	vector<void*> free_buffers[SIZE_CLASSES];
+	vector<void*> free_headers;
+	size_t free_bytes = 0;
+
+	~PoolArena();
+};
+
+// Set once the arena of the thread is destroyed so Mats released during thread or program shutdown go straight to the system
+thread_local bool pool_arena_destroyed = false;
+thread_local PoolArena pool_arena;
+// Number of times the pool of the thread was empty and memory had to be requested from the system
+thread_local long long thread_heap_allocations = 0;
+
+PoolArena::~PoolArena() {
+	for (auto &buffers: free_buffers) {
+		for (void* buffer: buffers) {
+			fastFree(buffer);
+		}
+	}
+	for (void* header: free_headers) {
+		::operator delete(header);
+	}
+	pool_arena_destroyed = true;
+}
+
+// Mat allocator handing out pooled buffers and counting how often it had to go to the heap
+// Works like the default cv::StdMatAllocator apart from where the memory comes from
+class PooledMatAllocator : public MatAllocator {
+public:
+	UMatData* allocate(int dims, const int* sizes, int type, void* data0, size_t* step, AccessFlag /*flags*/, UMatUsageFlags /*usageFlags*/) const override {
+		// Computing the steps and total size the same way the default allocator does
+		size_t total = CV_ELEM_SIZE(type);
+		for (int i = dims - 1; i >= 0; i--) {
+			if (step) {
+				if (data0 && step[i] != CV_AUTOSTEP) {
+					CV_Assert(total <= step[i]);
+					total = step[i];
+				}
+				else {
+					step[i] = total;
+				}
+			}
+			total *= sizes[i];
+		}
+
+		allocations += 1;
+		UMatData* u = new (takeHeader()) UMatData(this);
+		u->size = total;
+		if (data0) {
+			u->data = u->origdata = (uchar*)data0;
+			u->flags |= UMatData::USER_ALLOCATED;
+		}
+		else {
+			u->data = u->origdata = (uchar*)takeBuffer(total);
+		}
+		return u;
+	}
+
+	bool allocate(UMatData* u, AccessFlag /*accessFlags*/, UMatUsageFlags /*usageFlags*/) const override {
+		return u != nullptr;
+	}
+
+	void deallocate(UMatData* u) const override {
+		if (!u) {
+			return;
+		}
+		CV_Assert(u->urefcount == 0);
+		CV_Assert(u->refcount == 0);
+		if (!(u->flags & UMatData::USER_ALLOCATED)) {
+			giveBuffer(u->origdata, u->size);
+			u->origdata = nullptr;
+		}
+		u->~UMatData();
+		giveHeader(u);
+	}
+
+	// Number of Mats allocated through this allocator
+	long long allocationCount() const { return allocations; }
+
+	// Number of times the pool was empty and memory had to be requested from the system, by any thread
+	// Only Mat buffers and their headers are counted; other heap allocations show up in thread_new_calls
+	long long heapAllocationCount() const { return heap_allocations; }
+
+	// Number of times the pool was empty and memory had to be requested from the system, by the calling thread
+	long long threadHeapAllocationCount() const { return thread_heap_allocations; }
+
+private:
+	void* takeBuffer(const size_t SIZE) const {
+		const int SIZE_CLASS = sizeClass(SIZE);
+		if (SIZE_CLASS < SIZE_CLASSES && !pool_arena_destroyed) {
+			vector<void*>& buffers = pool_arena.free_buffers[SIZE_CLASS];
+			if (!buffers.empty()) {
+				void* buffer = buffers.back();
+				buffers.pop_back();
+				pool_arena.free_bytes -= classBytes(SIZE_CLASS);
+				return buffer;
+			}
+			countHeapAllocation();
+			return fastMalloc(classBytes(SIZE_CLASS));
+		}
+		countHeapAllocation();
+		return fastMalloc(SIZE);
+	}
+
+	void giveBuffer(void* buffer, const size_t SIZE) const {
+		const int SIZE_CLASS = sizeClass(SIZE);
+		if (SIZE_CLASS < SIZE_CLASSES && !pool_arena_destroyed && pool_arena.free_buffers[SIZE_CLASS].size() < MAX_FREE_BUFFERS
+		    && pool_arena.free_bytes + classBytes(SIZE_CLASS) <= MAX_ARENA_BYTES) {
+			pool_arena.free_buffers[SIZE_CLASS].push_back(buffer);
+			pool_arena.free_bytes += classBytes(SIZE_CLASS);
+		}
+		else {
+			fastFree(buffer);
+		}
+	}
+
+	void* takeHeader() const {
+		if (!pool_arena_destroyed && !pool_arena.free_headers.empty()) {
+			void* header = pool_arena.free_headers.back();
+			pool_arena.free_headers.pop_back();
+			return header;
+		}
+		countHeapAllocation();
+		return ::operator new(sizeof(UMatData));
+	}
+
+	void giveHeader(void* header) const {
+		if (!pool_arena_destroyed && pool_arena.free_headers.size() < MAX_FREE_BUFFERS * SIZE_CLASSES) {
+			pool_arena.free_headers.push_back(header);
+		}
+		else {
+			::operator delete(header);
+		}
+	}
+
+	static size_t classBytes(const int SIZE_CLASS) { return size_t(1) << (SIZE_CLASS + MIN_SIZE_CLASS_SHIFT); }
+
+	void countHeapAllocation() const {
+		heap_allocations += 1;
+		thread_heap_allocations += 1;
+	}
+
+	mutable atomic<long long> allocations{0}, heap_allocations{0};
+};
+
+// Returns the allocator shared by the whole program
+// The allocator is never destroyed since Mats held by OpenCV internals can be released after main returns
+// Parameters: N/A
+// Pre-condition:  N/A
+// Post-condition: The same allocator object is returned on every call
+PooledMatAllocator& pooledMatAllocator() {
+	static PooledMatAllocator* allocator = new PooledMatAllocator();
+	return *allocator;
+}
+
+#endif //MAIN_ALLOCATOR_H
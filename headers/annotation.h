@@ -0,0 +1,168 @@
+// annotation.h
+// Description: Writes images annotated with the detected face, eye, and oronasal boxes and the mask decisions to a directory, for headless visual auditing
+// Assumptions: Auditing must not slow the detection down, so the drawing and JPEG encoding run on a small pool of encoder threads and images are dropped when the pool falls behind
+
+#ifndef MAIN_ANNOTATION_H
+#define MAIN_ANNOTATION_H
+
+// Import the necessary libraries for opencv, i/o, and threading
+#include <atomic>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+#include "headers/concurrency.h"
+#include "headers/config.h"
+#include "headers/logger.h"
+#include "headers/results.h"
+
+// Declaring the namespaces that would be used throughout the program
+// We can use 2 namespaces as long as there aren't any conflicts
+using namespace std;
+using namespace cv;
+
+// Number of encoder threads and images waiting for them
+const int ANNOTATION_THREADS = 2;
+const size_t ANNOTATION_QUEUE_SIZE = 32;
+
+// Returns whether the results of an image disagree with its ground truth
+// Parameters:
+//          RESULT:             Results of the image
+//          WITH_MASK:          Whether the faces in the image wear masks
+//          GROUND_TRUTH_FACES: Number of faces in the image
+// Pre-condition:  N/A
+// Post-condition: Returns true if a face was missed or skipped, or a face got the wrong decision
+bool isFailure(const ImageResult& RESULT, const bool WITH_MASK, const int GROUND_TRUTH_FACES) {
+	if (int(RESULT.faces.size()) != GROUND_TRUTH_FACES || RESULT.counts.eyes_skipped > 0) {
+		return true;
+	}
+	return WITH_MASK ? RESULT.counts.not_masked > 0 : RESULT.counts.masked > 0;
+}
+
+// Draws the face, eye, and oronasal boxes and the decision of every face on an image
+// Parameters:
+//          image:  The image to draw on
+//          RESULT: Results of the image
+// Pre-condition:  The results were computed on this image
+// Post-condition: The boxes and decisions are drawn on the image
+void drawAnnotations(Mat& image, const ImageResult& RESULT) {
+	const Scalar MASK_COLOR = Scalar(0, 255, 0);
+	const Scalar NO_MASK_COLOR = Scalar(0, 0, 255);
+	const Scalar SKIPPED_COLOR = Scalar(0, 255, 255);
+	const Scalar EYE_COLOR = Scalar(255, 0, 255);
+	const Scalar NOSE_MOUTH_COLOR = Scalar(0, 0, 0);
+	const int THICKNESS = 2;
+
+	for (auto &face: RESULT.faces) {
+		const Scalar FACE_COLOR = face.decision == Decision::MASK ? MASK_COLOR : face.decision == Decision::NO_MASK ? NO_MASK_COLOR : SKIPPED_COLOR;
+		const string LABEL = face.decision == Decision::MASK ? "Mask" : face.decision == Decision::NO_MASK ? "No mask" : "No eyes";
+		rectangle(image, face.face, FACE_COLOR, THICKNESS);
+		putText(image, LABEL, Point(face.face.x, max(face.face.y - 4, 12)), FONT_HERSHEY_SIMPLEX, 0.5, FACE_COLOR, 1);
+
+		// The regions are in the coordinates of the face
+		const EyeNoseMouthBox& REGION = face.region;
+		if (REGION.eyes_detected) {
+			const Point ORIGIN(face.face.x, face.face.y);
+			rectangle(image, ORIGIN + Point(REGION.left_x, REGION.eye_top_y), ORIGIN + Point(REGION.right_x, REGION.eye_bottom_nose_mouth_top_y), EYE_COLOR, 1);
+			rectangle(image, ORIGIN + Point(REGION.left_x, REGION.eye_bottom_nose_mouth_top_y), ORIGIN + Point(REGION.right_x, REGION.nose_mouth_bottom_y), NOSE_MOUTH_COLOR, 1);
+		}
+	}
+}
+
+// Samples processed images and writes annotated copies of them on a pool of encoder threads
+class AnnotationWriter {
+public:
+	// Parameters:
+	//          DIRECTORY: Directory receiving the annotated images (created if missing)
+	//          SAMPLING:  Which images get annotated
+	//          EVERY_N:   Sampling period for AnnotationSampling::EVERY_N
+	AnnotationWriter(const string& DIRECTORY, const AnnotationSampling SAMPLING, const int EVERY_N) : directory(DIRECTORY), sampling(SAMPLING), every_n(max(1, EVERY_N)), jobs(ANNOTATION_QUEUE_SIZE) {
+		if (sampling == AnnotationSampling::NONE) {
+			return;
+		}
+		filesystem::create_directories(directory);
+		for (int i = 0; i < ANNOTATION_THREADS; i++) {
+			encoders.emplace_back([this] { encodeLoop(); });
+		}
+	}
+
+	~AnnotationWriter() { finish(); }
+
+	// Waits for the queued images to be written and stops the encoder threads
+	// Pre-condition:  N/A
+	// Post-condition: Every queued image is written; later submissions are dropped
+	void finish() {
+		jobs.close();
+		for (auto &encoder: encoders) {
+			encoder.join();
+		}
+		encoders.clear();
+		if (dropped > 0) {
+			logger().log(LogLevel::WARNING, "annotations_dropped", {}, dropped.exchange(0), true);
+		}
+	}
+
+	// Queues an annotated copy of the image if it is sampled; never waits for the encoders
+	// Parameters:
+	//          IMAGE:              The processed image, which must not be modified afterwards
+	//          RESULT:             Results of the image
+	//          NAME:               File name of the annotated image
+	//          WITH_MASK:          Whether the faces in the image wear masks
+	//          GROUND_TRUTH_FACES: Number of faces in the image
+	// Pre-condition:  N/A
+	// Post-condition: The image is queued for writing, skipped by the sampling, or dropped if the encoders are busy
+	void submit(const Mat& IMAGE, const ImageResult& RESULT, const string& NAME, const bool WITH_MASK, const int GROUND_TRUTH_FACES) {
+		submitted += 1;
+		if (sampling == AnnotationSampling::NONE) {
+			return;
+		}
+		if (sampling == AnnotationSampling::EVERY_N && (submitted - 1) % every_n != 0) {
+			return;
+		}
+		if (sampling == AnnotationSampling::FAILURES && !isFailure(RESULT, WITH_MASK, GROUND_TRUTH_FACES)) {
+			return;
+		}
+		// The job shares the image buffer and the encoder draws on its own copy, unless the image only wraps external memory (e.g., a pixel cache mapping) that may go away first
+		const Mat IMAGE_BUFFER = IMAGE.u == nullptr ? IMAGE.clone() : IMAGE;
+		if (!jobs.tryPush({IMAGE_BUFFER, RESULT, (filesystem::path(directory) / NAME).string()})) {
+			dropped += 1;
+		}
+	}
+
+private:
+	struct Job {
+		Mat image;
+		ImageResult result;
+		string path;
+	};
+
+	void encodeLoop() {
+		Job job;
+		while (jobs.pop(job)) {
+			Mat annotated = job.image.clone();
+			drawAnnotations(annotated, job.result);
+			// A failed write only loses the annotation, so it must not stop the encoder
+			bool written = false;
+			try {
+				written = imwrite(job.path, annotated);
+			}
+			catch (const cv::Exception&) {}
+			if (!written) {
+				logger().log(LogLevel::WARNING, "annotation_write_failed", job.path);
+			}
+		}
+	}
+
+	const string directory;
+	const AnnotationSampling sampling;
+	const int every_n;
+	long long submitted = 0;
+	atomic<long long> dropped{0};
+	BoundedQueue<Job> jobs;
+	vector<thread> encoders;
+};
+
+#endif //MAIN_ANNOTATION_H
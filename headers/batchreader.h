@@ -0,0 +1,432 @@
+// batchreader.h
+// Description: Reads the encoded test images ahead of the detection, keeping a fixed number of reads in flight through io_uring or, where io_uring is unavailable, a pool of pread threads
+// Assumptions: The images are small enough to be read whole into memory; they are handed to the detection in the order their reads complete
+
+#ifndef MAIN_BATCHREADER_H
+#define MAIN_BATCHREADER_H
+
+// Import the necessary libraries for i/o and threading
+#include <cerrno>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#endif
+#include "headers/concurrency.h"
+#include "headers/imagesource.h"
+#include "headers/logger.h"
+
+// Declaring the namespaces that would be used throughout the program
+using namespace std;
+
+// Number of pread threads used when io_uring is unavailable
+const int READER_THREADS = 4;
+
+// Reads a whole file with pread, retrying short reads
+// Parameters:
+//          FD:     Open descriptor of the file
+//          buffer: Receives the file contents
+// Pre-condition:  N/A
+// Post-condition: Returns false if the file could not be read in full
+bool readWholeFile(const int FD, vector<char>& buffer) {
+	struct stat status;
+	if (fstat(FD, &status) != 0) {
+		return false;
+	}
+	buffer.resize(size_t(status.st_size));
+	size_t done = 0;
+	while (done < buffer.size()) {
+		const ssize_t BYTES = pread(FD, buffer.data() + done, buffer.size() - done, off_t(done));
+		if (BYTES < 0 && errno == EINTR) {
+			continue;
+		}
+		if (BYTES <= 0) {
+			return false;
+		}
+		done += size_t(BYTES);
+	}
+	return true;
+}
+
+#ifdef __linux__
+// A minimal io_uring set up directly through the system calls: one submission queue of vectored reads and its completion queue
+class IoUring {
+public:
+	// Parameters:
+	//          ENTRIES: Number of submission queue entries
+	explicit IoUring(const unsigned ENTRIES) {
+		io_uring_params params{};
+		ring_fd = int(syscall(__NR_io_uring_setup, ENTRIES, &params));
+		if (ring_fd < 0) {
+			return;
+		}
+		sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		// Newer kernels map both rings with a single mapping
+		const bool SINGLE_MMAP = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if (SINGLE_MMAP) {
+			sq_size = cq_size = max(sq_size, cq_size);
+		}
+		sq_ring = mmap(nullptr, sq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQ_RING);
+		cq_ring = SINGLE_MMAP ? sq_ring : mmap(nullptr, cq_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_CQ_RING);
+		sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+		void* sqes_address = mmap(nullptr, sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd, IORING_OFF_SQES);
+		// Keeping every mapping that succeeded, so release unmaps it even when another one failed
+		if (sqes_address != MAP_FAILED) {
+			sqes = static_cast<io_uring_sqe*>(sqes_address);
+		}
+		if (sq_ring == MAP_FAILED || cq_ring == MAP_FAILED || sqes == nullptr) {
+			release();
+			return;
+		}
+		char* sq = static_cast<char*>(sq_ring);
+		char* cq = static_cast<char*>(cq_ring);
+		sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+		sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+		sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+		cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+		cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+		cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+		cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+	}
+
+	IoUring(const IoUring&) = delete;
+	IoUring& operator=(const IoUring&) = delete;
+	~IoUring() { release(); }
+
+	bool valid() const { return sqes != nullptr; }
+
+	// Queues a vectored read; it is only handed to the kernel by the next call to submit
+	void queueRead(const int FD, const iovec* VECTOR, const unsigned long long OFFSET, const unsigned long long USER_DATA) {
+		const unsigned TAIL = *sq_tail;
+		const unsigned INDEX = TAIL & sq_mask;
+		io_uring_sqe& sqe = sqes[INDEX];
+		sqe = io_uring_sqe{};
+		sqe.opcode = IORING_OP_READV;
+		sqe.fd = FD;
+		sqe.addr = reinterpret_cast<unsigned long long>(VECTOR);
+		sqe.len = 1;
+		sqe.off = OFFSET;
+		sqe.user_data = USER_DATA;
+		sq_array[INDEX] = INDEX;
+		__atomic_store_n(sq_tail, TAIL + 1, __ATOMIC_RELEASE);
+		queued += 1;
+	}
+
+	// Hands the queued reads to the kernel and optionally waits until at least one read has completed
+	// Returns false if the kernel rejected the call
+	bool submit(const bool WAIT) {
+		while (true) {
+			const long RESULT = syscall(__NR_io_uring_enter, ring_fd, queued, WAIT ? 1 : 0, WAIT ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+			if (RESULT >= 0) {
+				queued -= unsigned(RESULT);
+				return true;
+			}
+			if (errno != EINTR) {
+				return false;
+			}
+		}
+	}
+
+	// Takes a completed read off the completion queue; returns false if none is waiting
+	bool complete(unsigned long long& user_data, int& result) {
+		const unsigned HEAD = *cq_head;
+		if (HEAD == __atomic_load_n(cq_tail, __ATOMIC_ACQUIRE)) {
+			return false;
+		}
+		const io_uring_cqe& CQE = cqes[HEAD & cq_mask];
+		user_data = CQE.user_data;
+		result = CQE.res;
+		__atomic_store_n(cq_head, HEAD + 1, __ATOMIC_RELEASE);
+		return true;
+	}
+
+private:
+	void release() {
+		if (sqes != nullptr) {
+			munmap(sqes, sqes_size);
+		}
+		if (cq_ring != nullptr && cq_ring != MAP_FAILED && cq_ring != sq_ring) {
+			munmap(cq_ring, cq_size);
+		}
+		if (sq_ring != nullptr && sq_ring != MAP_FAILED) {
+			munmap(sq_ring, sq_size);
+		}
+		if (ring_fd >= 0) {
+			close(ring_fd);
+		}
+		sqes = nullptr;
+		sq_ring = cq_ring = nullptr;
+		ring_fd = -1;
+	}
+
+	int ring_fd = -1;
+	void* sq_ring = nullptr;
+	void* cq_ring = nullptr;
+	size_t sq_size = 0, cq_size = 0, sqes_size = 0;
+	unsigned* sq_tail = nullptr;
+	unsigned* sq_array = nullptr;
+	unsigned sq_mask = 0;
+	io_uring_sqe* sqes = nullptr;
+	unsigned* cq_head = nullptr;
+	unsigned* cq_tail = nullptr;
+	unsigned cq_mask = 0;
+	io_uring_cqe* cqes = nullptr;
+	unsigned queued = 0;
+};
+#endif
+
+// Reads the images of another source ahead of the detection and produces them with their encoded bytes
+class BatchedReader : public ImageSource {
+public:
+	// Parameters:
+	//          source: Source of the image paths, owned by the reader
+	//          DEPTH:  Number of images read ahead of the detection
+	BatchedReader(unique_ptr<ImageSource> source, const int DEPTH) : paths(move(source)), depth(max(1, DEPTH)), completed(size_t(depth)) {
+#ifdef __linux__
+		ring = make_unique<IoUring>(unsigned(depth));
+		if (ring->valid()) {
+			slots.resize(size_t(depth));
+			for (int i = 0; i < depth; i++) {
+				free_slots.push_back(i);
+			}
+			logger().log(LogLevel::INFO, "reader", "io_uring", depth, true);
+			return;
+		}
+		ring.reset();
+#endif
+		logger().log(LogLevel::INFO, "reader", "pread", depth, true);
+		for (int i = 0; i < READER_THREADS; i++) {
+			readers.emplace_back([this] { readLoop(); });
+		}
+	}
+
+	~BatchedReader() override {
+		completed.close();
+		for (auto &reader: readers) {
+			reader.join();
+		}
+#ifdef __linux__
+		// The kernel may still be writing into the buffers of reads in flight, so they are reaped before the buffers go away
+		while (ring != nullptr && in_flight > 0) {
+			unsigned long long user_data;
+			int result;
+			if (ring->complete(user_data, result)) {
+				in_flight -= 1;
+				close(slots[user_data].fd);
+			}
+			else if (!ring->submit(true)) {
+				break;
+			}
+		}
+#endif
+	}
+
+	bool next(ImageEntry& entry) override {
+#ifdef __linux__
+		if (ring != nullptr && !ring_failed) {
+			return nextFromRing(entry);
+		}
+#endif
+		if (!completed.pop(current)) {
+			return false;
+		}
+		entry = move(current.first);
+		entry.bytes = string_view(current.second.data(), current.second.size());
+		return true;
+	}
+
+private:
+	// Takes the next path, first from the images whose reads were lost with the ring, then from the wrapped source; the sources are not thread safe
+	bool nextPath(ImageEntry& entry) {
+		lock_guard<mutex> lock(paths_mutex);
+		if (!retries.empty()) {
+			entry = move(retries.back());
+			retries.pop_back();
+			return true;
+		}
+		if (paths_done) {
+			return false;
+		}
+		paths_done = !paths->next(entry);
+		return !paths_done;
+	}
+
+	// Reads images on a pool thread until the source is exhausted or the reader is destroyed
+	void readLoop() {
+		pair<ImageEntry, vector<char>> image;
+		while (nextPath(image.first)) {
+			const int FD = open(image.first.path.c_str(), O_RDONLY | O_CLOEXEC);
+			const bool READ = FD >= 0 && readWholeFile(FD, image.second) && !image.second.empty();
+			if (FD >= 0) {
+				close(FD);
+			}
+			// Unreadable images are still produced, without bytes, so the run quarantines and journals them
+			if (!READ) {
+				logger().log(LogLevel::WARNING, "image_unreadable", image.first.path);
+				image.first.unreadable = true;
+				image.second.clear();
+			}
+			if (!completed.push(move(image))) {
+				return;
+			}
+			image = {};
+		}
+		// The last reader to finish ends the stream
+		lock_guard<mutex> lock(paths_mutex);
+		if (++finished_readers == READER_THREADS) {
+			completed.close();
+		}
+	}
+
+#ifdef __linux__
+	// An image being read through the ring
+	struct ReadSlot {
+		ImageEntry entry;
+		vector<char> buffer;
+		iovec vector_entry;
+		size_t done = 0;
+		int fd = -1;
+	};
+
+	// Keeps the ring full, then waits for a read to complete and produces its image
+	bool nextFromRing(ImageEntry& entry) {
+		// The buffer produced last time is no longer used by the caller
+		if (returned_slot >= 0) {
+			free_slots.push_back(returned_slot);
+			returned_slot = -1;
+		}
+		while (true) {
+			// Submitting right away so the reads progress while the caller works on the image
+			queueReads();
+			if (!unopened.empty()) {
+				entry = move(unopened.back());
+				unopened.pop_back();
+				entry.bytes = {};
+				entry.unreadable = true;
+				return true;
+			}
+			if (in_flight == 0) {
+				return false;
+			}
+			bool submitted = ring->submit(false);
+			unsigned long long user_data;
+			int result;
+			while (submitted && !ring->complete(user_data, result)) {
+				submitted = ring->submit(true);
+			}
+			if (!submitted) {
+				fallBackToThreads();
+				return next(entry);
+			}
+			in_flight -= 1;
+			ReadSlot& slot = slots[user_data];
+			if (result > 0) {
+				slot.done += size_t(result);
+			}
+			// Short reads are continued where they stopped
+			if (result > 0 && slot.done < slot.buffer.size()) {
+				queueSlot(int(user_data));
+				continue;
+			}
+			close(slot.fd);
+			slot.fd = -1;
+			entry = slot.entry;
+			returned_slot = int(user_data);
+			// Unreadable images are still produced, without bytes, so the run quarantines and journals them
+			if (slot.done != slot.buffer.size() || slot.buffer.empty()) {
+				logger().log(LogLevel::WARNING, "image_unreadable", slot.entry.path);
+				entry.bytes = {};
+				entry.unreadable = true;
+				return true;
+			}
+			entry.bytes = string_view(slot.buffer.data(), slot.buffer.size());
+			return true;
+		}
+	}
+
+	// Hands the rest of the run to the pread threads once the ring stops working, starting with the images whose reads were in flight
+	// The buffers of those reads stay with their slots, since the kernel may still complete them, and are reaped by the destructor
+	void fallBackToThreads() {
+		logger().log(LogLevel::WARNING, "io_uring_enter_failed", "pread", depth, true);
+		ring_failed = true;
+		vector<bool> is_free(slots.size(), false);
+		for (const int SLOT: free_slots) {
+			is_free[size_t(SLOT)] = true;
+		}
+		for (size_t i = 0; i < slots.size(); i++) {
+			if (!is_free[i]) {
+				retries.push_back(slots[i].entry);
+			}
+		}
+		for (int i = 0; i < READER_THREADS; i++) {
+			readers.emplace_back([this] { readLoop(); });
+		}
+	}
+
+	// Opens the next images and queues their reads until every free slot is busy
+	void queueReads() {
+		while (!free_slots.empty() && !paths_done) {
+			const int SLOT = free_slots.back();
+			ReadSlot& slot = slots[SLOT];
+			if (!nextPath(slot.entry)) {
+				break;
+			}
+			slot.fd = open(slot.entry.path.c_str(), O_RDONLY | O_CLOEXEC);
+			struct stat status;
+			if (slot.fd < 0 || fstat(slot.fd, &status) != 0) {
+				logger().log(LogLevel::WARNING, "image_unreadable", slot.entry.path);
+				if (slot.fd >= 0) {
+					close(slot.fd);
+				}
+				slot.fd = -1;
+				unopened.push_back(move(slot.entry));
+				continue;
+			}
+			free_slots.pop_back();
+			slot.buffer.resize(size_t(status.st_size));
+			slot.done = 0;
+			queueSlot(SLOT);
+		}
+	}
+
+	void queueSlot(const int SLOT) {
+		ReadSlot& slot = slots[size_t(SLOT)];
+		slot.vector_entry.iov_base = slot.buffer.data() + slot.done;
+		slot.vector_entry.iov_len = slot.buffer.size() - slot.done;
+		ring->queueRead(slot.fd, &slot.vector_entry, slot.done, (unsigned long long)SLOT);
+		in_flight += 1;
+	}
+
+	unique_ptr<IoUring> ring;
+	vector<ReadSlot> slots;
+	vector<int> free_slots;
+	int returned_slot = -1;
+	int in_flight = 0;
+	// Images that could not be opened, produced next without bytes
+	vector<ImageEntry> unopened;
+	bool ring_failed = false;
+#endif
+
+	unique_ptr<ImageSource> paths;
+	const int depth;
+	mutex paths_mutex;
+	bool paths_done = false;
+	int finished_readers = 0;
+	vector<ImageEntry> retries;
+	BoundedQueue<pair<ImageEntry, vector<char>>> completed;
+	pair<ImageEntry, vector<char>> current;
+	vector<thread> readers;
+};
+
+#endif //MAIN_BATCHREADER_H
@@ -0,0 +1,265 @@
+// checkpoint.h
+// Description: Periodic checkpoints of a run, holding the completed images, the quarantined images, and the running tallies, so an interrupted run can resume where it stopped
+// Assumptions: An image is identified by its label and image id; the csv file is only ever appended to between checkpoints
+
+#ifndef MAIN_CHECKPOINT_H
+#define MAIN_CHECKPOINT_H
+
+// Import the necessary libraries for i/o
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <unordered_set>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "headers/evaluation.h"
+#include "headers/imagesource.h"
+#include "headers/logger.h"
+
+// Declaring the namespaces that would be used throughout the program
+using namespace std;
+
+// Identifies a checkpoint file and the version of its layout
+const uint32_t CHECKPOINT_MAGIC = 0x54504B43;  // "CKPT"
+const uint32_t CHECKPOINT_VERSION = 1;
+
+// Layout of a checkpoint file; the completed images and the quarantined paths are appended to two journals next to it (PATH.done and PATH.quarantine)
+// and the checkpoint records how much of each journal, and of the csv file, belongs to it
+//          csv_size:                            Bytes of the csv file written when the checkpoint was taken
+//          done_count:                          Records of the completed images journal
+//          quarantine_size:                     Bytes of the quarantined paths journal
+//          images, ground_truth_*, *_counts:    Tallies of the run so far
+//          seconds:                             Time spent processing the images so far
+struct CheckpointHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t csv_size;
+	uint64_t done_count;
+	uint64_t quarantine_size;
+	int64_t images;
+	int64_t ground_truth_masks;
+	int64_t ground_truth_no_masks;
+	int32_t masked_counts[4];
+	int32_t not_masked_counts[4];
+	double seconds;
+};
+
+// A completed (or quarantined) image
+struct CheckpointRecord {
+	int32_t image_id;
+	uint8_t with_mask;
+	uint8_t padding[3];
+};
+
+// The records are read back as raw bytes, so their layout must not depend on the compiler's padding
+static_assert(sizeof(CheckpointHeader) == 96 && sizeof(CheckpointRecord) == 8, "Unexpected checkpoint record layout");
+
+// Flushes the data of a file to the disk
+// Parameters:
+//          PATH: Location of the file
+// Pre-condition:  N/A
+// Post-condition: Returns false if the file cannot be opened or synced
+bool syncFile(const string& PATH) {
+	const int FD = open(PATH.c_str(), O_RDONLY | O_CLOEXEC);
+	if (FD < 0) {
+		return false;
+	}
+	const bool SYNCED = fsync(FD) == 0;
+	close(FD);
+	return SYNCED;
+}
+
+// Journals the images as they complete and takes a checkpoint every few images
+class Checkpoint {
+public:
+	// Parameters:
+	//          PATH:  Location of the checkpoint
+	//          EVERY: Number of images completed between checkpoints
+	Checkpoint(const string& PATH, const int EVERY) : path(PATH), every(EVERY) {}
+
+	~Checkpoint() {
+		closeJournals();
+	}
+
+	// Restores the completed images and the tallies of the last checkpoint and drops whatever was journaled after it
+	// Pre-condition:  N/A
+	// Post-condition: Returns false if there is no valid checkpoint, in which case the run starts over
+	bool resume() {
+		CheckpointHeader header{};
+		FILE* file = fopen(path.c_str(), "rb");
+		const bool READ = file != nullptr && fread(&header, sizeof(header), 1, file) == 1;
+		if (file != nullptr) {
+			fclose(file);
+		}
+		if (!READ || header.magic != CHECKPOINT_MAGIC || header.version != CHECKPOINT_VERSION) {
+			return false;
+		}
+		error_code error;
+		const uint64_t DONE_SIZE = header.done_count * sizeof(CheckpointRecord);
+		if (filesystem::file_size(path + ".done", error) < DONE_SIZE || error || filesystem::file_size(path + ".quarantine", error) < header.quarantine_size || error) {
+			return false;
+		}
+		// Images completed after the checkpoint are processed again, since their csv rows are dropped too
+		filesystem::resize_file(path + ".done", DONE_SIZE, error);
+		filesystem::resize_file(path + ".quarantine", header.quarantine_size, error);
+		if (error) {
+			return false;
+		}
+
+		vector<CheckpointRecord> records(header.done_count);
+		file = fopen((path + ".done").c_str(), "rb");
+		const bool RECORDS_READ = file != nullptr && (records.empty() || fread(records.data(), sizeof(CheckpointRecord), records.size(), file) == records.size());
+		if (file != nullptr) {
+			fclose(file);
+		}
+		if (!RECORDS_READ) {
+			return false;
+		}
+		for (auto &record: records) {
+			completed.insert(key(record.with_mask != 0, record.image_id));
+		}
+
+		restored = RunSummary();
+		ifstream quarantine(path + ".quarantine");
+		string line;
+		while (getline(quarantine, line)) {
+			restored.quarantined.push_back(line);
+		}
+		restored.images = int(header.images);
+		restored.ground_truth_masks = int(header.ground_truth_masks);
+		restored.ground_truth_no_masks = int(header.ground_truth_no_masks);
+		restoreCounts(header.masked_counts, restored.masked_counts);
+		restoreCounts(header.not_masked_counts, restored.not_masked_counts);
+		restored.seconds = header.seconds;
+		csv_size = header.csv_size;
+		done_count = header.done_count;
+		logger().log(LogLevel::INFO, "checkpoint_resumed", path, (long long)header.done_count, true);
+		return true;
+	}
+
+	// Opens the journals, appending to them after a resume and starting them over otherwise; returns false if they cannot be opened
+	bool start(const bool RESUMED) {
+		if (!RESUMED) {
+			// A checkpoint of an earlier run no longer matches the journals
+			remove(path.c_str());
+		}
+		done_journal = fopen((path + ".done").c_str(), RESUMED ? "ab" : "wb");
+		quarantine_journal = fopen((path + ".quarantine").c_str(), RESUMED ? "ab" : "wb");
+		if (done_journal == nullptr || quarantine_journal == nullptr) {
+			logger().log(LogLevel::ERROR, "checkpoint_unwritable", path);
+			return false;
+		}
+		return true;
+	}
+
+	// Tallies and csv size of the last checkpoint, valid after a successful resume
+	const RunSummary& restoredSummary() const { return restored; }
+
+	uint64_t restoredCsvSize() const { return csv_size; }
+
+	// Returns true if the image was completed or quarantined before the checkpoint the run resumed from
+	bool done(const ImageEntry& ENTRY) const {
+		return completed.count(key(ENTRY.with_mask, ENTRY.image_id)) != 0;
+	}
+
+	// Journals a completed image; QUARANTINED images are journaled with their path as well, so they are not retried either
+	void complete(const ImageEntry& ENTRY, const bool QUARANTINED) {
+		CheckpointRecord record{};
+		record.image_id = ENTRY.image_id;
+		record.with_mask = ENTRY.with_mask;
+		fwrite(&record, sizeof(record), 1, done_journal);
+		done_count += 1;
+		pending += 1;
+		if (QUARANTINED) {
+			fprintf(quarantine_journal, "%s\n", ENTRY.path.c_str());
+		}
+	}
+
+	// Returns true once enough images completed since the last checkpoint
+	bool due() const { return pending >= every; }
+
+	// Takes a checkpoint
+	// Parameters:
+	//          SUMMARY:  Tallies of the run so far
+	//          CSV_PATH: Location of the csv file, or empty if the run writes no csv file
+	//          CSV_SIZE: Bytes written to the csv file so far, all of which must have been flushed
+	// Pre-condition:  N/A
+	// Post-condition: The journals and the csv file are synced before the checkpoint replaces the previous one, so a crash at any point leaves a consistent checkpoint
+	void save(const RunSummary& SUMMARY, const string& CSV_PATH, const uint64_t CSV_SIZE) {
+		CheckpointHeader header{};
+		header.magic = CHECKPOINT_MAGIC;
+		header.version = CHECKPOINT_VERSION;
+		header.csv_size = CSV_SIZE;
+		header.done_count = done_count;
+		header.images = SUMMARY.images;
+		header.ground_truth_masks = SUMMARY.ground_truth_masks;
+		header.ground_truth_no_masks = SUMMARY.ground_truth_no_masks;
+		saveCounts(SUMMARY.masked_counts, header.masked_counts);
+		saveCounts(SUMMARY.not_masked_counts, header.not_masked_counts);
+		header.seconds = SUMMARY.seconds;
+
+		bool saved = fflush(done_journal) == 0 && fflush(quarantine_journal) == 0 && fsync(fileno(done_journal)) == 0 && fsync(fileno(quarantine_journal)) == 0;
+		saved = saved && fseek(quarantine_journal, 0, SEEK_END) == 0;
+		header.quarantine_size = uint64_t(ftell(quarantine_journal));
+		saved = saved && (CSV_PATH.empty() || syncFile(CSV_PATH));
+
+		const string TEMPORARY_PATH = path + ".tmp";
+		FILE* file = saved ? fopen(TEMPORARY_PATH.c_str(), "wb") : nullptr;
+		saved = file != nullptr && fwrite(&header, sizeof(header), 1, file) == 1 && fflush(file) == 0 && fsync(fileno(file)) == 0;
+		if (file != nullptr) {
+			saved = fclose(file) == 0 && saved;
+		}
+		saved = saved && rename(TEMPORARY_PATH.c_str(), path.c_str()) == 0;
+		if (!saved) {
+			// The previous checkpoint stays in place, so the run can still resume from it
+			logger().log(LogLevel::WARNING, "checkpoint_failed", path);
+			return;
+		}
+		pending = 0;
+		logger().log(LogLevel::INFO, "checkpoint", path, (long long)done_count, true);
+	}
+
+private:
+	static uint64_t key(const bool WITH_MASK, const int IMAGE_ID) {
+		return (uint64_t(WITH_MASK) << 32) | uint32_t(IMAGE_ID);
+	}
+
+	static void saveCounts(const DetectionCounts& COUNTS, int32_t* values) {
+		values[0] = COUNTS.eyes_skipped;
+		values[1] = COUNTS.masked;
+		values[2] = COUNTS.not_masked;
+		values[3] = COUNTS.faces_skipped;
+	}
+
+	static void restoreCounts(const int32_t* VALUES, DetectionCounts& counts) {
+		counts.eyes_skipped = VALUES[0];
+		counts.masked = VALUES[1];
+		counts.not_masked = VALUES[2];
+		counts.faces_skipped = VALUES[3];
+	}
+
+	void closeJournals() {
+		if (done_journal != nullptr) {
+			fclose(done_journal);
+		}
+		if (quarantine_journal != nullptr) {
+			fclose(quarantine_journal);
+		}
+		done_journal = quarantine_journal = nullptr;
+	}
+
+	const string path;
+	const int every;
+	FILE* done_journal = nullptr;
+	FILE* quarantine_journal = nullptr;
+	unordered_set<uint64_t> completed;
+	uint64_t done_count = 0;
+	int pending = 0;
+	RunSummary restored;
+	uint64_t csv_size = 0;
+};
+
+#endif //MAIN_CHECKPOINT_H
@@ -0,0 +1,75 @@
+// concurrency.h
+// Description: A bounded blocking queue used to hand work between the pipeline and its helper threads
+// Assumptions: Producers that must never wait use tryPush and drop the item when the queue is full
+
+#ifndef MAIN_CONCURRENCY_H
+#define MAIN_CONCURRENCY_H
+
+// Import the necessary libraries for threading
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+
+// Declaring the namespaces that would be used throughout the program
+using namespace std;
+
+// A first-in first-out queue holding at most a fixed number of items
+// Once closed, pushes fail and pops return the remaining items before failing
+template <typename T>
+class BoundedQueue {
+public:
+	explicit BoundedQueue(const size_t CAPACITY) : capacity(CAPACITY) {}
+
+	// Adds an item, waiting while the queue is full; returns false if the queue was closed
+	bool push(T item) {
+		unique_lock<mutex> lock(items_mutex);
+		not_full.wait(lock, [this] { return closed || items.size() < capacity; });
+		if (closed) {
+			return false;
+		}
+		items.push_back(move(item));
+		not_empty.notify_one();
+		return true;
+	}
+
+	// Adds an item only if there is room right now; returns false if the queue is full or closed
+	bool tryPush(T item) {
+		lock_guard<mutex> lock(items_mutex);
+		if (closed || items.size() >= capacity) {
+			return false;
+		}
+		items.push_back(move(item));
+		not_empty.notify_one();
+		return true;
+	}
+
+	// Removes the oldest item, waiting while the queue is empty; returns false once the queue is closed and empty
+	bool pop(T& item) {
+		unique_lock<mutex> lock(items_mutex);
+		not_empty.wait(lock, [this] { return closed || !items.empty(); });
+		if (items.empty()) {
+			return false;
+		}
+		item = move(items.front());
+		items.pop_front();
+		not_full.notify_one();
+		return true;
+	}
+
+	// Wakes every waiting thread and stops accepting items
+	void close() {
+		lock_guard<mutex> lock(items_mutex);
+		closed = true;
+		not_empty.notify_all();
+		not_full.notify_all();
+	}
+
+private:
+	const size_t capacity;
+	deque<T> items;
+	bool closed = false;
+	mutex items_mutex;
+	condition_variable not_empty, not_full;
+};
+
+#endif //MAIN_CONCURRENCY_H
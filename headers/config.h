@@ -0,0 +1,769 @@
+// config.h
+// Description: Run-time options of the mask detection program and the command line parser that fills them
+// Assumptions: Options are passed as "--name value" pairs or as "--name" switches, on the command line or in a config file
+
+#ifndef MAIN_CONFIG_H
+#define MAIN_CONFIG_H
+
+// Import the necessary libraries for i/o
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstdio>
+#include "headers/logger.h"
+
+// Declaring the namespaces that would be used throughout the program
+using namespace std;
+
+// Strategies for locating the eye and oronasal regions of a face
+//          CASCADE:  Runs the left eye, right eye, and eyeglasses haar cascades on each face
+//          SHARED:   Finds the same eyes as CASCADE in one scan of each face, evaluating the three cascades on every window together
+//          GEOMETRY: Uses fixed proportions of the face box refined with a vertical Cr projection profile
+enum class EyeSearch { CASCADE, SHARED, GEOMETRY };
+
+// Face cascades run on an image, in order; a second cascade only runs when the first one finds no face
+//          HAAR_THEN_LBP: The Haar cascade, falling back to the LBP cascade
+//          LBP_THEN_HAAR: The LBP cascade, falling back to the Haar cascade
+//          HAAR, LBP:     A single cascade without fallback
+enum class FaceCascades { HAAR_THEN_LBP, LBP_THEN_HAAR, HAAR, LBP };
+
+// Which images get annotated
+//          NONE:     No image is written
+//          EVERY_N:  One image out of every N processed
+//          FAILURES: Only images where a face was missed or skipped, or a decision disagrees with the ground truth
+enum class AnnotationSampling { NONE, EVERY_N, FAILURES };
+
+// What the images of a sampled run are stratified by
+//          FOLDER: The directory holding the image, e.g. one per site
+//          LABEL:  The with_mask or without_mask label of the image
+enum class SampleStrata { FOLDER, LABEL };
+
+// Parameters of the Gaussian blur applied by the pre-processing
+//          BLUR_WIDTH, BLUR_HEIGHT:   Size of the kernel in pixels (odd)
+//          BLUR_SIGMA_X, BLUR_SIGMA_Y: Standard deviations of the kernel, or 0 to derive them from its size
+struct PreProcessingParams {
+	int BLUR_WIDTH = 5, BLUR_HEIGHT = 5;
+	double BLUR_SIGMA_X = 0, BLUR_SIGMA_Y = 0;
+};
+
+// Parameters of the multi-scale search of the face cascades
+//          SCALE_FACTOR:           Factor the search window grows by between two scales
+//          MIN_NEIGHBORS:          Overlapping detections needed to keep a face
+//          MIN_FACE, MAX_FACE:     Smallest and largest face searched for in pixels, or 0 for no limit
+struct FaceDetectionParams {
+	double SCALE_FACTOR = 1.1;
+	int MIN_NEIGHBORS = 3;
+	int MIN_FACE = 0, MAX_FACE = 0;
+};
+
+// A preset applied to the images under a directory
+//          DIRECTORY: Directory of the source, as given on the command line or relative to the dataset directory
+//          PRESET:    Name of the preset
+struct SourcePreset {
+	string DIRECTORY;
+	string PRESET;
+};
+
+// Options controlling a run of the mask detection program
+//          DIRECTORY_PATH:      Directory containing the test images
+//          OUTPUT_PATH:         CSV file receiving the per image results
+//          RESULTS_PATH:        Columnar binary files receiving the per image and per face results instead of the csv file, or empty to write the csv file
+//          EXPORT_CSV:          Converts the results at RESULTS_PATH into the csv file at OUTPUT_PATH instead of running the detection
+//          CHECKPOINT_PATH:     Checkpoint of the completed images and the running tallies, or empty to take no checkpoint
+//          CHECKPOINT_EVERY:    Number of images completed between checkpoints
+//          RESUME:              Resumes from the checkpoint, skipping the images it completed and appending to the csv file
+//          QUARANTINE_PATH:     Text file listing the images that could not be read or decoded
+//          MANIFEST_PATH:       Binary manifest caching the list of images between runs, or empty to scan the directory every run
+//          CONTAINER_PATH:      Packed container to read the images from instead of the dataset directory
+//          PACK_PATH:           Packs the dataset into a container at this location instead of running the detection
+//          READ_DEPTH:          Number of images read ahead of the detection through io_uring (or a pread pool), or 0 to read each image when it is processed
+//          PIXEL_CACHE_PATH:    Directory caching the decoded and pre-processed images between runs, or empty to decode every run
+//          RESULT_CACHE_PATH:   File caching the per face results of the images between runs, or empty to detect every image
+//          RESULT_CACHE_SIZE:   Maximum number of images kept in the result cache
+//          STAGE_STORE_PATH:    Directory storing the results of the face, eye, and skin stages between runs, or empty to compute every stage
+//          PRE_PROCESSING:      Parameters of the pre-processing
+//          DECODE_SCALE:        Images are decoded at 1/DECODE_SCALE of their size (1, 2, 4, or 8)
+//          FACE_CASCADES:       Face cascades run on an image and their order
+//          FACE_DETECTION:      Parameters of the face cascades
+//          EYE_SEARCH:          Strategy used to locate the eye and oronasal regions
+//          COMPARE_EYE_SEARCH:  Runs the dataset with every eye search strategy and prints an accuracy vs throughput table
+//          CHECK_EYE_SEARCH:    Number of images whose faces the shared eye search is checked on against the eye cascades instead of running the detection, or 0 for no check
+//          CANONICAL_FACE_SIZE: Width and height the faces are resampled to before the per face stages, or 0 to keep the cropped size
+//          DEADLINE_MS:         Time allowed per image, after which the detection drops work to stay within it, or 0 for no deadline
+//          MASK_RATIO:          A face wears a mask when its eye region has more than MASK_RATIO times the skin pixels of its oronasal region
+//          RESCORE:             Re-scores the faces of the results at RESULTS_PATH for a sweep of mask ratios instead of running the detection
+//          SWEEP_FROM, SWEEP_TO, SWEEP_STEP: First and last mask ratio of the sweep, and the increment between two of them
+//          ALLOCATION_REPORT:   Prints how many Mat buffers had to come from the heap instead of the pool
+//          ALLOCATION_CHECK:    Number of images processed after the allocation warm-up, after which the run fails if any of them allocated, or 0 for no check
+//          LOG_LEVEL:           Least severe log records written to the console
+//          ANNOTATION_PATH:     Directory receiving the annotated images, or empty to write none
+//          ANNOTATION_SAMPLING: Which images get annotated
+//          ANNOTATION_EVERY:    Sampling period when annotating one image out of every N
+//          TUNE_PATH:           Searches the face detection and blur parameters and writes the chosen ones to this config file instead of running the detection
+//          TUNE_IMAGES:         Number of images of the dataset the candidates are measured on
+//          TUNE_TOLERANCE:      Accuracy in percentage points the chosen candidate may give up against the most accurate one for more throughput
+//          SOURCE_PRESETS:      Presets replacing the options of the run for the images of some sources
+//          BENCHMARK_PRESETS:   Runs the dataset with every preset and prints an accuracy vs throughput table
+//          SAMPLE_CI:           Processes a stratified random sample until the masked face rate is known to within +/- SAMPLE_CI percentage points, or 0 to process every image
+//          SAMPLE_CONFIDENCE:   Confidence level of the interval of a sampled run
+//          SAMPLE_STRATA:       What the images of a sampled run are stratified by
+//          SAMPLE_SEED:         Seed of the random order the images of every stratum are sampled in
+//          DEDUP:               Reuses the results of a recent near-duplicate image instead of detecting the faces of an image again
+//          DEDUP_DISTANCE:      Largest Hamming distance between the difference hashes of two images for them to count as near-duplicates
+//          DEDUP_WINDOW:        Number of recent images searched for a near-duplicate
+//          VIDEO_PATH:          Local video file whose frames are processed instead of the dataset, or empty to process the dataset
+//          FRAME_STRIDE:        Keeps one frame of the video out of every FRAME_STRIDE frames
+//          FRAME_INTERVAL_MS:   Least time between two kept frames of the video, or 0 to keep every frame of the stride
+struct Config {
+	string DIRECTORY_PATH = "Dataset";
+	string OUTPUT_PATH = "output.csv";
+	string RESULTS_PATH;
+	bool EXPORT_CSV = false;
+	string CHECKPOINT_PATH;
+	int CHECKPOINT_EVERY = 1000;
+	bool RESUME = false;
+	string QUARANTINE_PATH = "quarantine.txt";
+	string MANIFEST_PATH;
+	string CONTAINER_PATH;
+	string PACK_PATH;
+	int READ_DEPTH = 0;
+	string PIXEL_CACHE_PATH;
+	string RESULT_CACHE_PATH;
+	int RESULT_CACHE_SIZE = 100000;
+	string STAGE_STORE_PATH;
+	PreProcessingParams PRE_PROCESSING;
+	int DECODE_SCALE = 1;
+	FaceCascades FACE_CASCADES = FaceCascades::HAAR_THEN_LBP;
+	FaceDetectionParams FACE_DETECTION;
+	EyeSearch EYE_SEARCH = EyeSearch::CASCADE;
+	bool COMPARE_EYE_SEARCH = false;
+	int CHECK_EYE_SEARCH = 0;
+	int CANONICAL_FACE_SIZE = 0;
+	double DEADLINE_MS = 0;
+	double MASK_RATIO = 1.2;
+	bool RESCORE = false;
+	double SWEEP_FROM = 0.5, SWEEP_TO = 3.0, SWEEP_STEP = 0.05;
+	bool ALLOCATION_REPORT = false;
+	int ALLOCATION_CHECK = 0;
+	LogLevel LOG_LEVEL = LogLevel::INFO;
+	string ANNOTATION_PATH;
+	AnnotationSampling ANNOTATION_SAMPLING = AnnotationSampling::NONE;
+	int ANNOTATION_EVERY = 1;
+	string TUNE_PATH;
+	int TUNE_IMAGES = 400;
+	double TUNE_TOLERANCE = 1.0;
+	vector<SourcePreset> SOURCE_PRESETS;
+	bool BENCHMARK_PRESETS = false;
+	double SAMPLE_CI = 0;
+	double SAMPLE_CONFIDENCE = 0.95;
+	SampleStrata SAMPLE_STRATA = SampleStrata::FOLDER;
+	int SAMPLE_SEED = 1;
+	bool DEDUP = false;
+	int DEDUP_DISTANCE = 4;
+	int DEDUP_WINDOW = 256;
+	string VIDEO_PATH;
+	int FRAME_STRIDE = 1;
+	double FRAME_INTERVAL_MS = 0;
+};
+
+// Names of the speed/accuracy presets, from the fastest to the most accurate
+const vector<string> PRESET_NAMES = {"fast", "balanced", "accurate"};
+
+// Sets the options bundled by a preset: the decode scale, the face cascades and their parameters, the eye search strategy, and the face size
+// Parameters:
+//          NAME:   Name of the preset
+//          config: Options receiving the preset; every other option is left untouched
+// Pre-condition:  N/A
+// Post-condition: Returns false for an unknown preset, leaving the options untouched
+//                 balanced holds the defaults; fast decodes at half size and skips the eye cascades; accurate searches the faces at finer scales
+bool applyPreset(const string& NAME, Config& config) {
+	if (NAME == "fast") {
+		config.DECODE_SCALE = 2;
+		config.FACE_CASCADES = FaceCascades::LBP;
+		config.FACE_DETECTION = FaceDetectionParams{1.2, 3, 0, 0};
+		config.EYE_SEARCH = EyeSearch::GEOMETRY;
+		config.CANONICAL_FACE_SIZE = 64;
+	}
+	else if (NAME == "balanced") {
+		config.DECODE_SCALE = 1;
+		config.FACE_CASCADES = FaceCascades::HAAR_THEN_LBP;
+		config.FACE_DETECTION = FaceDetectionParams();
+		config.EYE_SEARCH = EyeSearch::CASCADE;
+		config.CANONICAL_FACE_SIZE = 0;
+	}
+	else if (NAME == "accurate") {
+		config.DECODE_SCALE = 1;
+		config.FACE_CASCADES = FaceCascades::HAAR_THEN_LBP;
+		config.FACE_DETECTION = FaceDetectionParams{1.05, 3, 0, 0};
+		config.EYE_SEARCH = EyeSearch::CASCADE;
+		config.CANONICAL_FACE_SIZE = 0;
+	}
+	else {
+		return false;
+	}
+	return true;
+}
+
+// Resolves the options of every image from the presets of the source it comes from
+class SourceConfigs {
+public:
+	// Parameters:
+	//          CONFIG: Options of the run, holding the presets of the sources
+	explicit SourceConfigs(const Config& CONFIG) : base(CONFIG) {
+		for (auto &source: CONFIG.SOURCE_PRESETS) {
+			Config config = CONFIG;
+			applyPreset(source.PRESET, config);
+			// The directory may be given as it appears in the image paths or relative to the dataset directory
+			directories.push_back({source.DIRECTORY, CONFIG.DIRECTORY_PATH + "/" + source.DIRECTORY});
+			configs.push_back(config);
+		}
+	}
+
+	// Returns the options of the first source whose directory holds the image, or the options of the run if there is none
+	const Config& select(const string& PATH) const {
+		for (size_t i = 0; i < configs.size(); i++) {
+			for (auto &directory: directories[i]) {
+				if (PATH.size() > directory.size() && PATH.compare(0, directory.size(), directory) == 0 && (PATH[directory.size()] == '/' || directory.back() == '/')) {
+					return configs[i];
+				}
+			}
+		}
+		return base;
+	}
+
+private:
+	const Config& base;
+	vector<Config> configs;
+	vector<vector<string>> directories;
+};
+
+// Returns the printable name of a choice of face cascades
+// Parameters:
+//          FACE_CASCADES: The face cascades
+// Pre-condition:  N/A
+// Post-condition: The name used on the command line for the choice is returned
+string faceCascadesName(const FaceCascades FACE_CASCADES) {
+	switch (FACE_CASCADES) {
+		case FaceCascades::LBP_THEN_HAAR: return "lbp-haar";
+		case FaceCascades::HAAR: return "haar";
+		case FaceCascades::LBP: return "lbp";
+		default: return "haar-lbp";
+	}
+}
+
+// Returns the printable name of an eye search strategy
+// Parameters:
+//          EYE_SEARCH: The eye search strategy
+// Pre-condition:  N/A
+// Post-condition: The name used on the command line for the strategy is returned
+string eyeSearchName(const EyeSearch EYE_SEARCH) {
+	switch (EYE_SEARCH) {
+		case EyeSearch::SHARED: return "shared";
+		case EyeSearch::GEOMETRY: return "geometry";
+		default: return "cascade";
+	}
+}
+
+// Prints the supported command line options and exits the program
+// Parameters:
+//          PROGRAM: Name of the executable
+// Pre-condition:  N/A
+// Post-condition: The usage text is displayed and the program exits
+void printUsage(const string& PROGRAM) {
+	cout << "Usage: " << PROGRAM << " [options]" << endl;
+	cout << "  --dataset PATH          Directory containing the test images (default: Dataset)" << endl;
+	cout << "  --output PATH           CSV file for the per image results (default: output.csv)" << endl;
+	cout << "  --results PATH          Writes the per image and per face results to columnar files PATH.images and PATH.faces instead of the csv file" << endl;
+	cout << "  --export-csv            Converts the results given by --results into the csv file given by --output and exits, adding the Reused column with --dedup" << endl;
+	cout << "  --checkpoint PATH       Takes checkpoints of the completed images and the running tallies while the run goes on" << endl;
+	cout << "  --checkpoint-every N    Takes a checkpoint every N images (default: 1000)" << endl;
+	cout << "  --resume                Resumes an interrupted run from its checkpoint" << endl;
+	cout << "  --quarantine PATH       Lists the images that could not be read or decoded (default: quarantine.txt)" << endl;
+	cout << "  --manifest PATH         Caches the list of images in a manifest file, refreshed when the dataset changes" << endl;
+	cout << "  --pack PATH             Packs the dataset images into one container file and exits" << endl;
+	cout << "  --container PATH        Reads the images from a packed container instead of the dataset directory" << endl;
+	cout << "  --read-depth N          Keeps N image reads in flight ahead of the detection (default: 0, off)" << endl;
+	cout << "  --pixel-cache PATH      Caches the decoded and pre-processed images in a directory for later runs" << endl;
+	cout << "  --result-cache PATH     Caches the per face results in a file, so images seen before skip the detection" << endl;
+	cout << "  --result-cache-size N   Keeps the results of at most N images, evicting the least recently used (default: 100000)" << endl;
+	cout << "  --stage-store PATH      Stores the face boxes, eye regions, and skin counts in a directory, so later runs only recompute the changed stages" << endl;
+	cout << "  --config PATH           Reads options from a file, one per line, as written by --tune" << endl;
+	cout << "  --preset NAME           fast, balanced (default), or accurate; sets the decode scale, face cascades, face search, eye search, and face size" << endl;
+	cout << "  --source-preset DIR=NAME Applies a preset to the images under DIR (repeatable)" << endl;
+	cout << "  --benchmark-presets     Compares accuracy and throughput of the presets" << endl;
+	cout << "  --decode-scale N        Decodes the images at 1/N of their size: 1 (default), 2, 4, or 8" << endl;
+	cout << "  --face-cascades NAME    haar-lbp (default), lbp-haar, haar, or lbp" << endl;
+	cout << "  --blur N                Size of the square Gaussian blur kernel, odd (default: 5)" << endl;
+	cout << "  --scale-factor F        Growth of the face search window between scales (default: 1.1)" << endl;
+	cout << "  --min-neighbors N       Overlapping detections needed to keep a face (default: 3)" << endl;
+	cout << "  --min-face N            Smallest face searched for in pixels (default: 0, no limit)" << endl;
+	cout << "  --max-face N            Largest face searched for in pixels (default: 0, no limit)" << endl;
+	cout << "  --tune PATH             Searches the face detection and blur parameters, prints the throughput vs accuracy frontier, and writes the chosen ones to a config file" << endl;
+	cout << "  --tune-images N         Measures every candidate on N images of the dataset (default: 400)" << endl;
+	cout << "  --tune-tolerance P      Accuracy in percentage points traded for throughput when choosing (default: 1.0)" << endl;
+	cout << "  --eye-search NAME       cascade (default), shared, or geometry" << endl;
+	cout << "  --compare-eye-search    Compares accuracy and throughput of the eye search strategies" << endl;
+	cout << "  --check-eye-search N    Checks that the shared eye search finds the same eyes as the eye cascades on the faces of N images and exits" << endl;
+	cout << "  --face-size N           Resamples faces to NxN pixels before segmentation and eye search (default: 0, off)" << endl;
+	cout << "  --deadline MS           Time allowed per image; stages that no longer fit are dropped or downscaled (default: 0, off)" << endl;
+	cout << "  --mask-ratio R          Eye to oronasal skin ratio above which a face wears a mask (default: 1.2)" << endl;
+	cout << "  --rescore               Re-scores the results given by --results for a sweep of mask ratios and exits" << endl;
+	cout << "  --sweep FROM:TO:STEP    Mask ratios swept by --rescore (default: 0.5:3.0:0.05)" << endl;
+	cout << "  --sample-ci P           Samples images per stratum until the masked face rate is known to within +/- P percentage points (default: 0, off)" << endl;
+	cout << "  --sample-confidence C   Confidence level of the sampled interval (default: 0.95)" << endl;
+	cout << "  --sample-strata NAME    folder (default) or label" << endl;
+	cout << "  --sample-seed N         Seed of the sampling order (default: 1)" << endl;
+	cout << "  --dedup                 Reuses the results of a recent near-duplicate image, found by a difference hash of the decoded image" << endl;
+	cout << "  --dedup-distance D      Largest Hamming distance between the hashes of near-duplicates, out of 64 bits (default: 4)" << endl;
+	cout << "  --dedup-window N        Searches the last N images for a near-duplicate (default: 256)" << endl;
+	cout << "  --video PATH            Processes the frames of a local video file instead of the dataset, writing one csv row per frame" << endl;
+	cout << "  --frame-stride N        Keeps one video frame out of every N (default: 1)" << endl;
+	cout << "  --frame-interval MS     Keeps at most one video frame every MS milliseconds of the video (default: 0, off)" << endl;
+	cout << "  --allocation-report     Prints the Mat allocations served by the pool and by the heap" << endl;
+	cout << "  --allocation-check N    Processes N images after a warm-up and fails if any of them allocated from the heap" << endl;
+	cout << "  --log-level NAME        debug, info (default), warning, or error" << endl;
+	cout << "  --annotate PATH         Writes images annotated with the face, eye, and oronasal boxes and decisions to a directory" << endl;
+	cout << "  --annotate-every N      Annotates one image out of every N (default: 1)" << endl;
+	cout << "  --annotate-failures     Annotates only the images with missed faces or wrong decisions" << endl;
+	exit(0);
+}
+
+// Reads the options saved in a config file
+// Parameters:
+//          PATH:    Location of the file, holding one "--name value" pair or "--name" switch per line; empty lines and lines starting with # are ignored
+//          PROGRAM: Name of the executable
+// Pre-condition:  N/A
+// Post-condition: Returns the options as separate arguments, in the order of the file; exits if the file cannot be read
+vector<string> readConfigFile(const string& PATH, const string& PROGRAM) {
+	ifstream file(PATH);
+	if (!file) {
+		cout << "Cannot read the config file: " << PATH << endl;
+		printUsage(PROGRAM);
+	}
+	vector<string> args;
+	string line, arg;
+	while (getline(file, line)) {
+		istringstream words(line);
+		if (!(words >> arg) || arg[0] == '#') {
+			continue;
+		}
+		args.push_back(arg);
+		// The value is the rest of the line, so paths may contain spaces
+		string value;
+		getline(words >> ws, value);
+		if (!value.empty()) {
+			args.push_back(value);
+		}
+	}
+	return args;
+}
+
+// Parses a whole argument as a base 10 integer
+// Parameters:
+//          TEXT:  The argument
+//          value: Receives the integer
+// Pre-condition:  N/A
+// Post-condition: Returns false, leaving the value unchanged, if the argument is empty, has anything after the digits, or does not fit in an int
+bool parseInteger(const string& TEXT, int& value) {
+	char* end = nullptr;
+	errno = 0;
+	const long PARSED = strtol(TEXT.c_str(), &end, 10);
+	if (TEXT.empty() || *end != '\0' || errno == ERANGE || PARSED < INT_MIN || PARSED > INT_MAX) {
+		return false;
+	}
+	value = int(PARSED);
+	return true;
+}
+
+// Parses the command line arguments into the run-time options
+// Parameters:
+//          argc: Number of command line arguments
+//          argv: Command line arguments
+// Pre-condition:  The arguments follow the format shown by printUsage
+// Post-condition: Returns the options with defaults for anything not specified; exits on invalid arguments
+Config parseArguments(const int argc, char* argv[]) {
+	// The options of a config file take the place of the --config option, so options given after it override the file
+	vector<string> args;
+	for (int i = 1; i < argc; i++) {
+		if (string(argv[i]) == "--config" && i + 1 < argc) {
+			const vector<string> FILE_ARGS = readConfigFile(argv[++i], argv[0]);
+			args.insert(args.end(), FILE_ARGS.begin(), FILE_ARGS.end());
+		}
+		else {
+			args.push_back(argv[i]);
+		}
+	}
+
+	Config config;
+	for (size_t i = 0; i < args.size(); i++) {
+		const string& ARG = args[i];
+		const bool HAS_VALUE = i + 1 < args.size();
+		if (ARG == "--dataset" && HAS_VALUE) {
+			config.DIRECTORY_PATH = args[++i];
+		}
+		else if (ARG == "--output" && HAS_VALUE) {
+			config.OUTPUT_PATH = args[++i];
+		}
+		else if (ARG == "--results" && HAS_VALUE) {
+			config.RESULTS_PATH = args[++i];
+		}
+		else if (ARG == "--export-csv") {
+			config.EXPORT_CSV = true;
+		}
+		else if (ARG == "--checkpoint" && HAS_VALUE) {
+			config.CHECKPOINT_PATH = args[++i];
+		}
+		else if (ARG == "--checkpoint-every" && HAS_VALUE) {
+			config.CHECKPOINT_EVERY = atoi(args[++i].c_str());
+			if (config.CHECKPOINT_EVERY < 1) {
+				cout << "The checkpoint period must be positive" << endl;
+				printUsage(argv[0]);
+			}
+		}
+		else if (ARG == "--resume") {
+			config.RESUME = true;
+		}
+		else if (ARG == "--quarantine" && HAS_VALUE) {
+			config.QUARANTINE_PATH = args[++i];
+		}
+		else if (ARG == "--manifest" && HAS_VALUE) {
+			config.MANIFEST_PATH = args[++i];
+		}
+		else if (ARG == "--pack" && HAS_VALUE) {
+			config.PACK_PATH = args[++i];
+		}
+		else if (ARG == "--container" && HAS_VALUE) {
+			config.CONTAINER_PATH = args[++i];
+		}
+		else if (ARG == "--read-depth" && HAS_VALUE) {
+			config.READ_DEPTH = atoi(args[++i].c_str());
+			if (config.READ_DEPTH < 0) {
+				cout << "The read depth cannot be negative" << endl;
+				printUsage(argv[0]);
+			}
+		}
+		else if (ARG == "--pixel-cache" && HAS_VALUE) {
+			config.PIXEL_CACHE_PATH = args[++i];
+		}
+		else if (ARG == "--result-cache" && HAS_VALUE) {
+			config.RESULT_CACHE_PATH = args[++i];
+		}
+		else if (ARG == "--result-cache-size" && HAS_VALUE) {
+			config.RESULT_CACHE_SIZE = atoi(args[++i].c_str());
+			if (config.RESULT_CACHE_SIZE < 1) {
+				cout << "The result cache size must be positive" << endl;
+				printUsage(argv[0]);
+			}
+		}
+		else if (ARG == "--stage-store" && HAS_VALUE) {
+			config.STAGE_STORE_PATH = args[++i];
+		}
+		else if (ARG == "--preset" && HAS_VALUE) {
+			const string VALUE = args[++i];
+			if (!applyPreset(VALUE, config)) {
+				cout << "Unknown preset: " << VALUE << endl;
+				printUsage(argv[0]);
+			}
+		}
+		else if (ARG == "--source-preset" && HAS_VALUE) {
+			const string VALUE = args[++i];
+			const size_t EQUALS = VALUE.rfind('=');
+			Config preset;
+			if (EQUALS == string::npos || EQUALS == 0 || !applyPreset(VALUE.substr(EQUALS + 1), preset)) {
+				cout << "The source preset must be DIR=NAME with a known preset: " << VALUE << endl;
+				printUsage(argv[0]);
+			}
+			config.SOURCE_PRESETS.push_back(SourcePreset{VALUE.substr(0, EQUALS), VALUE.substr(EQUALS + 1)});
+		}
+		else if (ARG == "--benchmark-presets") {
+			config.BENCHMARK_PRESETS = true;
+		}
+		else if (ARG == "--decode-scale" && HAS_VALUE) {
+			config.DECODE_SCALE = atoi(args[++i].c_str());
+			if (config.DECODE_SCALE != 1 && config.DECODE_SCALE != 2 && config.DECODE_SCALE != 4 && config.DECODE_SCALE != 8) {
+				cout << "The decode scale must be 1, 2, 4, or 8" << endl;
+				printUsage(argv[0]);
+			}
+		}
+		else if (ARG == "--face-cascades" && HAS_VALUE) {
+			const string VALUE = args[++i];
+			if (VALUE == "haar-lbp") {
+				config.FACE_CASCADES = FaceCascades::HAAR_THEN_LBP;
+			}
+			else if (VALUE == "lbp-haar") {
+				config.FACE_CASCADES = FaceCascades::LBP_THEN_HAAR;
+			}
+			else if (VALUE == "haar") {
+				config.FACE_CASCADES = FaceCascades::HAAR;
+			}
+			else if (VALUE == "lbp") {
+				config.FACE_CASCADES = FaceCascades::LBP;
+			}
+			else {
+				cout << "Unknown face cascades: " << VALUE << endl;
+				printUsage(argv[0]);
+			}
+		}
+		else if (ARG == "--blur" && HAS_VALUE) {
+			config.PRE_PROCESSING.BLUR_WIDTH = config.PRE_PROCESSING.BLUR_HEIGHT = atoi(args[++i].c_str());
+			if (config.PRE_PROCESSING.BLUR_WIDTH < 1 || config.PRE_PROCESSING.BLUR_WIDTH % 2 == 0) {
+				cout << "The blur kernel size must be positive and odd" << endl;
+				printUsage(argv[0]);
+			}
+		}
+		else if (ARG == "--scale-factor" && HAS_VALUE) {
+			config.FACE_DETECTION.SCALE_FACTOR = atof(args[++i].c_str());
+			if (config.FACE_DETECTION.SCALE_FACTOR <= 1) {
+				cout << "The scale factor must be greater than 1" << endl;
+				printUsage(argv[0]);
+			}
+		}
+		else if (ARG == "--min-neighbors" && HAS_VALUE) {
+			config.FACE_DETECTION.MIN_NEIGHBORS = atoi(args[++i].c_str());
+			if (config.FACE_DETECTION.MIN_NEIGHBORS < 0) {
+				cout << "The minimum number of neighbors cannot be negative" << endl;
+				printUsage(argv[0]);
+			}
+		}
+		else if (ARG == "--min-face" && HAS_VALUE) {
+			config.FACE_DETECTION.MIN_FACE = atoi(args[++i].c_str());
+			if (config.FACE_DETECTION.MIN_FACE < 0) {
+				cout << "The minimum face size cannot be negative" << endl;
+				printUsage(argv[0]);
+			}
+		}
+		else if (ARG == "--max-face" && HAS_VALUE) {
+			config.FACE_DETECTION.MAX_FACE = atoi(args[++i].c_str());
+			if (config.FACE_DETECTION.MAX_FACE < 0) {
+				cout << "The maximum face size cannot be negative" << endl;
+				printUsage(argv[0]);
+			}
+		}
+		else if (ARG == "--tune" && HAS_VALUE) {
+			config.TUNE_PATH = args[++i];
+		}
+		else if (ARG == "--tune-images" && HAS_VALUE) {
+			config.TUNE_IMAGES = atoi(args[++i].c_str());
+			if (config.TUNE_IMAGES < 1) {
+				cout << "The number of tuning images must be positive" << endl;
+				printUsage(argv[0]);
+			}
+		}
+		else if (ARG == "--tune-tolerance" && HAS_VALUE) {
+			config.TUNE_TOLERANCE = atof(args[++i].c_str());
+			if (config.TUNE_TOLERANCE < 0) {
+				cout << "The tuning tolerance cannot be negative" << endl;
+				printUsage(argv[0]);
+			}
+		}
+		else if (ARG == "--eye-search" && HAS_VALUE) {
+			const string VALUE = args[++i];
+			if (VALUE == "cascade") {
+				config.EYE_SEARCH = EyeSearch::CASCADE;
+			}
+			else if (VALUE == "shared") {
+				config.EYE_SEARCH = EyeSearch::SHARED;
+			}
+			else if (VALUE == "geometry") {
+				config.EYE_SEARCH = EyeSearch::GEOMETRY;
+			}
+			else {
+				cout << "Unknown eye search strategy: " << VALUE << endl;
+				printUsage(argv[0]);
+			}
+		}
+		else if (ARG == "--face-size" && HAS_VALUE) {
+			// A value that is not a number would otherwise read as 0 and silently turn the normalization off
+			if (!parseInteger(args[++i], config.CANONICAL_FACE_SIZE)) {
+				cout << "The face size must be a whole number of pixels: " << args[i] << endl;
+				printUsage(argv[0]);
+			}
+			if (config.CANONICAL_FACE_SIZE < 0) {
+				cout << "The face size cannot be negative" << endl;
+				printUsage(argv[0]);
+			}
+		}
+		else if (ARG == "--deadline" && HAS_VALUE) {
+			config.DEADLINE_MS = atof(args[++i].c_str());
+			if (config.DEADLINE_MS < 0) {
+				cout << "The deadline cannot be negative" << endl;
+				printUsage(argv[0]);
+			}
+		}
+		else if (ARG == "--mask-ratio" && HAS_VALUE) {
+			config.MASK_RATIO = atof(args[++i].c_str());
+			if (config.MASK_RATIO <= 0) {
+				cout << "The mask ratio must be positive" << endl;
+				printUsage(argv[0]);
+			}
+		}
+		else if (ARG == "--rescore") {
+			config.RESCORE = true;
+		}
+		else if (ARG == "--sweep" && HAS_VALUE) {
+			const string VALUE = args[++i];
+			if (sscanf(VALUE.c_str(), "%lf:%lf:%lf", &config.SWEEP_FROM, &config.SWEEP_TO, &config.SWEEP_STEP) != 3
+			    || config.SWEEP_STEP <= 0 || config.SWEEP_FROM > config.SWEEP_TO) {
+				cout << "The sweep must be FROM:TO:STEP with FROM <= TO and a positive STEP" << endl;
+				printUsage(argv[0]);
+			}
+		}
+		else if (ARG == "--sample-ci" && HAS_VALUE) {
+			config.SAMPLE_CI = atof(args[++i].c_str());
+			if (config.SAMPLE_CI < 0) {
+				cout << "The sampling interval cannot be negative" << endl;
+				printUsage(argv[0]);
+			}
+		}
+		else if (ARG == "--sample-confidence" && HAS_VALUE) {
+			config.SAMPLE_CONFIDENCE = atof(args[++i].c_str());
+			if (config.SAMPLE_CONFIDENCE <= 0 || config.SAMPLE_CONFIDENCE >= 1) {
+				cout << "The confidence level must be between 0 and 1" << endl;
+				printUsage(argv[0]);
+			}
+		}
+		else if (ARG == "--sample-strata" && HAS_VALUE) {
+			const string VALUE = args[++i];
+			if (VALUE == "folder") {
+				config.SAMPLE_STRATA = SampleStrata::FOLDER;
+			}
+			else if (VALUE == "label") {
+				config.SAMPLE_STRATA = SampleStrata::LABEL;
+			}
+			else {
+				cout << "Unknown strata: " << VALUE << endl;
+				printUsage(argv[0]);
+			}
+		}
+		else if (ARG == "--sample-seed" && HAS_VALUE) {
+			config.SAMPLE_SEED = atoi(args[++i].c_str());
+		}
+		else if (ARG == "--dedup") {
+			config.DEDUP = true;
+		}
+		else if (ARG == "--dedup-distance" && HAS_VALUE) {
+			config.DEDUP_DISTANCE = atoi(args[++i].c_str());
+			if (config.DEDUP_DISTANCE < 0 || config.DEDUP_DISTANCE > 64) {
+				cout << "The dedup distance must be between 0 and 64" << endl;
+				printUsage(argv[0]);
+			}
+		}
+		else if (ARG == "--dedup-window" && HAS_VALUE) {
+			config.DEDUP_WINDOW = atoi(args[++i].c_str());
+			if (config.DEDUP_WINDOW < 1) {
+				cout << "The dedup window must be positive" << endl;
+				printUsage(argv[0]);
+			}
+		}
+		else if (ARG == "--video" && HAS_VALUE) {
+			config.VIDEO_PATH = args[++i];
+		}
+		else if (ARG == "--frame-stride" && HAS_VALUE) {
+			config.FRAME_STRIDE = atoi(args[++i].c_str());
+			if (config.FRAME_STRIDE < 1) {
+				cout << "The frame stride must be positive" << endl;
+				printUsage(argv[0]);
+			}
+		}
+		else if (ARG == "--frame-interval" && HAS_VALUE) {
+			config.FRAME_INTERVAL_MS = atof(args[++i].c_str());
+			if (config.FRAME_INTERVAL_MS < 0) {
+				cout << "The frame interval cannot be negative" << endl;
+				printUsage(argv[0]);
+			}
+		}
+		else if (ARG == "--log-level" && HAS_VALUE) {
+			const string VALUE = args[++i];
+			if (!parseLogLevel(VALUE, config.LOG_LEVEL)) {
+				cout << "Unknown log level: " << VALUE << endl;
+				printUsage(argv[0]);
+			}
+		}
+		else if (ARG == "--annotate" && HAS_VALUE) {
+			config.ANNOTATION_PATH = args[++i];
+			if (config.ANNOTATION_SAMPLING == AnnotationSampling::NONE) {
+				config.ANNOTATION_SAMPLING = AnnotationSampling::EVERY_N;
+			}
+		}
+		else if (ARG == "--annotate-every" && HAS_VALUE) {
+			config.ANNOTATION_EVERY = atoi(args[++i].c_str());
+			if (config.ANNOTATION_EVERY < 1) {
+				cout << "The annotation period must be positive" << endl;
+				printUsage(argv[0]);
+			}
+		}
+		else if (ARG == "--annotate-failures") {
+			config.ANNOTATION_SAMPLING = AnnotationSampling::FAILURES;
+		}
+		else if (ARG == "--allocation-report") {
+			config.ALLOCATION_REPORT = true;
+		}
+		else if (ARG == "--allocation-check" && HAS_VALUE) {
+			config.ALLOCATION_CHECK = atoi(args[++i].c_str());
+			if (config.ALLOCATION_CHECK < 1) {
+				cout << "The allocation check must cover at least one image" << endl;
+				printUsage(argv[0]);
+			}
+		}
+		else if (ARG == "--compare-eye-search") {
+			config.COMPARE_EYE_SEARCH = true;
+		}
+		else if (ARG == "--check-eye-search" && HAS_VALUE) {
+			config.CHECK_EYE_SEARCH = atoi(args[++i].c_str());
+			if (config.CHECK_EYE_SEARCH < 1) {
+				cout << "The eye search check must cover at least one image" << endl;
+				printUsage(argv[0]);
+			}
+		}
+		else {
+			if (ARG != "--help") {
+				cout << "Unknown argument: " << ARG << endl;
+			}
+			printUsage(argv[0]);
+		}
+	}
+	if (config.EXPORT_CSV && config.RESULTS_PATH.empty()) {
+		cout << "--export-csv needs the results to convert, given by --results" << endl;
+		printUsage(argv[0]);
+	}
+	if (config.RESCORE && config.RESULTS_PATH.empty()) {
+		cout << "--rescore needs the results to re-score, given by --results" << endl;
+		printUsage(argv[0]);
+	}
+	if (config.RESUME && config.CHECKPOINT_PATH.empty()) {
+		cout << "--resume needs the checkpoint to resume from, given by --checkpoint" << endl;
+		printUsage(argv[0]);
+	}
+	// The columnar results are only complete once the run finishes, so there is nothing to resume them from
+	if (!config.CHECKPOINT_PATH.empty() && !config.RESULTS_PATH.empty()) {
+		cout << "--checkpoint only supports the csv output" << endl;
+		printUsage(argv[0]);
+	}
+	// A sample skips images in a random order, so it cannot resume from a checkpoint, and it reads the images from their paths
+	// Reading ahead would read every image of the dataset while the sample is listed, only to throw the bytes away
+	if (config.SAMPLE_CI > 0 && (!config.CHECKPOINT_PATH.empty() || !config.CONTAINER_PATH.empty() || config.READ_DEPTH > 0)) {
+		cout << "--sample-ci cannot be combined with --checkpoint, --container, or --read-depth" << endl;
+		printUsage(argv[0]);
+	}
+	// The frames of a video are not files, so neither the per image outputs nor the resumable and sampled runs apply to them
+	if (!config.VIDEO_PATH.empty() && (!config.RESULTS_PATH.empty() || !config.CHECKPOINT_PATH.empty() || config.SAMPLE_CI > 0 || config.ALLOCATION_CHECK > 0)) {
+		cout << "--video only writes the csv output and cannot be combined with --results, --checkpoint, --sample-ci, or --allocation-check" << endl;
+		printUsage(argv[0]);
+	}
+	if (config.FACE_DETECTION.MAX_FACE > 0 && config.FACE_DETECTION.MAX_FACE < config.FACE_DETECTION.MIN_FACE) {
+		cout << "The maximum face size cannot be smaller than the minimum face size" << endl;
+		printUsage(argv[0]);
+	}
+	// Sampling options only take effect along with a directory to write to
+	if (config.ANNOTATION_PATH.empty()) {
+		config.ANNOTATION_SAMPLING = AnnotationSampling::NONE;
+	}
+	return config;
+}
+
+#endif //MAIN_CONFIG_H
@@ -0,0 +1,219 @@
+// container.h
+// Description: A packed dataset container concatenating the test images into one file with an index of their offsets, labels, and face counts
+// Assumptions: The container is memory mapped and the images are decoded straight from the mapping, so a run makes no system call per image
+
+#ifndef MAIN_CONTAINER_H
+#define MAIN_CONTAINER_H
+
+// Import the necessary libraries for i/o and file mapping
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "headers/imagesource.h"
+#include "headers/logger.h"
+#include "headers/mappedfile.h"
+
+// Declaring the namespaces that would be used throughout the program
+using namespace std;
+
+// Identifies a container file and the version of its layout
+const uint32_t CONTAINER_MAGIC = 0x4B43504D;  // "MPCK"
+const uint32_t CONTAINER_VERSION = 1;
+// Images start on this boundary so each one begins on its own cache line
+const uint64_t CONTAINER_ALIGNMENT = 64;
+
+// Layout of a container file: the header, the encoded images, the index, and the pool holding the image names
+//          image_count:  Number of images and index records
+//          index_offset: Offset of the first index record
+//          pool_offset:  Offset of the string pool
+//          pool_size:    Bytes in the string pool
+struct ContainerHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t image_count;
+	uint64_t index_offset;
+	uint64_t pool_offset;
+	uint64_t pool_size;
+};
+
+// An image in the container
+//          data_offset, data_size:   Encoded image bytes, as they were on disk
+//          name_offset, name_length: Path of the image relative to the packed directory, in the string pool
+//          image_id, faces:          Ground truth parsed from the file name
+struct ContainerEntry {
+	uint64_t data_offset;
+	uint64_t data_size;
+	uint64_t name_offset;
+	uint32_t name_length;
+	int32_t image_id;
+	int32_t faces;
+	uint8_t with_mask;
+	uint8_t padding[3];
+};
+
+// The records are mapped in place, so their layout must not depend on the compiler's padding
+static_assert(sizeof(ContainerHeader) == 40 && sizeof(ContainerEntry) == 40, "Unexpected container record layout");
+
+// Writes zeros up to the next multiple of the container alignment
+// Parameters:
+//          container: The container being written
+//          offset:    Current size of the container, advanced past the padding
+// Pre-condition:  N/A
+// Post-condition: Returns false if the padding could not be written
+bool writePadding(FILE* container, uint64_t& offset) {
+	const char ZEROS[CONTAINER_ALIGNMENT] = {};
+	const uint64_t PADDING = (CONTAINER_ALIGNMENT - offset % CONTAINER_ALIGNMENT) % CONTAINER_ALIGNMENT;
+	offset += PADDING;
+	return fwrite(ZEROS, 1, PADDING, container) == PADDING;
+}
+
+// Packs the images of a source into a container file
+// Parameters:
+//          images: Source of the images to pack
+//          ROOT:   Directory the image paths start with; it is stripped from the names stored in the container
+//          PATH:   Location of the container
+// Pre-condition:  The images are readable
+// Post-condition: Returns false if the container could not be written; unreadable images are logged and left out
+bool packImages(ImageSource& images, const string& ROOT, const string& PATH) {
+	const string TEMPORARY_PATH = PATH + ".tmp";
+	FILE* container = fopen(TEMPORARY_PATH.c_str(), "wb");
+	if (container == nullptr) {
+		return false;
+	}
+	vector<ContainerEntry> index;
+	string pool;
+	vector<char> buffer;
+	ContainerHeader header{};
+	bool written = fwrite(&header, sizeof(header), 1, container) == 1;
+	uint64_t offset = sizeof(header);
+
+	ImageEntry image;
+	while (written && images.next(image)) {
+		// Images read ahead by the source come with their bytes
+		string_view bytes = image.bytes;
+		if (bytes.empty()) {
+			FILE* input = fopen(image.path.c_str(), "rb");
+			if (input == nullptr) {
+				logger().log(LogLevel::WARNING, "image_unreadable", image.path);
+				continue;
+			}
+			fseek(input, 0, SEEK_END);
+			buffer.resize(size_t(max(0L, ftell(input))));
+			fseek(input, 0, SEEK_SET);
+			const bool READ = fread(buffer.data(), 1, buffer.size(), input) == buffer.size();
+			fclose(input);
+			if (!READ || buffer.empty()) {
+				logger().log(LogLevel::WARNING, "image_unreadable", image.path);
+				continue;
+			}
+			bytes = string_view(buffer.data(), buffer.size());
+		}
+
+		// Padding up to the alignment of the next image
+		written = writePadding(container, offset) && fwrite(bytes.data(), 1, bytes.size(), container) == bytes.size();
+
+		string_view name = image.path;
+		if (name.substr(0, ROOT.size()) == ROOT) {
+			name.remove_prefix(ROOT.size());
+		}
+		while (!name.empty() && name.front() == '/') {
+			name.remove_prefix(1);
+		}
+		ContainerEntry entry{};
+		entry.data_offset = offset;
+		entry.data_size = bytes.size();
+		entry.name_offset = pool.size();
+		entry.name_length = uint32_t(name.size());
+		entry.image_id = image.image_id;
+		entry.faces = image.faces;
+		entry.with_mask = image.with_mask;
+		index.push_back(entry);
+		pool.append(name);
+		offset += bytes.size();
+	}
+
+	// The index is mapped in place, so it starts aligned too
+	written = written && writePadding(container, offset);
+	header.magic = CONTAINER_MAGIC;
+	header.version = CONTAINER_VERSION;
+	header.image_count = index.size();
+	header.index_offset = offset;
+	header.pool_offset = offset + index.size() * sizeof(ContainerEntry);
+	header.pool_size = pool.size();
+	written = written && fwrite(index.data(), sizeof(ContainerEntry), index.size(), container) == index.size();
+	written = written && fwrite(pool.data(), 1, pool.size(), container) == pool.size();
+	// The header is written last so a partially written container is never accepted
+	written = written && fseek(container, 0, SEEK_SET) == 0 && fwrite(&header, sizeof(header), 1, container) == 1;
+	written = fclose(container) == 0 && written;
+	if (!written) {
+		remove(TEMPORARY_PATH.c_str());
+		return false;
+	}
+	logger().log(LogLevel::INFO, "images_packed", PATH, (long long)index.size(), true);
+	return rename(TEMPORARY_PATH.c_str(), PATH.c_str()) == 0;
+}
+
+// Produces the images of a memory mapped container along with their encoded bytes
+class ContainerSource : public ImageSource {
+public:
+	// Parameters:
+	//          PATH: Location of the container
+	explicit ContainerSource(const string& PATH) : path(PATH) {
+		if (!map()) {
+			logger().log(LogLevel::ERROR, "invalid_container", PATH);
+			exit(0);
+		}
+	}
+
+	// The path of an image is the container path followed by the image name, and its bytes point into the mapping
+	bool next(ImageEntry& entry) override {
+		if (next_image == header->image_count) {
+			return false;
+		}
+		const ContainerEntry& RECORD = index[next_image++];
+		entry.path.assign(path);
+		entry.path.push_back('/');
+		entry.path.append(pool + RECORD.name_offset, RECORD.name_length);
+		entry.bytes = string_view(file.data() + RECORD.data_offset, RECORD.data_size);
+		entry.with_mask = RECORD.with_mask != 0;
+		entry.image_id = RECORD.image_id;
+		entry.faces = RECORD.faces;
+		return true;
+	}
+
+private:
+	// Maps the container and checks that every record lies within it
+	bool map() {
+		if (!file.open(path) || file.size() < sizeof(ContainerHeader)) {
+			return false;
+		}
+		header = reinterpret_cast<const ContainerHeader*>(file.data());
+		if (header->magic != CONTAINER_MAGIC || header->version != CONTAINER_VERSION) {
+			return false;
+		}
+		if (header->index_offset + header->image_count * sizeof(ContainerEntry) != header->pool_offset || header->pool_offset + header->pool_size != file.size()) {
+			return false;
+		}
+		index = reinterpret_cast<const ContainerEntry*>(file.data() + header->index_offset);
+		pool = file.data() + header->pool_offset;
+		for (uint64_t i = 0; i < header->image_count; i++) {
+			if (index[i].data_offset + index[i].data_size > header->index_offset || index[i].name_offset + index[i].name_length > header->pool_size) {
+				return false;
+			}
+		}
+		// The images are read front to back
+		file.adviseSequential();
+		return true;
+	}
+
+	const string path;
+	MappedFile file;
+	const ContainerHeader* header = nullptr;
+	const ContainerEntry* index = nullptr;
+	const char* pool = nullptr;
+	uint64_t next_image = 0;
+};
+
+#endif //MAIN_CONTAINER_H
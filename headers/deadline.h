@@ -0,0 +1,77 @@
+// deadline.h
+// Description: A per image latency budget along with running estimates of the cost of the expensive stages, so the detection can drop work it cannot afford
+// Assumptions: The cost of a stage grows with the number of pixels it searches, and its cost per pixel changes slowly from one image to the next,
+//              so an exponentially weighted average of its recent costs per pixel predicts the next run on an image of any size
+
+#ifndef MAIN_DEADLINE_H
+#define MAIN_DEADLINE_H
+
+// Import the necessary libraries for timing
+#include <chrono>
+#include <cstdint>
+#include "headers/results.h"
+
+// Declaring the namespaces that would be used throughout the program
+using namespace std;
+
+// Stages whose cost is estimated
+//          FACE_PASS: One face cascade over the pre-processed image, at full size or downscaled
+//          EYE_PASS:  One eye cascade over one face
+enum DeadlineStage { FACE_PASS, EYE_PASS, DEADLINE_STAGE_COUNT };
+
+// Factor the pre-processed image is shrunk by when a full face cascade pass does not fit in the remaining budget
+const double DEADLINE_DOWNSCALE = 0.5;
+// Weight of the latest cost in the running estimate of a stage
+const double DEADLINE_COST_WEIGHT = 0.1;
+// Runs of a stage left out of its estimate, since the first calls pay for one-time costs (lazy initialisation, cold caches) the later ones do not
+const int DEADLINE_WARM_UP_RUNS = 1;
+
+// Tracks the budget of the image being processed and the degradations it needed
+class Deadline {
+public:
+	// Parameters:
+	//          BUDGET_MS: Time allowed per image, from the start of its loading to the end of its detection
+	explicit Deadline(const double BUDGET_MS) : budget_ms(BUDGET_MS) {}
+
+	// Starts the budget of an image
+	void start(const chrono::steady_clock::time_point START) {
+		start_time = START;
+		degradations = NOT_DEGRADED;
+	}
+
+	double remainingMs() const {
+		return budget_ms - chrono::duration<double, milli>(chrono::steady_clock::now() - start_time).count();
+	}
+
+	// Returns true if COUNT runs of the stage, each over PIXELS pixels, are expected to finish within the budget; stages not yet measured are assumed to fit
+	bool affords(const DeadlineStage STAGE, const double PIXELS, const int COUNT = 1) const {
+		return remainingMs() >= COUNT * PIXELS * estimates[STAGE];
+	}
+
+	// Folds the cost of a run of a stage over PIXELS pixels that started at START into its estimate of the cost per pixel
+	// Full size and downscaled face passes share their estimate, so a slow pass is outweighed by the passes after it whichever size they search
+	void record(const DeadlineStage STAGE, const double PIXELS, const chrono::steady_clock::time_point START) {
+		const double COST = chrono::duration<double, milli>(chrono::steady_clock::now() - START).count();
+		runs[STAGE] += 1;
+		if (runs[STAGE] <= DEADLINE_WARM_UP_RUNS || PIXELS <= 0) {
+			return;
+		}
+		const double COST_PER_PIXEL = COST / PIXELS;
+		estimates[STAGE] = runs[STAGE] > DEADLINE_WARM_UP_RUNS + 1 ? (1 - DEADLINE_COST_WEIGHT) * estimates[STAGE] + DEADLINE_COST_WEIGHT * COST_PER_PIXEL : COST_PER_PIXEL;
+	}
+
+	// Notes a degradation of the current image
+	void degrade(const Degradation DEGRADATION) { degradations |= DEGRADATION; }
+
+	// Degradations of the current image, as a combination of Degradation flags
+	uint8_t degradation() const { return degradations; }
+
+private:
+	const double budget_ms;
+	chrono::steady_clock::time_point start_time = chrono::steady_clock::now();
+	double estimates[DEADLINE_STAGE_COUNT] = {};
+	long long runs[DEADLINE_STAGE_COUNT] = {};
+	uint8_t degradations = NOT_DEGRADED;
+};
+
+#endif //MAIN_DEADLINE_H
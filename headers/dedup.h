@@ -0,0 +1,131 @@
+// dedup.h
+// Description: A difference hash of every decoded image and an index of the hashes of the recent images, so near-duplicate images reuse an earlier result
+//              instead of running the detection again
+// Assumptions: Near-duplicates (burst shots, static scenes, re-encoded copies) come close to each other in the run and have the same size,
+//              and two images whose hashes differ in only a few bits show the same faces at the same place
+
+#ifndef MAIN_DEDUP_H
+#define MAIN_DEDUP_H
+
+// Import the necessary libraries for opencv
+#include <cstdint>
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include "headers/config.h"
+#include "headers/results.h"
+
+// Declaring the namespaces that would be used throughout the program
+// We can use 2 namespaces as long as there aren't any conflicts
+using namespace std;
+using namespace cv;
+
+// Size of the gray image the difference hash is computed on; each row gives DHASH_WIDTH - 1 bits
+const int DHASH_WIDTH = 9, DHASH_HEIGHT = 8;
+
+// Returns the number of bits that differ between two hashes
+int hammingDistance(uint64_t first, const uint64_t SECOND) {
+	first ^= SECOND;
+	int distance = 0;
+	while (first != 0) {
+		first &= first - 1;
+		distance += 1;
+	}
+	return distance;
+}
+
+// The results of the recently processed images, looked up by the difference hash of their decoded image
+class DuplicateIndex {
+public:
+	// Parameters:
+	//          WINDOW:   Number of recent images kept in the index
+	//          DISTANCE: Largest Hamming distance between two hashes for the images to count as duplicates
+	DuplicateIndex(const int WINDOW, const int DISTANCE) : entries(WINDOW), max_distance(DISTANCE) {}
+
+	// Returns the difference hash of an image: bit i of row r is set when pixel i is brighter than pixel i + 1 in row r of the image shrunk to DHASH_WIDTH x DHASH_HEIGHT
+	// Pre-condition:  The image is a non-empty BGR or gray image
+	// Post-condition: The buffers of the index are reused, so hashing allocates nothing after the first image
+	uint64_t hash(const Mat& IMAGE) {
+		if (IMAGE.channels() == 1) {
+			resize(IMAGE, tiny, Size(DHASH_WIDTH, DHASH_HEIGHT), 0, 0, INTER_AREA);
+		}
+		else {
+			// Shrinking first, so the color conversion only touches DHASH_WIDTH x DHASH_HEIGHT pixels
+			resize(IMAGE, tiny_color, Size(DHASH_WIDTH, DHASH_HEIGHT), 0, 0, INTER_AREA);
+			cvtColor(tiny_color, tiny, COLOR_BGR2GRAY);
+		}
+		uint64_t result = 0;
+		for (int r = 0; r < DHASH_HEIGHT; r++) {
+			const uchar* ROW = tiny.ptr<uchar>(r);
+			for (int i = 0; i + 1 < DHASH_WIDTH; i++) {
+				result = (result << 1) | (ROW[i] > ROW[i + 1] ? 1 : 0);
+			}
+		}
+		return result;
+	}
+
+	// Looks for the closest recent image of the same size and options
+	// Parameters:
+	//          HASH:     Difference hash of the image
+	//          IMAGE:    The decoded image
+	//          CONFIG:   Options the image is processed with
+	//          faces:    Receives the per face results of the duplicate, if any
+	//          distance: Receives the Hamming distance to the duplicate, if any
+	// Pre-condition:  N/A
+	// Post-condition: Returns true if a duplicate was found within the distance; the most recent one wins a tie
+	bool find(const uint64_t HASH, const Mat& IMAGE, const Config& CONFIG, FaceResults& faces, int& distance) const {
+		const Entry* best = nullptr;
+		int best_distance = max_distance + 1;
+		for (int i = 1; i <= count; i++) {
+			const Entry& ENTRY = entries[(next + int(entries.size()) - i) % int(entries.size())];
+			if (ENTRY.config != &CONFIG || ENTRY.rows != IMAGE.rows || ENTRY.cols != IMAGE.cols) {
+				continue;
+			}
+			const int DISTANCE = hammingDistance(HASH, ENTRY.hash);
+			if (DISTANCE < best_distance) {
+				best = &ENTRY;
+				best_distance = DISTANCE;
+			}
+		}
+		if (best == nullptr) {
+			return false;
+		}
+		faces.clear();
+		for (auto &face: best->faces) {
+			faces.push_back(face);
+		}
+		distance = best_distance;
+		return true;
+	}
+
+	// Adds the results of an image, replacing those of the oldest image once the window is full
+	void add(const uint64_t HASH, const Mat& IMAGE, const Config& CONFIG, const FaceResults& FACES) {
+		Entry& entry = entries[next];
+		entry.hash = HASH;
+		entry.rows = IMAGE.rows;
+		entry.cols = IMAGE.cols;
+		entry.config = &CONFIG;
+		entry.faces.clear();
+		for (auto &face: FACES) {
+			entry.faces.push_back(face);
+		}
+		next = (next + 1) % int(entries.size());
+		count = min(count + 1, int(entries.size()));
+	}
+
+private:
+	// A recent image: its hash, its size, the options it was processed with, and its per face results
+	struct Entry {
+		uint64_t hash = 0;
+		int rows = 0, cols = 0;
+		const Config* config = nullptr;
+		FaceResults faces;
+	};
+
+	vector<Entry> entries;
+	const int max_distance;
+	int next = 0, count = 0;
+	Mat tiny_color, tiny;
+};
+
+#endif //MAIN_DEDUP_H
@@ -0,0 +1,107 @@
+// evaluation.h
+// Description: Tallies of a run, the confusion matrix, and the summary metrics used to evaluate the mask detection results against the ground truth
+// Assumptions: A face wearing a mask is the positive class
+
+#ifndef MAIN_EVALUATION_H
+#define MAIN_EVALUATION_H
+
+// Import the necessary libraries for i/o
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include "headers/results.h"
+
+// Declaring the namespaces that would be used throughout the program
+using namespace std;
+
+// Counts of the mask decisions made on faces from masked and non-masked images
+//          true_positives:  Faces from masked images detected as masked
+//          false_negatives: Faces from masked images detected as non-masked
+//          false_positives: Faces from non-masked images detected as masked
+//          true_negatives:  Faces from non-masked images detected as non-masked
+struct ConfusionMatrix {
+	long long true_positives = 0, false_negatives = 0, false_positives = 0, true_negatives = 0;
+
+	double accuracy() const {
+		const long long TOTAL = true_positives + false_negatives + false_positives + true_negatives;
+		return TOTAL == 0 ? 0 : double(true_positives + true_negatives) / double(TOTAL);
+	}
+
+	double precision() const {
+		return true_positives + false_positives == 0 ? 0 : double(true_positives) / double(true_positives + false_positives);
+	}
+
+	double recall() const {
+		return true_positives + false_negatives == 0 ? 0 : double(true_positives) / double(true_positives + false_negatives);
+	}
+
+	double f1() const {
+		const double PRECISION = precision(), RECALL = recall();
+		return PRECISION + RECALL == 0 ? 0 : 2 * PRECISION * RECALL / (PRECISION + RECALL);
+	}
+};
+
+// Tallies of a run of the mask detection algorithm over a set of images
+//          masked_counts:          Skipped faces (eye and face issues), masked faces, and non-masked faces over the masked images
+//          not_masked_counts:      The same counts over the non-masked images
+//          ground_truth_masks:     Number of faces in the masked images
+//          ground_truth_no_masks:  Number of faces in the non-masked images
+//          images:                 Number of images processed
+//          seconds:                Wall clock time spent processing the images
+//          warm_images:            Images processed after the allocation warm-up
+//          warm_heap_allocations:  Heap allocations made by the Mat pool on the detection thread over those images
+//          warm_new_calls:         Calls to the global operator new on the detection thread over those images, outside of OpenCV's decoding and cascade scans
+//          warm_library_new_calls: Calls to the global operator new inside OpenCV's decoding and cascade scans over those images
+//          quarantined:            Images that could not be read or decoded and were left out of the counts
+//          degraded:               Images that dropped work to meet their deadline
+//          over_deadline:          Images that took longer than their deadline anyway
+//          latencies_ms:           Time from the start of the loading to the end of the detection of every image, kept when there is a deadline
+//          reused:                 Images whose results were copied from a recent near-duplicate
+struct RunSummary {
+	DetectionCounts masked_counts, not_masked_counts;
+	int ground_truth_masks = 0, ground_truth_no_masks = 0;
+	int images = 0;
+	double seconds = 0;
+	int warm_images = 0;
+	long long warm_heap_allocations = 0, warm_new_calls = 0, warm_library_new_calls = 0;
+	vector<string> quarantined;
+	int degraded = 0, over_deadline = 0;
+	vector<float> latencies_ms;
+	int reused = 0;
+
+	// Faces from masked images count as positives and faces from non-masked images as negatives
+	ConfusionMatrix confusionMatrix() const {
+		ConfusionMatrix matrix;
+		matrix.true_positives = masked_counts.masked;
+		matrix.false_negatives = masked_counts.not_masked;
+		matrix.false_positives = not_masked_counts.masked;
+		matrix.true_negatives = not_masked_counts.not_masked;
+		return matrix;
+	}
+};
+
+// Prints the header of the metrics table printed by printMetricsRow
+// Parameters:
+//          LABEL: Title of the first column
+// Pre-condition:  N/A
+// Post-condition: The column titles are displayed in the console
+void printMetricsHeader(const string& LABEL) {
+	cout << left << setw(12) << LABEL << right << setw(12) << "Images/sec" << setw(10) << "Accuracy" << setw(11) << "Precision" << setw(8) << "Recall" << setw(10) << "F1-Score" << endl;
+}
+
+// Prints one row of the metrics table with the throughput and the summary metrics of a confusion matrix
+// Parameters:
+//          LABEL:             Value of the first column
+//          IMAGES_PER_SECOND: Measured throughput of the run
+//          MATRIX:            Confusion matrix of the run
+// Pre-condition:  N/A
+// Post-condition: The row is displayed in the console with the metrics as percentages
+void printMetricsRow(const string& LABEL, const double IMAGES_PER_SECOND, const ConfusionMatrix& MATRIX) {
+	cout << left << setw(12) << LABEL << right << fixed << setprecision(1) << setw(12) << IMAGES_PER_SECOND
+	     << setw(9) << 100 * MATRIX.accuracy() << "%" << setw(10) << 100 * MATRIX.precision() << "%"
+	     << setw(7) << 100 * MATRIX.recall() << "%" << setw(9) << 100 * MATRIX.f1() << "%" << endl;
+	cout.unsetf(ios::fixed);
+}
+
+#endif //MAIN_EVALUATION_H
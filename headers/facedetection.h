@@ -10,8 +10,10 @@
 #include <vector>
 #include <string>
 #include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
 #include <opencv2/objdetect.hpp>
 #include "headers/helper.h"
+#include "headers/config.h"
 
 // Declaring the namespaces that would be used throughout the program
 // We can use 2 namespaces as long as there aren't any conflicts
@@ -21,40 +23,79 @@ using namespace cv;
 // The face detection function uses a face cascade classifier to detect faces from an image
 // Parameters:
 //          IMAGE:               The original image used for mask detection
-//          PRE_PROCESSED_IMAGE: The pre-processed image
+//          PRE_PROCESSED_IMAGE: The pre-processed image, possibly downscaled from the image
 //          face_cascade:        Cascade classifier object for face detection
+//          PARAMS:              Parameters of the multi-scale search
+//          faces:               Receives the bounding boxes of the detected faces
+//          cropped_faces:       Receives the faces cropped out of the image, sharing its pixels
 //          DEBUG_MODE:          To control the image display outputs
 // Pre-condition: The images and cascade classifier objects should be valid
-// Post-condition: The faces detected in the image are first displayed if running in debug mode and then returned to the caller function as a vector of matrices
-vector<Mat> faceDetection (const Mat& IMAGE, const Mat& PRE_PROCESSED_IMAGE, CascadeClassifier face_cascade, const bool DEBUG_MODE) {
+// Post-condition: The faces detected in the image are first displayed if running in debug mode and then handed to the caller function as a vector of matrices along with their bounding boxes
+//                 The bounding boxes are in the coordinates of the image even when the faces were searched on a downscaled image
+//                 Both vectors are cleared and refilled, so vectors kept across images stop allocating once they have grown
+template <bool DEBUG_MODE>
+void faceDetection (const Mat& IMAGE, const Mat& PRE_PROCESSED_IMAGE, CascadeClassifier face_cascade, const FaceDetectionParams& PARAMS, vector<Rect>& faces, vector<Mat>& cropped_faces) {
 
 	// Detecting faces in the image
-	print("Detecting faces in the image", DEBUG_MODE);
-	vector<Rect> faces;
-	vector<Mat> cropped_faces;
+	print<DEBUG_MODE>("Detecting faces in the image");
+	cropped_faces.clear();
 	const Scalar COLOR = Scalar(255, 0, 255);
 	const int THICKNESS = 1;
-	face_cascade.detectMultiScale(PRE_PROCESSED_IMAGE, faces);
+	// The face size limits and the boxes are scaled between the image and a downscaled pre-processed image
+	const double SCALE = double(IMAGE.cols) / PRE_PROCESSED_IMAGE.cols;
+	const int MIN_FACE = int(PARAMS.MIN_FACE / SCALE), MAX_FACE = int(PARAMS.MAX_FACE / SCALE);
+	{
+		// The candidate lists detectMultiScale builds on every call are OpenCV's own allocations
+		const LibraryAllocations LIBRARY;
+		face_cascade.detectMultiScale(PRE_PROCESSED_IMAGE, faces, PARAMS.SCALE_FACTOR, PARAMS.MIN_NEIGHBORS, 0, Size(MIN_FACE, MIN_FACE), Size(MAX_FACE, MAX_FACE));
+	}
+	if (PRE_PROCESSED_IMAGE.cols != IMAGE.cols) {
+		for (auto &face: faces) {
+			face = Rect(int(face.x * SCALE), int(face.y * SCALE), int(face.width * SCALE), int(face.height * SCALE)) & Rect(0, 0, IMAGE.cols, IMAGE.rows);
+		}
+	}
 
 	for (auto & i : faces) {
-		Point pt1(i.x - 1, i.y - 1);
-		Point pt2(i.x + i.width + 1, i.y + i.height + 1);
-		rectangle(IMAGE, pt1, pt2, COLOR, THICKNESS);
+		if constexpr (DEBUG_MODE) {
+			Point pt1(i.x - 1, i.y - 1);
+			Point pt2(i.x + i.width + 1, i.y + i.height + 1);
+			rectangle(IMAGE, pt1, pt2, COLOR, THICKNESS);
+		}
 		cropped_faces.push_back(IMAGE(Range(i.y, i.y + i.height), Range(i.x, i.x + i.width)));
 	}
-	print("Faces count: " + to_string(faces.size()), DEBUG_MODE);
+	print<DEBUG_MODE>("Faces count: ", faces.size());
 
-	display("Faces detected", IMAGE, DEBUG_MODE);
+	display<DEBUG_MODE>("Faces detected", IMAGE);
 
 	// Displaying cropped faces from the original image
-	print("Displaying cropped faces from the original image", DEBUG_MODE);
-	if (DEBUG_MODE) {
+	print<DEBUG_MODE>("Displaying cropped faces from the original image");
+	if constexpr (DEBUG_MODE) {
 		for (auto &face: cropped_faces) {
-			display("Cropped Face", face, DEBUG_MODE);
+			display<DEBUG_MODE>("Cropped Face", face);
 		}
 	}
+}
 
-	return cropped_faces;
+// Resamples the cropped faces to a canonical square size so the cost of the per face stages does not depend on how close the face was to the camera
+// Parameters:
+//          CROPPED_FACES:    A vector of matrices with cropped face images
+//          SIZE:             Width and height of the resampled faces in pixels
+//          normalized_faces: Receives the faces resampled to the canonical size
+//          DEBUG_MODE:       To control the image display outputs
+// Pre-condition: The vector contains valid matrices with cropped face images and the size is positive
+// Post-condition: The vector is cleared and refilled with new matrices holding the resampled faces; the cropped faces are left untouched
+template <bool DEBUG_MODE>
+void normalizeFaceSize (const vector<Mat>& CROPPED_FACES, const int SIZE, vector<Mat>& normalized_faces) {
+	print<DEBUG_MODE>("Resampling the faces to ", SIZE, "x", SIZE);
+	normalized_faces.clear();
+	for (auto &face: CROPPED_FACES) {
+		// Area interpolation avoids aliasing when shrinking while linear interpolation is smoother when enlarging
+		normalized_faces.emplace_back();
+		Mat& normalized = normalized_faces.back();
+		const int INTERPOLATION = face.cols > SIZE ? INTER_AREA : INTER_LINEAR;
+		resize(face, normalized, Size(SIZE, SIZE), 0, 0, INTERPOLATION);
+		display<DEBUG_MODE>("Normalized Face", normalized);
+	}
 }
 
 #endif //MAIN_FACEDETECTION_H
@@ -0,0 +1,38 @@
+// hash.h
+// Description: A fast non-cryptographic hash of a block of bytes, used to key the on-disk caches by the content of the encoded images
+// Assumptions: The hashes only need to tell apart inputs that were not crafted to collide
+
+#ifndef MAIN_HASH_H
+#define MAIN_HASH_H
+
+// Import the necessary libraries for memory access
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+// Declaring the namespaces that would be used throughout the program
+using namespace std;
+
+// A 64-bit hash of a block of bytes, mixing eight bytes at a time
+// Parameters:
+//          BYTES: The bytes to hash
+//          SEED:  Starting value, used to chain several hashes
+// Pre-condition:  N/A
+// Post-condition: Returns the hash of the bytes
+uint64_t hashBytes(const string_view BYTES, uint64_t SEED = 0x9E3779B97F4A7C15ULL) {
+	const uint64_t MULTIPLIER = 0xBF58476D1CE4E5B9ULL;
+	uint64_t hash = SEED ^ (BYTES.size() * MULTIPLIER);
+	size_t i = 0;
+	for (; i + 8 <= BYTES.size(); i += 8) {
+		uint64_t word;
+		memcpy(&word, BYTES.data() + i, 8);
+		hash = (hash ^ (word * MULTIPLIER)) * 0x94D049BB133111EBULL;
+		hash ^= hash >> 31;
+	}
+	uint64_t tail = 0;
+	memcpy(&tail, BYTES.data() + i, BYTES.size() - i);
+	hash = (hash ^ (tail * MULTIPLIER)) * 0x94D049BB133111EBULL;
+	return hash ^ (hash >> 29);
+}
+
+#endif //MAIN_HASH_H
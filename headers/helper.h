@@ -7,16 +7,22 @@
 
 // Import the necessary libraries for opencv and i/o
 #include <iostream>
-#include <filesystem>
+#include <sstream>
 #include <opencv2/core.hpp>
 #include <opencv2/highgui.hpp>
+#include <opencv2/imgcodecs.hpp>
 #include <opencv2/objdetect.hpp>
+#include "headers/allocator.h"
+#include "headers/logger.h"
+#include "headers/multicascade.h"
 
 // Declaring the namespaces that would be used throughout the program
 // We can use 2 namespaces as long as there aren't any conflicts
 using namespace std;
 using namespace cv;
 
+// The debug mode is a template parameter in every function so release builds compile the display, drawing, and console output away
+//
 // If running in debug mode, displays image in the specified window, waits for the user's input to change, and then destroys the created window if its not closed
 // Parameters:
 //          WINNAME:    String used to represent the window name which will be used to display the image
@@ -25,8 +31,9 @@ using namespace cv;
 //          SCALE:      Value used to scale the image down before displaying it
 // Pre-condition:  The program expects the arguments to be a string, an image, a boolean, and an integer
 // Post-condition: The image is displayed in a window with the window name passed to the function and then the window will be destroyed
-void display(const string& WINNAME, const Mat& IMG, const bool DEBUG_MODE, const int SCALE = 1) {
-	if (DEBUG_MODE) {
+template <bool DEBUG_MODE>
+void display(const string& WINNAME, const Mat& IMG, const int SCALE = 1) {
+	if constexpr (DEBUG_MODE) {
 		namedWindow(WINNAME, WINDOW_AUTOSIZE);
 		resizeWindow(WINNAME, IMG.cols / SCALE, IMG.rows / SCALE);
 
@@ -38,69 +45,89 @@ void display(const string& WINNAME, const Mat& IMG, const bool DEBUG_MODE, const
 	}
 }
 
+// Returns the imread flags decoding a color image at 1/SCALE of its size
+// Parameters:
+//          SCALE: 1, 2, 4, or 8
+// Pre-condition:  N/A
+// Post-condition: JPEG images are decoded at the reduced size directly, which is much cheaper than decoding them in full and resizing them
+int decodeFlags(const int SCALE) {
+	switch (SCALE) {
+		case 2: return IMREAD_REDUCED_COLOR_2;
+		case 4: return IMREAD_REDUCED_COLOR_4;
+		case 8: return IMREAD_REDUCED_COLOR_8;
+		default: return IMREAD_COLOR;
+	}
+}
+
 // Reads an image with the specified name from the current directory and displays (if running in debug mode) and returns it
 // Parameters:
 //          PATH:       Location containing the image
 //          WINNAME:    A window name for displaying the image
+//          SCALE:      The image is decoded at 1/SCALE of its size (1, 2, 4, or 8)
 //          DEBUG_MODE: To control the image display outputs
 // Pre-condition:   The program expects the path to point to a valid jpg image, the winname to be a string, and the debug_mode to be a boolean
-// Post-condition:  The image is displayed in a window with the window name same as the filename if in debug mode and then the image is returned
-Mat readDisplay(const string &PATH, const string& WINNAME, const bool DEBUG_MODE) {
-	Mat img = imread(PATH);
-	// If the image is empty, exit the program
+// Post-condition:  The image is displayed in a window with the window name same as the filename if in debug mode and then the image is returned;
+//                  an empty image is returned if the file cannot be read
+template <bool DEBUG_MODE>
+Mat readDisplay(const string &PATH, const string& WINNAME, const int SCALE = 1) {
+	Mat img;
+	{
+		// The codec objects imread builds for every image are OpenCV's own allocations
+		const LibraryAllocations LIBRARY;
+		img = imread(PATH, decodeFlags(SCALE));
+	}
+	// If the image is empty, leave it to the caller to skip it
 	if (img.empty()) {
-		cout << "Invalid path: " << PATH << endl;
-		exit(0);
+		logger().log(LogLevel::WARNING, "invalid_path", PATH);
+		return img;
 	}
-	display(WINNAME, img, DEBUG_MODE);
+	display<DEBUG_MODE>(WINNAME, img);
 	return img;
 }
 
-// If running in debug mode, outputs a text to the console
+// Decodes an image already held in memory and displays (if running in debug mode) and returns it
 // Parameters:
-//          TEXT:       Text to be displayed
+//          BYTES:      The encoded image
+//          PATH:       Name of the image, used to report a corrupt image
+//          WINNAME:    A window name for displaying the image
+//          SCALE:      The image is decoded at 1/SCALE of its size (1, 2, 4, or 8)
 //          DEBUG_MODE: To control the image display outputs
-// Pre-condition:   The program expects a string as the text and a boolean for debug mode
-// Post-condition:  Displays the text in console if running in debug mode
-void print(const string &TEXT, const bool DEBUG_MODE) {
-	if (DEBUG_MODE) {
-		cout << TEXT << endl;
+// Pre-condition:   The program expects the bytes to hold a valid jpg image
+// Post-condition:  The image is displayed in a window with the window name passed to the function if in debug mode and then the image is returned;
+//                  an empty image is returned if the bytes cannot be decoded
+template <bool DEBUG_MODE>
+Mat decodeDisplay(const string_view BYTES, const string& PATH, const string& WINNAME, const int SCALE = 1) {
+	// Wrapping the bytes without copying them; imdecode only reads from them
+	const Mat ENCODED(1, int(BYTES.size()), CV_8U, const_cast<char*>(BYTES.data()));
+	Mat img;
+	{
+		// The codec objects imdecode builds for every image are OpenCV's own allocations
+		const LibraryAllocations LIBRARY;
+		img = imdecode(ENCODED, decodeFlags(SCALE));
+	}
+	// If the image cannot be decoded, leave it to the caller to skip it
+	if (img.empty()) {
+		logger().log(LogLevel::WARNING, "invalid_image", PATH);
+		return img;
 	}
+	display<DEBUG_MODE>(WINNAME, img);
+	return img;
 }
 
-// Fetches the list of jpg filenames recursively from the directory and extracts the relevant information from the file name
+// If running in debug mode, outputs a text to the console through the asynchronous logger at the debug level
+// The pieces of the text are only streamed in debug mode, so release builds do not build any string for it
 // Parameters:
-//          DIRECTORY_PATH: Path to the directory containing the files
-//          DEBUG_MODE:     To control the image display outputs
-// Pre-condition:   The program expects a valid path for the directory and a boolean for debug mode
-// Post-condition:  Returns the list of jpg file_paths from the directory and data about the file type, image id, and number of faces
-vector<vector<string>> getFileNames(const string& DIRECTORY_PATH, const bool DEBUG_MODE) {
-	vector<vector<string>> files;
-	// Getting the filenames from the directory
-	print("Getting the filenames from the directory", DEBUG_MODE);
-	for (const auto& entry: filesystem::recursive_directory_iterator(DIRECTORY_PATH)) {
-		vector<string> file_data;
-		if (entry.is_regular_file() && entry.path().extension() == ".jpg") {
-			string file_path = entry.path().string();
-			string file_name = entry.path().filename().string();
-			file_data.push_back(file_path);
-			if (file_name.substr(0, file_name.find('_')) == "with") {
-				file_data.emplace_back("With Mask");
-			}
-			else {
-				file_data.emplace_back("Without Mask");
-			}
-			auto first_underscore = file_name.find('_');
-			auto second_underscore = file_name.find('_', first_underscore + 1);
-			auto third_underscore = file_name.find('_', second_underscore + 1);
-			auto fourth_underscore = file_name.rfind('_');
-			auto dot = file_name.rfind('.');
-			file_data.push_back(file_name.substr(second_underscore + 1, third_underscore - second_underscore - 1));
-			file_data.push_back(file_name.substr(fourth_underscore + 1, dot - fourth_underscore - 1));
-			files.push_back(file_data);
-		}
+//          TEXT:       Pieces of the text to be displayed, e.g., print<DEBUG_MODE>("Faces count: ", faces.size())
+//          DEBUG_MODE: To control the image display outputs
+// Pre-condition:   The program expects streamable values as the text and a boolean for debug mode
+// Post-condition:  Queues the text for the console if running in debug mode
+template <bool DEBUG_MODE, typename... Pieces>
+void print(const Pieces&... TEXT) {
+	if constexpr (DEBUG_MODE) {
+		ostringstream text;
+		(text << ... << TEXT);
+		logger().log(LogLevel::DEBUG, "debug", text.str());
 	}
-	return files;
 }
 
 // Loads the specified cascade file and returns it
@@ -109,15 +136,38 @@ vector<vector<string>> getFileNames(const string& DIRECTORY_PATH, const bool DEB
 //          DEBUG_MODE: To control the image display outputs
 // Pre-condition:   The program expects a valid path for the cascade file and a boolean for debug mode
 // Post-condition:  Returns the loaded cascade classifier object
-CascadeClassifier loadCascade(const string& FILENAME, const bool DEBUG_MODE) {
+template <bool DEBUG_MODE>
+CascadeClassifier loadCascade(const string& FILENAME) {
 	// Loading the cascade xml file
-	print("Loading the cascade xml file", DEBUG_MODE);
+	print<DEBUG_MODE>("Loading the cascade xml file");
 	CascadeClassifier cascade;
 	if(!cascade.load(FILENAME)) {
-		cout << "Error loading the cascade file: " << FILENAME << endl;
+		logger().log(LogLevel::ERROR, "cascade_load_failed", FILENAME);
 		exit(0);
 	}
 	return cascade;
 }
 
+// Loads the specified cascade files to be scanned together and returns them
+// Parameters:
+//          FILENAMES:  Paths to the cascade files
+//          DEBUG_MODE: To control the image display outputs
+// Pre-condition:   The program expects valid paths for cascade files of HAAR features with the same window size and a boolean for debug mode
+// Post-condition:  Returns the loaded cascades
+template <bool DEBUG_MODE>
+MultiCascade loadMultiCascade(const vector<string>& FILENAMES) {
+	// Loading the cascade xml files
+	print<DEBUG_MODE>("Loading the cascade xml files to scan together");
+	MultiCascade cascades;
+	if(!cascades.load(FILENAMES)) {
+		ostringstream filenames;
+		for (size_t i = 0; i < FILENAMES.size(); i++) {
+			filenames << (i > 0 ? ", " : "") << FILENAMES[i];
+		}
+		logger().log(LogLevel::ERROR, "cascade_load_failed", filenames.str());
+		exit(0);
+	}
+	return cascades;
+}
+
 #endif //MAIN_HELPER_H
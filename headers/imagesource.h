@@ -0,0 +1,80 @@
+// imagesource.h
+// Description: The test image entries consumed by the mask detection run and the interface of the sources producing them
+// Assumptions: Image file names follow the dataset convention <with|without>_mask_<image id>_count_<faces>.jpg
+
+#ifndef MAIN_IMAGESOURCE_H
+#define MAIN_IMAGESOURCE_H
+
+// Import the necessary libraries for strings
+#include <charconv>
+#include <string>
+#include <string_view>
+
+// Declaring the namespaces that would be used throughout the program
+using namespace std;
+
+// A test image along with the ground truth parsed from its file name
+//          path:      Location of the image
+//          with_mask: Whether the faces in the image wear masks
+//          image_id:  Number identifying the image within its class
+//          faces:     Number of faces in the image
+//          bytes:     The encoded image if the source already holds it in memory (e.g., mapped from a container), or empty to read it from the path;
+//                     only valid until the next image is taken from the source
+//          unreadable: Set by a source reading ahead when it could not read the image, which then has no bytes and should be quarantined
+struct ImageEntry {
+	string path;
+	string_view bytes;
+	bool with_mask = false;
+	int image_id = 0;
+	int faces = 0;
+	bool unreadable = false;
+};
+
+// Produces the test images of a run one at a time, so a run can start before every image is known
+class ImageSource {
+public:
+	virtual ~ImageSource() = default;
+
+	// Stores the next image in entry; returns false once every image has been produced
+	virtual bool next(ImageEntry& entry) = 0;
+};
+
+// Returns whether a file name has the extension of the test images
+// Parameters:
+//          FILE_NAME: Name of the file
+// Pre-condition:  N/A
+// Post-condition: Returns true for jpg file names
+bool isImageFile(const string_view FILE_NAME) {
+	const string_view EXTENSION = ".jpg";
+	return FILE_NAME.size() > EXTENSION.size() && FILE_NAME.substr(FILE_NAME.size() - EXTENSION.size()) == EXTENSION;
+}
+
+// Parses the ground truth out of an image file name
+// Parameters:
+//          FILE_NAME: Name of the file without its directory
+//          entry:     Receives the label, image id, and number of faces (the path is left untouched)
+// Pre-condition:  N/A
+// Post-condition: Returns false if the name is not a jpg image following the dataset convention
+bool parseImageName(const string_view FILE_NAME, ImageEntry& entry) {
+	if (!isImageFile(FILE_NAME)) {
+		return false;
+	}
+	const size_t FIRST_UNDERSCORE = FILE_NAME.find('_');
+	const size_t SECOND_UNDERSCORE = FILE_NAME.find('_', FIRST_UNDERSCORE + 1);
+	const size_t THIRD_UNDERSCORE = FILE_NAME.find('_', SECOND_UNDERSCORE + 1);
+	const size_t LAST_UNDERSCORE = FILE_NAME.rfind('_');
+	const size_t DOT = FILE_NAME.rfind('.');
+	if (THIRD_UNDERSCORE == string_view::npos || LAST_UNDERSCORE < THIRD_UNDERSCORE) {
+		return false;
+	}
+	entry.with_mask = FILE_NAME.substr(0, FIRST_UNDERSCORE) == "with";
+
+	// Parsing the numbers in place instead of copying them out into strings first
+	const char* ID_END = FILE_NAME.data() + THIRD_UNDERSCORE;
+	const char* FACES_END = FILE_NAME.data() + DOT;
+	const auto ID = from_chars(FILE_NAME.data() + SECOND_UNDERSCORE + 1, ID_END, entry.image_id);
+	const auto FACES = from_chars(FILE_NAME.data() + LAST_UNDERSCORE + 1, FACES_END, entry.faces);
+	return ID.ec == errc() && ID.ptr == ID_END && FACES.ec == errc() && FACES.ptr == FACES_END;
+}
+
+#endif //MAIN_IMAGESOURCE_H
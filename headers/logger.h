@@ -0,0 +1,221 @@
+// logger.h
+// Description: An asynchronous structured logger; threads append fixed size records to their own lock-free ring and a background thread drains the rings to the console
+// Assumptions: Logging must never block the pipeline, so records are dropped (and counted) when a ring is full
+
+#ifndef MAIN_LOGGER_H
+#define MAIN_LOGGER_H
+
+// Import the necessary libraries for i/o and threading
+#include <cctype>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Declaring the namespaces that would be used throughout the program
+using namespace std;
+
+// Severity of a log record; records below the logger's level are discarded before anything is copied
+enum class LogLevel : uint8_t { DEBUG, INFO, WARNING, ERROR };
+
+// Number of records each thread can have waiting for the drain thread (a power of two)
+const uint32_t LOG_RING_CAPACITY = 1024;
+// Longest text copied into a record; longer texts are truncated
+const int LOG_TEXT_LENGTH = 96;
+// How long the drain thread sleeps when every ring is empty
+const chrono::milliseconds LOG_DRAIN_INTERVAL(5);
+
+// One log record, written by the logging thread and formatted by the drain thread
+//          time_ns:  Nanoseconds since the logger started
+//          event:    Name of the event; must be a string literal since only the pointer is stored
+//          value:    Optional number attached to the event
+//          text:     Optional text attached to the event (e.g., a file path)
+struct LogRecord {
+	int64_t time_ns;
+	const char* event;
+	long long value;
+	LogLevel level;
+	bool has_value;
+	uint16_t text_length;
+	char text[LOG_TEXT_LENGTH];
+};
+
+// Single producer single consumer ring of records owned by one thread
+struct LogRing {
+	LogRecord records[LOG_RING_CAPACITY];
+	atomic<uint32_t> head{0}, tail{0};
+	atomic<uint64_t> dropped{0};
+	uint64_t reported_dropped = 0;
+	int thread_number = 0;
+};
+
+// Returns the name of a log level as printed in the records
+// Parameters:
+//          LEVEL: The log level
+// Pre-condition:  N/A
+// Post-condition: The upper case name of the level is returned
+const char* logLevelName(const LogLevel LEVEL) {
+	switch (LEVEL) {
+		case LogLevel::DEBUG: return "DEBUG";
+		case LogLevel::INFO: return "INFO";
+		case LogLevel::WARNING: return "WARNING";
+		default: return "ERROR";
+	}
+}
+
+class Logger {
+public:
+	Logger() : start(chrono::steady_clock::now()) {
+		drain_thread = thread([this] { drainLoop(); });
+	}
+
+	// Stops the drain thread after writing out every record still waiting in the rings
+	~Logger() {
+		running = false;
+		drain_thread.join();
+		drain();
+		for (LogRing* ring: rings) {
+			delete ring;
+		}
+	}
+
+	void setLevel(const LogLevel LEVEL) { level = uint8_t(LEVEL); }
+
+	bool enabled(const LogLevel LEVEL) const { return uint8_t(LEVEL) >= level.load(memory_order_relaxed); }
+
+	// Appends a record to the ring of the calling thread, or drops it if the ring is full
+	// Parameters:
+	//          LEVEL: Severity of the record
+	//          EVENT: Name of the event (string literal)
+	//          TEXT:  Text attached to the event
+	//          VALUE: Number attached to the event, if HAS_VALUE is true
+	// Pre-condition:  EVENT points to a string that outlives the logger
+	// Post-condition: The record is queued for the drain thread or counted as dropped
+	void log(const LogLevel LEVEL, const char* EVENT, const string_view TEXT = {}, const long long VALUE = 0, const bool HAS_VALUE = false) {
+		if (!enabled(LEVEL)) {
+			return;
+		}
+		LogRing& ring = threadRing();
+		const uint32_t HEAD = ring.head.load(memory_order_relaxed);
+		if (HEAD - ring.tail.load(memory_order_acquire) >= LOG_RING_CAPACITY) {
+			ring.dropped.fetch_add(1, memory_order_relaxed);
+			return;
+		}
+		LogRecord& record = ring.records[HEAD & (LOG_RING_CAPACITY - 1)];
+		record.time_ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+		record.event = EVENT;
+		record.value = VALUE;
+		record.level = LEVEL;
+		record.has_value = HAS_VALUE;
+		record.text_length = uint16_t(min(TEXT.size(), size_t(LOG_TEXT_LENGTH)));
+		memcpy(record.text, TEXT.data(), record.text_length);
+		ring.head.store(HEAD + 1, memory_order_release);
+	}
+
+	// Writes out every record logged so far, e.g., before printing a summary to the same console
+	void flush() { drain(); }
+
+private:
+	LogRing& threadRing() {
+		thread_local LogRing* ring = nullptr;
+		if (ring == nullptr) {
+			lock_guard<mutex> lock(rings_mutex);
+			ring = new LogRing();
+			ring->thread_number = int(rings.size());
+			rings.push_back(ring);
+		}
+		return *ring;
+	}
+
+	void drainLoop() {
+		while (running) {
+			if (drain() == 0) {
+				this_thread::sleep_for(LOG_DRAIN_INTERVAL);
+			}
+		}
+	}
+
+	// Formats the waiting records of every ring into one buffer and writes it with a single call
+	size_t drain() {
+		lock_guard<mutex> drain_lock(drain_mutex);
+		string batch;
+		size_t records = 0;
+		char line[LOG_TEXT_LENGTH + 256];
+		lock_guard<mutex> rings_lock(rings_mutex);
+		for (LogRing* ring: rings) {
+			const uint32_t HEAD = ring->head.load(memory_order_acquire);
+			uint32_t tail = ring->tail.load(memory_order_relaxed);
+			for (; tail != HEAD; tail++) {
+				const LogRecord& RECORD = ring->records[tail & (LOG_RING_CAPACITY - 1)];
+				int length = snprintf(line, sizeof(line), "time=%.3fms level=%s thread=%d event=%s", RECORD.time_ns / 1e6, logLevelName(RECORD.level), ring->thread_number, RECORD.event);
+				if (RECORD.text_length > 0) {
+					length += snprintf(line + length, sizeof(line) - length, " text=\"%.*s\"", int(RECORD.text_length), RECORD.text);
+				}
+				if (RECORD.has_value) {
+					length += snprintf(line + length, sizeof(line) - length, " value=%lld", RECORD.value);
+				}
+				batch.append(line, min(size_t(length), sizeof(line) - 1));
+				batch.push_back('\n');
+				records += 1;
+			}
+			ring->tail.store(tail, memory_order_release);
+
+			const uint64_t DROPPED = ring->dropped.load(memory_order_relaxed);
+			if (DROPPED != ring->reported_dropped) {
+				const int LENGTH = snprintf(line, sizeof(line), "level=WARNING thread=%d event=records_dropped value=%llu\n", ring->thread_number, (unsigned long long)(DROPPED - ring->reported_dropped));
+				batch.append(line, LENGTH);
+				ring->reported_dropped = DROPPED;
+			}
+		}
+		if (!batch.empty()) {
+			fwrite(batch.data(), 1, batch.size(), stdout);
+			fflush(stdout);
+		}
+		return records;
+	}
+
+	const chrono::steady_clock::time_point start;
+	atomic<uint8_t> level{uint8_t(LogLevel::INFO)};
+	atomic<bool> running{true};
+	mutex rings_mutex, drain_mutex;
+	vector<LogRing*> rings;
+	thread drain_thread;
+};
+
+// Returns the logger shared by the whole program, starting its drain thread on first use
+// Parameters: N/A
+// Pre-condition:  N/A
+// Post-condition: The same logger object is returned on every call
+Logger& logger() {
+	static Logger instance;
+	return instance;
+}
+
+// Parses the name of a log level
+// Parameters:
+//          NAME:  debug, info, warning, or error
+//          level: Receives the parsed level
+// Pre-condition:  N/A
+// Post-condition: Returns false if the name is not a log level
+bool parseLogLevel(const string& NAME, LogLevel& level) {
+	const LogLevel LEVELS[] = {LogLevel::DEBUG, LogLevel::INFO, LogLevel::WARNING, LogLevel::ERROR};
+	for (const LogLevel LEVEL: LEVELS) {
+		string name = logLevelName(LEVEL);
+		for (auto &c: name) {
+			c = char(tolower(c));
+		}
+		if (name == NAME) {
+			level = LEVEL;
+			return true;
+		}
+	}
+	return false;
+}
+
+#endif //MAIN_LOGGER_H
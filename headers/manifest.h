@@ -0,0 +1,324 @@
+// manifest.h
+// Description: A compact binary manifest of the dataset, built once and then memory mapped so repeated runs start without enumerating the tree
+// Assumptions: Adding, removing, or renaming an image changes the modification time of its directory, so only directories whose time changed are listed again;
+//              the records only hold what the file names tell, so rewriting an image in place leaves its record valid
+
+#ifndef MAIN_MANIFEST_H
+#define MAIN_MANIFEST_H
+
+// Import the necessary libraries for i/o and file mapping
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+#include <sys/stat.h>
+#include "headers/imagesource.h"
+#include "headers/logger.h"
+#include "headers/mappedfile.h"
+#include "headers/scanner.h"
+
+// Declaring the namespaces that would be used throughout the program
+using namespace std;
+
+// Identifies a manifest file and the version of its layout
+const uint32_t MANIFEST_MAGIC = 0x464E414D;  // "MANF"
+const uint32_t MANIFEST_VERSION = 2;
+
+// Layout of a manifest file: the header, the directories, the images grouped by directory, and the pool holding every string
+//          root_offset, root_length: Directory the manifest was built from, in the string pool
+//          directory_count:          Number of directory records
+//          entry_count:              Number of image records
+//          pool_size:                Bytes in the string pool
+struct ManifestHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t root_offset;
+	uint32_t root_length;
+	uint32_t directory_count;
+	uint64_t entry_count;
+	uint64_t pool_size;
+};
+
+// A directory of the dataset and the range of its images
+//          path_offset, path_length: Path of the directory, in the string pool
+//          first_entry, entry_count: Images of the directory in the image records
+//          mtime_ns:                 Modification time of the directory when it was listed
+struct ManifestDirectory {
+	uint64_t path_offset;
+	uint32_t path_length;
+	uint32_t entry_count;
+	uint64_t first_entry;
+	int64_t mtime_ns;
+};
+
+// An image of the dataset with the ground truth parsed from its name
+//          name_offset, name_length: File name of the image, in the string pool
+//          directory:                Index of the directory record holding the image
+struct ManifestEntry {
+	uint64_t name_offset;
+	uint32_t name_length;
+	uint32_t directory;
+	int32_t image_id;
+	int32_t faces;
+	uint8_t with_mask;
+	uint8_t padding[7];
+};
+
+// The records are mapped in place, so their layout must not depend on the compiler's padding
+static_assert(sizeof(ManifestHeader) == 40 && sizeof(ManifestDirectory) == 32 && sizeof(ManifestEntry) == 32, "Unexpected manifest record layout");
+
+// Returns the modification time of a file in nanoseconds
+// Parameters:
+//          PATH:     Location of the file or directory
+//          mtime_ns: Receives the modification time
+// Pre-condition:  N/A
+// Post-condition: Returns false if the file does not exist
+bool fileTimes(const string& PATH, int64_t& mtime_ns) {
+	struct stat status;
+	if (stat(PATH.c_str(), &status) != 0) {
+		return false;
+	}
+#ifdef __APPLE__
+	mtime_ns = int64_t(status.st_mtimespec.tv_sec) * 1000000000 + status.st_mtimespec.tv_nsec;
+#else
+	mtime_ns = int64_t(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec;
+#endif
+	return true;
+}
+
+// Collects the records of a new manifest and writes them out
+class ManifestBuilder {
+public:
+	explicit ManifestBuilder(const string& ROOT) : root_offset(addString(ROOT)), root_length(uint32_t(ROOT.size())) {}
+
+	// Starts the records of a directory; the images added next belong to it
+	void addDirectory(const string_view PATH, const int64_t MTIME_NS) {
+		ManifestDirectory directory{};
+		directory.path_offset = addString(PATH);
+		directory.path_length = uint32_t(PATH.size());
+		directory.first_entry = entries.size();
+		directory.mtime_ns = MTIME_NS;
+		directories.push_back(directory);
+	}
+
+	// Adds an image to the directory started last
+	void addEntry(const string_view NAME, const ImageEntry& IMAGE) {
+		ManifestEntry entry{};
+		entry.name_offset = addString(NAME);
+		entry.name_length = uint32_t(NAME.size());
+		entry.directory = uint32_t(directories.size() - 1);
+		entry.image_id = IMAGE.image_id;
+		entry.faces = IMAGE.faces;
+		entry.with_mask = IMAGE.with_mask;
+		entries.push_back(entry);
+		directories.back().entry_count += 1;
+	}
+
+	// Writes the manifest next to its final location and then renames it, so readers never see a partial file
+	// Returns false if the file could not be written
+	bool write(const string& PATH) const {
+		const string TEMPORARY_PATH = PATH + ".tmp";
+		FILE* file = fopen(TEMPORARY_PATH.c_str(), "wb");
+		if (file == nullptr) {
+			return false;
+		}
+		ManifestHeader header{};
+		header.magic = MANIFEST_MAGIC;
+		header.version = MANIFEST_VERSION;
+		header.root_offset = root_offset;
+		header.root_length = root_length;
+		header.directory_count = uint32_t(directories.size());
+		header.entry_count = entries.size();
+		header.pool_size = pool.size();
+		bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+		written = written && fwrite(directories.data(), sizeof(ManifestDirectory), directories.size(), file) == directories.size();
+		written = written && fwrite(entries.data(), sizeof(ManifestEntry), entries.size(), file) == entries.size();
+		written = written && fwrite(pool.data(), 1, pool.size(), file) == pool.size();
+		written = fclose(file) == 0 && written;
+		return written && rename(TEMPORARY_PATH.c_str(), PATH.c_str()) == 0;
+	}
+
+private:
+	uint64_t addString(const string_view TEXT) {
+		const uint64_t OFFSET = pool.size();
+		pool.append(TEXT);
+		return OFFSET;
+	}
+
+	string pool;
+	const uint64_t root_offset;
+	const uint32_t root_length;
+	vector<ManifestDirectory> directories;
+	vector<ManifestEntry> entries;
+};
+
+// Produces the images recorded in a memory mapped manifest, refreshing the manifest first if the dataset changed
+class ManifestSource : public ImageSource {
+public:
+	// Parameters:
+	//          ROOT: Directory containing the test images
+	//          PATH: Location of the manifest, created if missing
+	ManifestSource(const string& ROOT, const string& PATH) {
+		if (!refresh(ROOT, PATH)) {
+			logger().log(LogLevel::ERROR, "manifest_write_failed", PATH);
+			exit(0);
+		}
+	}
+
+	bool next(ImageEntry& entry) override {
+		if (next_entry == header->entry_count) {
+			return false;
+		}
+		const ManifestEntry& RECORD = entry_records[next_entry++];
+		const ManifestDirectory& DIRECTORY = directory_records[RECORD.directory];
+		entry.path.assign(pool + DIRECTORY.path_offset, DIRECTORY.path_length);
+		entry.path.push_back('/');
+		entry.path.append(pool + RECORD.name_offset, RECORD.name_length);
+		entry.bytes = {};
+		entry.with_mask = RECORD.with_mask != 0;
+		entry.image_id = RECORD.image_id;
+		entry.faces = RECORD.faces;
+		return true;
+	}
+
+private:
+	// Maps the manifest and points the record arrays into it
+	// Returns false if the file is missing, truncated, written by another version, or holds a record pointing outside of it
+	bool map(const string& PATH) {
+		if (!file.open(PATH) || file.size() < sizeof(ManifestHeader)) {
+			return false;
+		}
+		header = reinterpret_cast<const ManifestHeader*>(file.data());
+		if (header->magic != MANIFEST_MAGIC || header->version != MANIFEST_VERSION) {
+			return false;
+		}
+		const uint64_t DIRECTORIES_SIZE = uint64_t(header->directory_count) * sizeof(ManifestDirectory);
+		const uint64_t ENTRIES_SIZE = header->entry_count * sizeof(ManifestEntry);
+		if (file.size() != sizeof(ManifestHeader) + DIRECTORIES_SIZE + ENTRIES_SIZE + header->pool_size) {
+			return false;
+		}
+		directory_records = reinterpret_cast<const ManifestDirectory*>(file.data() + sizeof(ManifestHeader));
+		entry_records = reinterpret_cast<const ManifestEntry*>(file.data() + sizeof(ManifestHeader) + DIRECTORIES_SIZE);
+		pool = file.data() + sizeof(ManifestHeader) + DIRECTORIES_SIZE + ENTRIES_SIZE;
+
+		// Checking every string and range once, so the records can be followed without checks afterwards
+		if (!inPool(header->root_offset, header->root_length)) {
+			return false;
+		}
+		for (uint32_t i = 0; i < header->directory_count; i++) {
+			const ManifestDirectory& DIRECTORY = directory_records[i];
+			if (!inPool(DIRECTORY.path_offset, DIRECTORY.path_length) || DIRECTORY.first_entry > header->entry_count || DIRECTORY.entry_count > header->entry_count - DIRECTORY.first_entry) {
+				return false;
+			}
+		}
+		for (uint64_t i = 0; i < header->entry_count; i++) {
+			const ManifestEntry& RECORD = entry_records[i];
+			if (!inPool(RECORD.name_offset, RECORD.name_length) || RECORD.directory >= header->directory_count) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	bool inPool(const uint64_t OFFSET, const uint32_t LENGTH) const { return OFFSET <= header->pool_size && LENGTH <= header->pool_size - OFFSET; }
+
+	string_view poolString(const uint64_t OFFSET, const uint32_t LENGTH) const { return string_view(pool + OFFSET, LENGTH); }
+
+	// Reuses the records of every directory whose modification time is unchanged and lists the others again
+	// Returns false if a new manifest was needed but could not be written
+	bool refresh(const string& ROOT, const string& PATH) {
+		const bool MAPPED = map(PATH) && poolString(header->root_offset, header->root_length) == ROOT;
+		ManifestBuilder builder(ROOT);
+		unordered_set<string_view> known_directories;
+		vector<string> pending;
+		bool changed = !MAPPED;
+
+		if (MAPPED) {
+			for (uint32_t i = 0; i < header->directory_count; i++) {
+				known_directories.insert(poolString(directory_records[i].path_offset, directory_records[i].path_length));
+			}
+			for (uint32_t i = 0; i < header->directory_count; i++) {
+				const ManifestDirectory& DIRECTORY = directory_records[i];
+				const string DIRECTORY_PATH(poolString(DIRECTORY.path_offset, DIRECTORY.path_length));
+				int64_t mtime_ns;
+				// A removed directory is dropped along with its images
+				if (!fileTimes(DIRECTORY_PATH, mtime_ns)) {
+					changed = true;
+				}
+				else if (mtime_ns != DIRECTORY.mtime_ns) {
+					changed = true;
+					pending.push_back(DIRECTORY_PATH);
+				}
+				else {
+					builder.addDirectory(DIRECTORY_PATH, DIRECTORY.mtime_ns);
+					for (uint64_t j = DIRECTORY.first_entry; j < DIRECTORY.first_entry + DIRECTORY.entry_count; j++) {
+						const ManifestEntry& RECORD = entry_records[j];
+						ImageEntry image;
+						image.with_mask = RECORD.with_mask != 0;
+						image.image_id = RECORD.image_id;
+						image.faces = RECORD.faces;
+						builder.addEntry(poolString(RECORD.name_offset, RECORD.name_length), image);
+					}
+				}
+			}
+		}
+		else {
+			pending.push_back(ROOT);
+		}
+
+		// Listing the changed directories, and every new directory found under them in full
+		while (!pending.empty()) {
+			const string DIRECTORY_PATH = move(pending.back());
+			pending.pop_back();
+			int64_t mtime_ns;
+			if (!fileTimes(DIRECTORY_PATH, mtime_ns)) {
+				logger().log(LogLevel::WARNING, "directory_unreadable", DIRECTORY_PATH);
+				continue;
+			}
+			builder.addDirectory(DIRECTORY_PATH, mtime_ns);
+			vector<string> subdirectories;
+			readDirectory(DIRECTORY_PATH, subdirectories, [&](const string_view NAME) {
+				if (!isImageFile(NAME)) {
+					return true;
+				}
+				ImageEntry image;
+				if (!parseImageName(NAME, image)) {
+					logger().log(LogLevel::WARNING, "unparsed_file_name", DIRECTORY_PATH + "/" + string(NAME));
+				}
+				else {
+					builder.addEntry(NAME, image);
+				}
+				return true;
+			});
+			for (auto &subdirectory: subdirectories) {
+				if (known_directories.count(subdirectory) == 0) {
+					pending.push_back(move(subdirectory));
+				}
+			}
+		}
+
+		if (!changed) {
+			return true;
+		}
+		// The known directory names point into the old mapping, which the new manifest replaces
+		known_directories.clear();
+		file.close();
+		if (!builder.write(PATH)) {
+			return false;
+		}
+		logger().log(LogLevel::INFO, "manifest_rebuilt", PATH);
+		return map(PATH);
+	}
+
+	MappedFile file;
+	const ManifestHeader* header = nullptr;
+	const ManifestDirectory* directory_records = nullptr;
+	const ManifestEntry* entry_records = nullptr;
+	const char* pool = nullptr;
+	uint64_t next_entry = 0;
+};
+
+#endif //MAIN_MANIFEST_H
@@ -0,0 +1,77 @@
+// mappedfile.h
+// Description: A read-only (or copy-on-write) memory mapping of a whole file, used to load binary data files without copying them
+// Assumptions: POSIX mmap is available; the file is not truncated while it is mapped
+
+#ifndef MAIN_MAPPEDFILE_H
+#define MAIN_MAPPEDFILE_H
+
+// Import the necessary libraries for file mapping
+#include <string>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Declaring the namespaces that would be used throughout the program
+using namespace std;
+
+// Owns a read-only mapping of a file and unmaps it when destroyed
+class MappedFile {
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile() { close(); }
+
+	// Maps the whole file, replacing any previous mapping
+	// Parameters:
+	//          PATH:         Location of the file
+	//          PRIVATE_COPY: Maps the file copy-on-write, so the data can be modified without changing the file
+	// Pre-condition:  N/A
+	// Post-condition: Returns false if the file cannot be opened or mapped; an empty file maps to no data
+	bool open(const string& PATH, const bool PRIVATE_COPY = false) {
+		close();
+		const int FD = ::open(PATH.c_str(), O_RDONLY | O_CLOEXEC);
+		if (FD < 0) {
+			return false;
+		}
+		struct stat status;
+		bool mapped = fstat(FD, &status) == 0;
+		if (mapped && status.st_size > 0) {
+			void* address = PRIVATE_COPY ? mmap(nullptr, size_t(status.st_size), PROT_READ | PROT_WRITE, MAP_PRIVATE, FD, 0) : mmap(nullptr, size_t(status.st_size), PROT_READ, MAP_SHARED, FD, 0);
+			mapped = address != MAP_FAILED;
+			if (mapped) {
+				bytes = static_cast<const char*>(address);
+				length = size_t(status.st_size);
+			}
+		}
+		// The mapping stays valid after the descriptor is closed
+		::close(FD);
+		return mapped;
+	}
+
+	void close() {
+		if (bytes != nullptr) {
+			munmap(const_cast<char*>(bytes), length);
+		}
+		bytes = nullptr;
+		length = 0;
+	}
+
+	// Lets the kernel read ahead aggressively for a front to back pass over the file
+	void adviseSequential() const {
+		if (bytes != nullptr) {
+			madvise(const_cast<char*>(bytes), length, MADV_SEQUENTIAL);
+		}
+	}
+
+	const char* data() const { return bytes; }
+
+	size_t size() const { return length; }
+
+private:
+	const char* bytes = nullptr;
+	size_t length = 0;
+};
+
+#endif //MAIN_MAPPEDFILE_H
@@ -6,72 +6,228 @@
 #define MAIN_MASKDETECTION_H
 
 // Import the necessary libraries for opencv and i/o
+#include <chrono>
 #include <iostream>
 #include <vector>
 #include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
 #include "headers/helper.h"
-#include "headers/preprocessing.h"
+#include "headers/config.h"
+#include "headers/results.h"
 #include "headers/facedetection.h"
 #include "headers/postprocessing.h"
+#include "headers/stagestore.h"
+#include "headers/deadline.h"
 
 // Declaring the namespaces that would be used throughout the program
 // We can use 2 namespaces as long as there aren't any conflicts
 using namespace std;
 using namespace cv;
 
-// Runs the pre-processing, face detection, and post-processing steps on an image to determine whether a face in it is wearing a mask
+// Scratch vectors of the detection of an image, kept by the calling thread across images so they stop allocating once they have grown
+//          face_boxes:       Boxes of the detected faces
+//          cropped_faces:    The faces cropped out of the image
+//          normalized_faces: The faces resampled to the canonical size
+//          face_crs:         Cr components and thresholds of the faces
+//          stored_boxes:     Face boxes taken from or put into the stage store
+//          stored_regions:   Eye and oronasal regions taken from or put into the stage store
+//          stored_skin:      Skin pixel counts taken from or put into the stage store
+//          eye_buffers:      Scratch space of the eye search
+struct DetectionBuffers {
+	vector<Rect> face_boxes;
+	vector<Mat> cropped_faces, normalized_faces;
+	vector<FaceCr> face_crs;
+	vector<StoredBox> stored_boxes;
+	vector<StoredRegion> stored_regions;
+	vector<StoredSkin> stored_skin;
+	EyeBuffers eye_buffers;
+};
+
+// Crops the detected faces out of the image
 // Parameters:
-//          FILEPATH:          Path to the image
-//          FACE_HAAR_CASCADE: Haar Cascade classifier object for face detection
-//          FACE_LBP_CASCADE:  LBP Cascade classifier object for face detection
-//          LEFT_EYE_CASCADE:  Haar Cascade classifier object for left eye detection
-//          RIGHT_EYE_CASCADE: Haar Cascade classifier object for right eye detection
-//          EYE_GLASS_CASCADE: Haar Cascade classifier object for eyes (with or without glasses) detection
-//          DEBUG_MODE:        To control the image display outputs
-// Pre-condition:  The program expects the arguments to be valid and image to the available at the specified path
-// Post-condition: The counts of faces detected, masks detected, etc., are returned
-vector<int> maskDetection(const string& FILEPATH, const int faces, const CascadeClassifier& FACE_HAAR_CASCADE, const CascadeClassifier& FACE_LBP_CASCADE, const CascadeClassifier& LEFT_EYE_CASCADE, const CascadeClassifier& RIGHT_EYE_CASCADE, const CascadeClassifier& EYE_GLASS_CASCADE, const bool DEBUG_MODE) {
+//          IMAGE:         The image, as read from disk
+//          FACE_RESULTS:  Results of the faces holding their face boxes
+//          cropped_faces: Receives the cropped faces, sharing the pixels of the image, in the order of the results
+// Pre-condition:  The boxes lie within the image
+// Post-condition: The vector is cleared and refilled with the cropped faces
+void cropFaces(const Mat& IMAGE, const FaceResults& FACE_RESULTS, vector<Mat>& cropped_faces) {
+	cropped_faces.clear();
+	for (auto &face_result: FACE_RESULTS) {
+		const Rect& BOX = face_result.face;
+		cropped_faces.push_back(IMAGE(Range(BOX.y, BOX.y + BOX.height), Range(BOX.x, BOX.x + BOX.width)));
+	}
+}
 
-	int images_skipped = 0;
-	vector<int> results = {0, 0, 0};
-	// Reading an image which might have faces from disk and displaying it
-	print("Reading image from disk", DEBUG_MODE);
-	const Mat IMAGE = readDisplay(FILEPATH, "Image", DEBUG_MODE);
-	print(FILEPATH, true);
+// Runs the face detection and post-processing steps on a pre-processed image to determine whether a face in it is wearing a mask
+// Parameters:
+//          IMAGE:               The image, as read from disk
+//          PRE_PROCESSED_IMAGE: The image after preProcessing
+//          FACE_HAAR_CASCADE:   Haar Cascade classifier object for face detection
+//          FACE_LBP_CASCADE:    LBP Cascade classifier object for face detection
+//          LEFT_EYE_CASCADE:    Haar Cascade classifier object for left eye detection
+//          RIGHT_EYE_CASCADE:   Haar Cascade classifier object for right eye detection
+//          EYE_GLASS_CASCADE:   Haar Cascade classifier object for eyes (with or without glasses) detection
+//          shared_eye_cascades: The eye cascades loaded to be scanned together, used by the shared eye search
+//          CONFIG:              Run-time options holding the face cascades and their parameters, the eye search strategy, the canonical face size, and the mask ratio
+//          stages:              Store of the results of the face, eye, and skin stages, or nullptr to compute every stage
+//          KEYS:                Keys of the stages of the image, used along with the store
+//          deadline:            Budget of the image, or nullptr to run every stage in full
+//          buffers:             Scratch vectors of the calling thread, reused from image to image
+//          DEBUG_MODE:          To control the image display outputs
+// Pre-condition:  The program expects the arguments to be valid and the image to be non-empty, unless every stage of the image is stored
+// Post-condition: The boxes, skin counts, and decision of every detected face and the counts of faces detected, masks detected, etc., are returned
+//                 Stages found in the store are not computed, and the stages computed are added to it unless the image was degraded
+//                 With a deadline, the faces are searched on a downscaled image, the fallback cascade is skipped, or the eyeglasses cascade is skipped
+//                 when they no longer fit in the budget, and the result is flagged with the degradations
+template <bool DEBUG_MODE>
+ImageResult maskDetection(const Mat& IMAGE, const Mat& PRE_PROCESSED_IMAGE, const int faces, const CascadeClassifier& FACE_HAAR_CASCADE, const CascadeClassifier& FACE_LBP_CASCADE, const CascadeClassifier& LEFT_EYE_CASCADE, const CascadeClassifier& RIGHT_EYE_CASCADE, const CascadeClassifier& EYE_GLASS_CASCADE, MultiCascade& shared_eye_cascades, const Config& CONFIG, StageStore* stages, const StageKeys& KEYS, Deadline* deadline, DetectionBuffers& buffers) {
 
-	// Passing the image for pre-processing and receiving all modified images in the map object
-	print("Pre-processing", DEBUG_MODE);
-	const Mat PRE_PROCESSED_IMAGE = preProcessing(IMAGE, DEBUG_MODE);
+	ImageResult result;
+	vector<Rect>& face_boxes = buffers.face_boxes;
+	vector<Mat>& cropped_frontal_faces = buffers.cropped_faces;
+	vector<StoredBox>& stored_boxes = buffers.stored_boxes;
+	face_boxes.clear();
+	cropped_frontal_faces.clear();
+	if (stages != nullptr && stages->get(FACE_STAGE, KEYS.keys[FACE_STAGE], stored_boxes)) {
+		for (auto &box: stored_boxes) {
+			face_boxes.emplace_back(box.x, box.y, box.width, box.height);
+		}
+	}
+	else {
+		// Passing the images for face detection and receiving the set of faces from the image
+		const bool LBP_FIRST = CONFIG.FACE_CASCADES == FaceCascades::LBP_THEN_HAAR || CONFIG.FACE_CASCADES == FaceCascades::LBP;
+		const bool FALLBACK = CONFIG.FACE_CASCADES == FaceCascades::HAAR_THEN_LBP || CONFIG.FACE_CASCADES == FaceCascades::LBP_THEN_HAAR;
+		// Searching a downscaled image if a full pass no longer fits in the budget
+		Mat downscaled_image;
+		if (deadline != nullptr && !deadline->affords(FACE_PASS, double(PRE_PROCESSED_IMAGE.total()))) {
+			print<DEBUG_MODE>("Downscaling the image to meet the deadline");
+			resize(PRE_PROCESSED_IMAGE, downscaled_image, Size(), DEADLINE_DOWNSCALE, DEADLINE_DOWNSCALE, INTER_AREA);
+			deadline->degrade(DOWNSCALED);
+		}
+		const Mat& SEARCHED_IMAGE = downscaled_image.empty() ? PRE_PROCESSED_IMAGE : downscaled_image;
+		const double SEARCHED_PIXELS = double(SEARCHED_IMAGE.total());
 
-	// Passing the images for face detection and receiving the set of faces from the image
-	print("Face detection", DEBUG_MODE);
-	vector<Mat> cropped_frontal_faces = faceDetection(IMAGE, PRE_PROCESSED_IMAGE,FACE_HAAR_CASCADE, DEBUG_MODE);
+		print<DEBUG_MODE>("Face detection");
+		auto pass_start = chrono::steady_clock::now();
+		faceDetection<DEBUG_MODE>(IMAGE, SEARCHED_IMAGE, LBP_FIRST ? FACE_LBP_CASCADE : FACE_HAAR_CASCADE, CONFIG.FACE_DETECTION, face_boxes, cropped_frontal_faces);
+		if (deadline != nullptr) {
+			deadline->record(FACE_PASS, SEARCHED_PIXELS, pass_start);
+		}
 
-	// Trying LBP cascade classifier if no faces were detected by the haar cascade classifier
-	print("Trying LBP cascade classifier if no faces were detected by the haar cascade classifier", DEBUG_MODE);
-	if (cropped_frontal_faces.empty()) {
-		cropped_frontal_faces = faceDetection(IMAGE, PRE_PROCESSED_IMAGE,FACE_LBP_CASCADE,DEBUG_MODE);
-		// Exiting if no faces were found by the LBP cascade classifier too
+		// Trying the other cascade classifier if no faces were detected by the first one, unless it no longer fits in the budget
+		if (cropped_frontal_faces.empty() && FALLBACK && deadline != nullptr && !deadline->affords(FACE_PASS, SEARCHED_PIXELS)) {
+			print<DEBUG_MODE>("Skipping the other cascade classifier to meet the deadline");
+			deadline->degrade(FALLBACK_SKIPPED);
+		}
+		else if (cropped_frontal_faces.empty() && FALLBACK) {
+			print<DEBUG_MODE>("Trying the other cascade classifier since no faces were detected by the first one");
+			pass_start = chrono::steady_clock::now();
+			faceDetection<DEBUG_MODE>(IMAGE, SEARCHED_IMAGE, LBP_FIRST ? FACE_HAAR_CASCADE : FACE_LBP_CASCADE, CONFIG.FACE_DETECTION, face_boxes, cropped_frontal_faces);
+			if (deadline != nullptr) {
+				deadline->record(FACE_PASS, SEARCHED_PIXELS, pass_start);
+			}
+		}
+		// Exiting if no faces were found by the cascade classifiers
 		if (cropped_frontal_faces.empty()) {
-			print("Didn't detect any faces in the image", DEBUG_MODE);
-
+			print<DEBUG_MODE>("Didn't detect any faces in the image");
+		}
+		if (stages != nullptr && (deadline == nullptr || deadline->degradation() == NOT_DEGRADED)) {
+			stored_boxes.clear();
+			for (auto &box: face_boxes) {
+				stored_boxes.push_back(StoredBox{box.x, box.y, box.width, box.height});
+			}
+			stages->put(FACE_STAGE, KEYS.keys[FACE_STAGE], stored_boxes);
 		}
 	}
-	images_skipped = faces - int(cropped_frontal_faces.size());
-	if (!cropped_frontal_faces.empty()) {
-		// Passing the cropped face images for skin color segmentation and receiving Otsu thresholded Cr components of them
-		print("Skin color segmentation", DEBUG_MODE);
-		const vector<Mat> OTSU_CR_FACES = skinColorSegmentation(cropped_frontal_faces, DEBUG_MODE);
+	for (auto &face_box: face_boxes) {
+		FaceResult face_result;
+		face_result.face = face_box;
+		result.faces.push_back(face_result);
+	}
+	if (!face_boxes.empty()) {
+		// Taking the regions and the skin pixel counts from the store, which are only valid together with the regions they were counted in
+		vector<StoredRegion>& stored_regions = buffers.stored_regions;
+		vector<StoredSkin>& stored_skin = buffers.stored_skin;
+		const bool REGIONS_STORED = stages != nullptr && stages->get(EYE_STAGE, KEYS.keys[EYE_STAGE], stored_regions) && int(stored_regions.size()) == result.faces.size();
+		const bool SKIN_STORED = REGIONS_STORED && stages->get(SKIN_STAGE, KEYS.keys[SKIN_STAGE], stored_skin) && int(stored_skin.size()) == result.faces.size();
+		if (REGIONS_STORED) {
+			for (int i = 0; i < result.faces.size(); i++) {
+				const StoredRegion& REGION = stored_regions[size_t(i)];
+				result.faces[i].region = {REGION.left_x, REGION.eye_top_y, REGION.right_x, REGION.eye_bottom_nose_mouth_top_y, REGION.nose_mouth_bottom_y, REGION.eyes_detected != 0};
+			}
+		}
+		if (SKIN_STORED) {
+			for (int i = 0; i < result.faces.size(); i++) {
+				result.faces[i].eye_skin = stored_skin[size_t(i)].eye_skin;
+				result.faces[i].nose_mouth_skin = stored_skin[size_t(i)].nose_mouth_skin;
+			}
+		}
+		else {
+			// Faces taken from the store are cropped again from their boxes
+			if (cropped_frontal_faces.empty()) {
+				cropFaces(IMAGE, result.faces, cropped_frontal_faces);
+			}
 
-		// Passing the cropped images for eye detection and receiving the bounding boxes for the eyes
-		print("Eye detection", DEBUG_MODE);
-		const vector<vector<int>> EYE_NOSE_MOUTH_BOXES = eyeNoseMouthDetection(cropped_frontal_faces, LEFT_EYE_CASCADE, RIGHT_EYE_CASCADE, EYE_GLASS_CASCADE, DEBUG_MODE);
+			// Resampling the faces to the canonical size (if enabled) so every face costs the same in the per face stages
+			print<DEBUG_MODE>("Face size normalization");
+			if (CONFIG.CANONICAL_FACE_SIZE > 0) {
+				normalizeFaceSize<DEBUG_MODE>(cropped_frontal_faces, CONFIG.CANONICAL_FACE_SIZE, buffers.normalized_faces);
+			}
+			const vector<Mat>& FACES = CONFIG.CANONICAL_FACE_SIZE > 0 ? buffers.normalized_faces : cropped_frontal_faces;
+			// The Cr components and thresholds computed by the geometry eye search are reused by the skin color segmentation
+			vector<FaceCr>& face_crs = buffers.face_crs;
+			face_crs.clear();
+			face_crs.resize(FACES.size());
 
-		// Passing the Otsu thresholded Cr components and the eye bounding boxes for mask detection
-		print("Mask detection", DEBUG_MODE);
-		results = oronasalEyeRegionComparison(OTSU_CR_FACES, EYE_NOSE_MOUTH_BOXES, DEBUG_MODE);
+			// Passing the cropped images for eye detection and storing the bounding boxes for the eyes in the face results
+			// The geometry strategy skips the eye cascades and derives the boxes from the face proportions instead
+			if (!REGIONS_STORED) {
+				print<DEBUG_MODE>("Eye detection");
+				if (CONFIG.EYE_SEARCH == EyeSearch::GEOMETRY) {
+					eyeNoseMouthGeometry<DEBUG_MODE>(FACES, face_crs, result.faces);
+				}
+				else {
+					eyeNoseMouthDetection<DEBUG_MODE>(FACES, LEFT_EYE_CASCADE, RIGHT_EYE_CASCADE, EYE_GLASS_CASCADE, CONFIG.EYE_SEARCH == EyeSearch::SHARED ? &shared_eye_cascades : nullptr, result.faces, deadline, buffers.eye_buffers);
+				}
+				if (stages != nullptr && (deadline == nullptr || deadline->degradation() == NOT_DEGRADED)) {
+					stored_regions.clear();
+					for (auto &face_result: result.faces) {
+						const EyeNoseMouthBox& REGION = face_result.region;
+						stored_regions.push_back(StoredRegion{REGION.left_x, REGION.eye_top_y, REGION.right_x, REGION.eye_bottom_nose_mouth_top_y, REGION.nose_mouth_bottom_y, uint8_t(REGION.eyes_detected), {}});
+					}
+					stages->put(EYE_STAGE, KEYS.keys[EYE_STAGE], stored_regions);
+				}
+			}
+
+			// Passing the cropped face images and their eye bounding boxes for skin color segmentation and storing the skin pixel counts of the eye and oronasal regions
+			// Segmenting after the eye detection lets faces without eyes skip the segmentation
+			print<DEBUG_MODE>("Skin color segmentation");
+			skinColorSegmentation<DEBUG_MODE>(FACES, face_crs, result.faces);
+			if (stages != nullptr && (deadline == nullptr || deadline->degradation() == NOT_DEGRADED)) {
+				stored_skin.clear();
+				for (auto &face_result: result.faces) {
+					stored_skin.push_back(StoredSkin{face_result.eye_skin, face_result.nose_mouth_skin});
+				}
+				stages->put(SKIN_STAGE, KEYS.keys[SKIN_STAGE], stored_skin);
+			}
+		}
+
+		// Passing the skin pixel counts and the eye bounding boxes for mask detection
+		print<DEBUG_MODE>("Mask detection");
+		result.counts = oronasalEyeRegionComparison<DEBUG_MODE>(result.faces, CONFIG.MASK_RATIO);
+
+		// Mapping the regions found on the resampled faces back to the cropped faces
+		if (CONFIG.CANONICAL_FACE_SIZE > 0) {
+			mapRegionsToFaces(CONFIG.CANONICAL_FACE_SIZE, result.faces);
+		}
 	}
-	return {results.at(0), results.at(1), results.at(2), images_skipped};
+	result.counts.faces_skipped = faces - result.faces.size();
+	result.degraded = deadline != nullptr ? deadline->degradation() : NOT_DEGRADED;
+	// The cropped faces share the pixels of the image, so they are let go of along with it; the vectors keep their capacity
+	cropped_frontal_faces.clear();
+	buffers.normalized_faces.clear();
+	buffers.face_crs.clear();
+	return result;
 }
 
 #endif //MAIN_MASKDETECTION_H
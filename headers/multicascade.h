@@ -0,0 +1,362 @@
+// multicascade.h
+// Description: Evaluates several Haar cascades with the same window size in a single scan of an image: the scales, the resized images, the integral images,
+//              the window iteration, and the variance normalization are shared, and the stages of the cascades are interleaved on every window
+// Assumptions: The cascades are BOOST cascades of HAAR features written by opencv_traincascade, and every window is evaluated exactly like
+//              CascadeClassifier::detectMultiScale with its default arguments does, so each cascade finds the same boxes as its classifier
+
+#ifndef MAIN_MULTICASCADE_H
+#define MAIN_MULTICASCADE_H
+
+// Import the necessary libraries for opencv
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/objdetect.hpp>
+
+// Declaring the namespaces that would be used throughout the program
+// We can use 2 namespaces as long as there aren't any conflicts
+using namespace std;
+using namespace cv;
+
+// Arguments detectMultiScale is called with by the eye detection, which are its defaults
+const double MULTI_CASCADE_SCALE_FACTOR = 1.1;
+const int MULTI_CASCADE_MIN_NEIGHBORS = 3;
+const double MULTI_CASCADE_GROUP_EPS = 0.2;
+// CascadeClassifier lowers every stage threshold by this much when it loads a cascade
+const float MULTI_CASCADE_THRESHOLD_EPS = 1e-5f;
+
+// The cascades scanned together, along with the integral images of the current image that their windows are evaluated on
+class MultiCascade {
+public:
+	// Loads the cascades from their xml files
+	// Parameters:
+	//          FILENAMES: Paths to the cascade files, in the order their boxes are returned
+	// Pre-condition:  N/A
+	// Post-condition: Returns false if a file cannot be read, is not a BOOST cascade of HAAR features, or has another window size than the first one
+	bool load(const vector<string>& FILENAMES) {
+		cascades.clear();
+		offsets_step = offsets_plane = 0;
+		for (auto &filename: FILENAMES) {
+			FileStorage storage(filename, FileStorage::READ);
+			if (!storage.isOpened()) {
+				return false;
+			}
+			cascades.emplace_back();
+			if (!readCascade(storage.getFirstTopLevelNode(), cascades.back()) || cascades.back().window != cascades.front().window) {
+				return false;
+			}
+		}
+		return !cascades.empty();
+	}
+
+	size_t size() const { return cascades.size(); }
+
+	// Detects the objects of the first COUNT cascades in one scan of the image
+	// Parameters:
+	//          GRAY:    Grayscale image to search
+	//          COUNT:   Number of cascades to run, from the first one
+	//          objects: Receives the grouped boxes of every cascade run, one vector per cascade
+	// Pre-condition:  The cascades are loaded and the image is an 8-bit grayscale image
+	// Post-condition: The boxes of every cascade are those its CascadeClassifier::detectMultiScale returns with the default arguments
+	//                 The buffers are kept between calls, so images of a size seen before allocate nothing
+	void detect(const Mat& GRAY, const int COUNT, vector<vector<Rect>>& objects) {
+		objects.resize(size_t(COUNT));
+		for (auto &boxes: objects) {
+			boxes.clear();
+		}
+		const Size WINDOW = cascades.front().window;
+		if (GRAY.cols < WINDOW.width || GRAY.rows < WINDOW.height) {
+			return;
+		}
+
+		// The scales at which the window still fits in the image, computed the way CascadeClassifier does
+		scales.clear();
+		for (double factor = 1; ; factor *= MULTI_CASCADE_SCALE_FACTOR) {
+			if (cvRound(WINDOW.width * factor) > GRAY.cols || cvRound(WINDOW.height * factor) > GRAY.rows) {
+				break;
+			}
+			scales.push_back(float(factor));
+		}
+
+		// The integral images of every scale share one buffer, with the row length of the largest scale, so the feature offsets are computed once per image
+		const int STEP = GRAY.cols + 1;
+		const int PLANE = STEP * (GRAY.rows + 1);
+		if (integrals.rows != 3 * (GRAY.rows + 1) || integrals.cols != STEP) {
+			integrals.create(3 * (GRAY.rows + 1), STEP, CV_32S);
+			scaled_buffer.create(GRAY.rows, GRAY.cols, CV_8U);
+		}
+		if (offsets_step != STEP || offsets_plane != PLANE) {
+			for (auto &cascade: cascades) {
+				computeOffsets(cascade, STEP, PLANE);
+			}
+			offsets_step = STEP;
+			offsets_plane = PLANE;
+		}
+		// Normalization rectangle of the window, inset by a pixel on every side
+		const Rect NORM_RECT(1, 1, WINDOW.width - 2, WINDOW.height - 2);
+		const int NORM[4] = {NORM_RECT.y * STEP + NORM_RECT.x, NORM_RECT.y * STEP + NORM_RECT.x + NORM_RECT.width,
+		                     (NORM_RECT.y + NORM_RECT.height) * STEP + NORM_RECT.x, (NORM_RECT.y + NORM_RECT.height) * STEP + NORM_RECT.x + NORM_RECT.width};
+		const double AREA = NORM_RECT.area();
+
+		candidates.resize(size_t(COUNT));
+		for (auto &boxes: candidates) {
+			boxes.clear();
+		}
+		skip.assign(size_t(COUNT), false);
+		results.assign(size_t(COUNT), 0);
+		int* const SUM = integrals.ptr<int>(0);
+		for (const float SCALE: scales) {
+			// The window size is rounded again from the float scale, which can overshoot the image at the last scale
+			const Size BOX(cvRound(WINDOW.width * SCALE), cvRound(WINDOW.height * SCALE));
+			if (BOX.width > GRAY.cols || BOX.height > GRAY.rows) {
+				break;
+			}
+			const Size SCALED(cvRound(GRAY.cols / SCALE), cvRound(GRAY.rows / SCALE));
+			Mat scaled(SCALED, CV_8U, scaled_buffer.ptr());
+			resize(GRAY, scaled, SCALED, 1. / SCALE, 1. / SCALE, INTER_LINEAR_EXACT);
+			Mat sum(SCALED.height + 1, SCALED.width + 1, CV_32S, SUM, STEP * sizeof(int));
+			Mat square_sum(SCALED.height + 1, SCALED.width + 1, CV_32S, SUM + PLANE, STEP * sizeof(int));
+			Mat tilted_sum(SCALED.height + 1, SCALED.width + 1, CV_32S, SUM + 2 * PLANE, STEP * sizeof(int));
+			integral(scaled, sum, square_sum, tilted_sum, CV_32S, CV_32S);
+
+			// Small scales step over every other window, like CascadeClassifier
+			const int WINDOW_STEP = SCALE >= 2 ? 1 : 2;
+			const int WIDTH = max(SCALED.width + 1 - WINDOW.width, 0), HEIGHT = max(SCALED.height + 1 - WINDOW.height, 0);
+			for (int y = 0; y < HEIGHT; y += WINDOW_STEP) {
+				fill(skip.begin(), skip.end(), false);
+				for (int x = 0; x < WIDTH; x += WINDOW_STEP) {
+					const int* WINDOW_SUM = SUM + y * STEP + x;
+					// The variance of the window normalizes every feature; flat windows are rejected by every cascade
+					const int VALUE_SUM = WINDOW_SUM[NORM[0]] - WINDOW_SUM[NORM[1]] - WINDOW_SUM[NORM[2]] + WINDOW_SUM[NORM[3]];
+					const unsigned* WINDOW_SQUARE_SUM = reinterpret_cast<const unsigned*>(WINDOW_SUM + PLANE);
+					const unsigned SQUARE_SUM = WINDOW_SQUARE_SUM[NORM[0]] - WINDOW_SQUARE_SUM[NORM[1]] - WINDOW_SQUARE_SUM[NORM[2]] + WINDOW_SQUARE_SUM[NORM[3]];
+					const double NORM_FACTOR = AREA * SQUARE_SUM - double(VALUE_SUM) * VALUE_SUM;
+					const float VARIANCE_NORM = NORM_FACTOR > 0 ? float(1. / sqrt(NORM_FACTOR)) : 1.f;
+					const bool VALID = NORM_FACTOR > 0 && AREA * VARIANCE_NORM < 1e-1;
+					evaluateWindow(WINDOW_SUM, VARIANCE_NORM, VALID, COUNT);
+					for (int c = 0; c < COUNT; c++) {
+						if (results[size_t(c)] > 0) {
+							candidates[size_t(c)].emplace_back(cvRound(x * SCALE), cvRound(y * SCALE), BOX.width, BOX.height);
+						}
+						// A window rejected by the first stage lets its cascade skip the next window of the row
+						skip[size_t(c)] = results[size_t(c)] == 0;
+					}
+				}
+			}
+		}
+		for (int c = 0; c < COUNT; c++) {
+			objects[size_t(c)].swap(candidates[size_t(c)]);
+			groupRectangles(objects[size_t(c)], MULTI_CASCADE_MIN_NEIGHBORS, MULTI_CASCADE_GROUP_EPS);
+		}
+	}
+
+private:
+	// A node of a tree: its feature and threshold, and the nodes taken below and above the threshold, where values of 0 or less are minus a leaf index
+	struct Node {
+		int left, right, feature;
+		float threshold;
+	};
+
+	// The first node and first leaf of a tree, within those of the cascade
+	struct Tree {
+		int first_node, first_leaf;
+	};
+
+	// The trees of a stage and the threshold their sum must reach for the window to move on to the next stage
+	struct Stage {
+		int first_tree, tree_count;
+		float threshold;
+	};
+
+	// Up to 3 weighted rectangles of a feature within the window; tilted features sum over rectangles rotated by 45 degrees
+	struct Feature {
+		Rect rects[3];
+		float weights[3];
+		bool tilted;
+	};
+
+	// The corners of the rectangles of a feature as offsets from the top-left corner of the window in the integral images
+	struct FeatureOffsets {
+		int corners[3][4];
+		float weights[3];
+	};
+
+	struct Cascade {
+		Size window;
+		vector<Stage> stages;
+		vector<Tree> trees;
+		vector<Node> nodes;
+		vector<float> leaves;
+		vector<Feature> features;
+		vector<FeatureOffsets> offsets;
+	};
+
+	// Reads a cascade in the format of opencv_traincascade
+	static bool readCascade(const FileNode& ROOT, Cascade& cascade) {
+		if (ROOT.empty() || (string)ROOT["stageType"] != "BOOST" || (string)ROOT["featureType"] != "HAAR" || (int)ROOT["featureParams"]["maxCatCount"] != 0) {
+			return false;
+		}
+		cascade.window = Size((int)ROOT["width"], (int)ROOT["height"]);
+		const FileNode STAGES = ROOT["stages"];
+		const FileNode FEATURES = ROOT["features"];
+		if (cascade.window.width < 3 || cascade.window.height < 3 || STAGES.empty() || FEATURES.empty()) {
+			return false;
+		}
+		for (FileNodeIterator stage = STAGES.begin(); stage != STAGES.end(); ++stage) {
+			const FileNode WEAK_CLASSIFIERS = (*stage)["weakClassifiers"];
+			if (WEAK_CLASSIFIERS.empty()) {
+				return false;
+			}
+			cascade.stages.push_back(Stage{int(cascade.trees.size()), int(WEAK_CLASSIFIERS.size()), (float)(*stage)["stageThreshold"] - MULTI_CASCADE_THRESHOLD_EPS});
+			for (FileNodeIterator tree = WEAK_CLASSIFIERS.begin(); tree != WEAK_CLASSIFIERS.end(); ++tree) {
+				const FileNode INTERNAL_NODES = (*tree)["internalNodes"];
+				const FileNode LEAF_VALUES = (*tree)["leafValues"];
+				// Every node takes 4 values: left, right, feature, and threshold
+				if (INTERNAL_NODES.empty() || LEAF_VALUES.empty() || INTERNAL_NODES.size() % 4 != 0 || LEAF_VALUES.size() != INTERNAL_NODES.size() / 4 + 1) {
+					return false;
+				}
+				cascade.trees.push_back(Tree{int(cascade.nodes.size()), int(cascade.leaves.size())});
+				for (FileNodeIterator value = INTERNAL_NODES.begin(); value != INTERNAL_NODES.end(); ) {
+					Node node;
+					node.left = (int)*value;
+					++value;
+					node.right = (int)*value;
+					++value;
+					node.feature = (int)*value;
+					++value;
+					node.threshold = (float)*value;
+					++value;
+					cascade.nodes.push_back(node);
+				}
+				for (FileNodeIterator value = LEAF_VALUES.begin(); value != LEAF_VALUES.end(); ++value) {
+					cascade.leaves.push_back((float)*value);
+				}
+			}
+		}
+		for (FileNodeIterator feature_node = FEATURES.begin(); feature_node != FEATURES.end(); ++feature_node) {
+			Feature feature{};
+			const FileNode RECTS = (*feature_node)["rects"];
+			if (RECTS.empty() || RECTS.size() > 3) {
+				return false;
+			}
+			int r = 0;
+			for (FileNodeIterator rect = RECTS.begin(); rect != RECTS.end(); ++rect, r++) {
+				// Every rectangle is given as x, y, width, height, and weight
+				if ((*rect).size() != 5) {
+					return false;
+				}
+				feature.rects[r] = Rect((int)(*rect)[0], (int)(*rect)[1], (int)(*rect)[2], (int)(*rect)[3]);
+				feature.weights[r] = (float)(*rect)[4];
+			}
+			feature.tilted = (int)(*feature_node)["tilted"] != 0;
+			cascade.features.push_back(feature);
+		}
+		// Every node must point at a feature, and at a node or a leaf of its own tree
+		for (size_t t = 0; t < cascade.trees.size(); t++) {
+			const int NODES = (t + 1 < cascade.trees.size() ? cascade.trees[t + 1].first_node : int(cascade.nodes.size())) - cascade.trees[t].first_node;
+			for (int n = 0; n < NODES; n++) {
+				const Node& NODE = cascade.nodes[size_t(cascade.trees[t].first_node + n)];
+				if (NODE.feature < 0 || NODE.feature >= int(cascade.features.size()) || NODE.left >= NODES || NODE.right >= NODES || NODE.left < -NODES || NODE.right < -NODES
+				    || (NODE.left > 0 && NODE.left <= n) || (NODE.right > 0 && NODE.right <= n)) {
+					return false;
+				}
+			}
+		}
+		return true;
+	}
+
+	// Turns the rectangles of every feature into offsets in integral images with rows of STEP values, the tilted one starting 2 planes further
+	static void computeOffsets(Cascade& cascade, const int STEP, const int PLANE) {
+		cascade.offsets.resize(cascade.features.size());
+		for (size_t f = 0; f < cascade.features.size(); f++) {
+			const Feature& FEATURE = cascade.features[f];
+			FeatureOffsets& offsets = cascade.offsets[f];
+			for (int r = 0; r < 3; r++) {
+				const Rect& R = FEATURE.rects[r];
+				int* corners = offsets.corners[r];
+				offsets.weights[r] = FEATURE.weights[r];
+				if (FEATURE.tilted) {
+					// Corners (x, y), (x - h, y + h), (x + w, y + w), and (x + w - h, y + w + h) of the rotated rectangle
+					corners[0] = 2 * PLANE + R.y * STEP + R.x;
+					corners[1] = 2 * PLANE + (R.y + R.height) * STEP + R.x - R.height;
+					corners[2] = 2 * PLANE + (R.y + R.width) * STEP + R.x + R.width;
+					corners[3] = 2 * PLANE + (R.y + R.width + R.height) * STEP + R.x + R.width - R.height;
+				}
+				else {
+					corners[0] = R.y * STEP + R.x;
+					corners[1] = R.y * STEP + R.x + R.width;
+					corners[2] = (R.y + R.height) * STEP + R.x;
+					corners[3] = (R.y + R.height) * STEP + R.x + R.width;
+				}
+			}
+		}
+	}
+
+	// Returns the normalized value of a feature on the window, with the same float operations as CascadeClassifier
+	static float featureValue(const FeatureOffsets& OFFSETS, const int* WINDOW_SUM, const float VARIANCE_NORM) {
+		const int* C0 = OFFSETS.corners[0];
+		const int* C1 = OFFSETS.corners[1];
+		float value = OFFSETS.weights[0] * (WINDOW_SUM[C0[0]] - WINDOW_SUM[C0[1]] - WINDOW_SUM[C0[2]] + WINDOW_SUM[C0[3]])
+		              + OFFSETS.weights[1] * (WINDOW_SUM[C1[0]] - WINDOW_SUM[C1[1]] - WINDOW_SUM[C1[2]] + WINDOW_SUM[C1[3]]);
+		if (OFFSETS.weights[2] != 0.0f) {
+			const int* C2 = OFFSETS.corners[2];
+			value += OFFSETS.weights[2] * (WINDOW_SUM[C2[0]] - WINDOW_SUM[C2[1]] - WINDOW_SUM[C2[2]] + WINDOW_SUM[C2[3]]);
+		}
+		return value * VARIANCE_NORM;
+	}
+
+	// Returns true if the window reaches the threshold of a stage of a cascade
+	static bool passesStage(const Cascade& CASCADE, const Stage& STAGE, const int* WINDOW_SUM, const float VARIANCE_NORM) {
+		double sum = 0;
+		for (int t = STAGE.first_tree; t < STAGE.first_tree + STAGE.tree_count; t++) {
+			const Tree& TREE = CASCADE.trees[size_t(t)];
+			int index = 0;
+			do {
+				const Node& NODE = CASCADE.nodes[size_t(TREE.first_node + index)];
+				const double VALUE = featureValue(CASCADE.offsets[size_t(NODE.feature)], WINDOW_SUM, VARIANCE_NORM);
+				index = VALUE < NODE.threshold ? NODE.left : NODE.right;
+			} while (index > 0);
+			sum += CASCADE.leaves[size_t(TREE.first_leaf - index)];
+		}
+		return sum >= STAGE.threshold;
+	}
+
+	// Runs the first COUNT cascades on a window, one stage of every cascade still running at a time, so their early stages read the same integral rows
+	// Leaves in results, for every cascade, 1 if the window passed every stage, minus the index of the stage that rejected it,
+	// or -1 if the cascade skipped the window or the window is flat, which are the values CascadeClassifier gives a window
+	void evaluateWindow(const int* WINDOW_SUM, const float VARIANCE_NORM, const bool VALID, const int COUNT) {
+		int running = 0;
+		for (int c = 0; c < COUNT; c++) {
+			results[size_t(c)] = skip[size_t(c)] || !VALID ? -1 : 1;
+			running += results[size_t(c)] > 0 ? 1 : 0;
+		}
+		for (int stage = 0; running > 0; stage++) {
+			for (int c = 0; c < COUNT; c++) {
+				const Cascade& CASCADE = cascades[size_t(c)];
+				if (results[size_t(c)] <= 0 || stage >= int(CASCADE.stages.size())) {
+					continue;
+				}
+				if (!passesStage(CASCADE, CASCADE.stages[size_t(stage)], WINDOW_SUM, VARIANCE_NORM)) {
+					results[size_t(c)] = -stage;
+					running -= 1;
+				}
+				else if (stage + 1 == int(CASCADE.stages.size())) {
+					running -= 1;
+				}
+			}
+		}
+	}
+
+	vector<Cascade> cascades;
+	vector<float> scales;
+	Mat integrals, scaled_buffer;
+	int offsets_step = 0, offsets_plane = 0;
+	vector<vector<Rect>> candidates;
+	vector<bool> skip;
+	vector<int> results;
+};
+
+#endif //MAIN_MULTICASCADE_H
@@ -0,0 +1,173 @@
+// pixelcache.h
+// Description: An on-disk cache of the decoded and pre-processed images, so repeated runs over the same dataset skip the jpg decoding and the pre-processing
+// Assumptions: Entries are keyed by a hash of the encoded image and of the decode scale and pre-processing parameters; PIXEL_CACHE_VERSION must be bumped whenever preProcessing changes
+
+#ifndef MAIN_PIXELCACHE_H
+#define MAIN_PIXELCACHE_H
+
+// Import the necessary libraries for opencv, i/o, and file mapping
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <string_view>
+#include <opencv2/core.hpp>
+#include "headers/config.h"
+#include "headers/hash.h"
+#include "headers/mappedfile.h"
+
+// Declaring the namespaces that would be used throughout the program
+// We can use 2 namespaces as long as there aren't any conflicts
+using namespace std;
+using namespace cv;
+
+// Identifies a cache entry and the version of its layout and of the pre-processing that produced it
+const uint32_t PIXEL_CACHE_MAGIC = 0x4C585050;  // "PPXL"
+const uint32_t PIXEL_CACHE_VERSION = 1;
+// Pixel planes start on this boundary so rows can be read with aligned vector loads
+const uint64_t PIXEL_CACHE_ALIGNMENT = 64;
+
+// Layout of a cache entry file: the header followed by the decoded image and the pre-processed image, each stored row after row without padding
+//          content_hash, content_size: Hash and size of the encoded image the entry was decoded from
+//          params_hash:                Hash of the pre-processing parameters
+//          rows, cols:                 Size of both images
+//          image_type, gray_type:      OpenCV types of the decoded and pre-processed images
+//          image_offset, gray_offset:  Offsets of the two pixel planes
+struct PixelCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t content_hash;
+	uint64_t content_size;
+	uint64_t params_hash;
+	int32_t rows;
+	int32_t cols;
+	int32_t image_type;
+	int32_t gray_type;
+	uint64_t image_offset;
+	uint64_t gray_offset;
+};
+
+// Caches one file per image in a directory and maps the entries back as images without copying them
+class PixelCache {
+public:
+	// Parameters:
+	//          DIRECTORY: Directory holding the cache entries (created if missing)
+	explicit PixelCache(const string& DIRECTORY) : directory(DIRECTORY) {
+		filesystem::create_directories(directory);
+	}
+
+	// Hash of the decode scale and of the pre-processing parameters the cached images are produced with, which every load and store is keyed by
+	static uint64_t paramsHash(const Config& CONFIG) {
+		const PreProcessingParams& PARAMS = CONFIG.PRE_PROCESSING;
+		string params;
+		params.append(reinterpret_cast<const char*>(&PIXEL_CACHE_VERSION), sizeof(PIXEL_CACHE_VERSION));
+		params.append(reinterpret_cast<const char*>(&CONFIG.DECODE_SCALE), sizeof(CONFIG.DECODE_SCALE));
+		params.append(reinterpret_cast<const char*>(&PARAMS.BLUR_WIDTH), sizeof(PARAMS.BLUR_WIDTH));
+		params.append(reinterpret_cast<const char*>(&PARAMS.BLUR_HEIGHT), sizeof(PARAMS.BLUR_HEIGHT));
+		params.append(reinterpret_cast<const char*>(&PARAMS.BLUR_SIGMA_X), sizeof(PARAMS.BLUR_SIGMA_X));
+		params.append(reinterpret_cast<const char*>(&PARAMS.BLUR_SIGMA_Y), sizeof(PARAMS.BLUR_SIGMA_Y));
+		return hashBytes(params);
+	}
+
+	// Looks an encoded image up in the cache
+	// Parameters:
+	//          BYTES:         The encoded image
+	//          PARAMS_HASH:   Hash of the decode scale and pre-processing parameters of the image
+	//          image:         Receives the decoded image
+	//          pre_processed: Receives the pre-processed image
+	// Pre-condition:  N/A
+	// Post-condition: Returns true on a hit; the images point into a private mapping of the entry, which stays valid until the next lookup
+	bool load(const string_view BYTES, const uint64_t PARAMS_HASH, Mat& image, Mat& pre_processed) {
+		const uint64_t CONTENT_HASH = hashBytes(BYTES);
+		// A private writable mapping, so drawing on the images in debug mode only touches a copy of the pages
+		if (!entry.open(entryPath(CONTENT_HASH, PARAMS_HASH), true) || entry.size() < sizeof(PixelCacheHeader)) {
+			misses += 1;
+			return false;
+		}
+		const auto* HEADER = reinterpret_cast<const PixelCacheHeader*>(entry.data());
+		const uint64_t IMAGE_SIZE = uint64_t(HEADER->rows) * HEADER->cols * CV_ELEM_SIZE(HEADER->image_type);
+		const uint64_t GRAY_SIZE = uint64_t(HEADER->rows) * HEADER->cols * CV_ELEM_SIZE(HEADER->gray_type);
+		if (HEADER->magic != PIXEL_CACHE_MAGIC || HEADER->version != PIXEL_CACHE_VERSION || HEADER->content_hash != CONTENT_HASH || HEADER->content_size != BYTES.size() || HEADER->params_hash != PARAMS_HASH
+		    || HEADER->image_offset + IMAGE_SIZE > entry.size() || HEADER->gray_offset + GRAY_SIZE > entry.size()) {
+			entry.close();
+			misses += 1;
+			return false;
+		}
+		char* data = const_cast<char*>(entry.data());
+		image = Mat(HEADER->rows, HEADER->cols, HEADER->image_type, data + HEADER->image_offset);
+		pre_processed = Mat(HEADER->rows, HEADER->cols, HEADER->gray_type, data + HEADER->gray_offset);
+		hits += 1;
+		return true;
+	}
+
+	// Stores the decoded and pre-processed images of an encoded image
+	// Parameters:
+	//          BYTES:         The encoded image
+	//          PARAMS_HASH:   Hash of the decode scale and pre-processing parameters of the image
+	//          IMAGE:         The decoded image
+	//          PRE_PROCESSED: The pre-processed image
+	// Pre-condition:  Both images have the same size
+	// Post-condition: The entry is written under a temporary name and renamed, so concurrent runs never read a partial entry; failures only lose the entry
+	void store(const string_view BYTES, const uint64_t PARAMS_HASH, const Mat& IMAGE, const Mat& PRE_PROCESSED) const {
+		const uint64_t CONTENT_HASH = hashBytes(BYTES);
+		PixelCacheHeader header{};
+		header.magic = PIXEL_CACHE_MAGIC;
+		header.version = PIXEL_CACHE_VERSION;
+		header.content_hash = CONTENT_HASH;
+		header.content_size = BYTES.size();
+		header.params_hash = PARAMS_HASH;
+		header.rows = IMAGE.rows;
+		header.cols = IMAGE.cols;
+		header.image_type = IMAGE.type();
+		header.gray_type = PRE_PROCESSED.type();
+		header.image_offset = alignUp(sizeof(header));
+		header.gray_offset = alignUp(header.image_offset + IMAGE.total() * IMAGE.elemSize());
+
+		const string PATH = entryPath(CONTENT_HASH, PARAMS_HASH);
+		const string TEMPORARY_PATH = PATH + ".tmp";
+		FILE* file = fopen(TEMPORARY_PATH.c_str(), "wb");
+		if (file == nullptr) {
+			return;
+		}
+		bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+		written = written && writePlane(file, IMAGE, header.image_offset) && writePlane(file, PRE_PROCESSED, header.gray_offset);
+		written = fclose(file) == 0 && written;
+		if (!written || rename(TEMPORARY_PATH.c_str(), PATH.c_str()) != 0) {
+			remove(TEMPORARY_PATH.c_str());
+		}
+	}
+
+	long long hitCount() const { return hits; }
+
+	long long missCount() const { return misses; }
+
+private:
+	static uint64_t alignUp(const uint64_t OFFSET) { return (OFFSET + PIXEL_CACHE_ALIGNMENT - 1) / PIXEL_CACHE_ALIGNMENT * PIXEL_CACHE_ALIGNMENT; }
+
+	// Pads the file up to the plane offset and writes the rows of the image
+	static bool writePlane(FILE* file, const Mat& IMAGE, const uint64_t OFFSET) {
+		if (fseek(file, long(OFFSET), SEEK_SET) != 0) {
+			return false;
+		}
+		const size_t ROW_SIZE = size_t(IMAGE.cols) * IMAGE.elemSize();
+		for (int row = 0; row < IMAGE.rows; row++) {
+			if (fwrite(IMAGE.ptr(row), 1, ROW_SIZE, file) != ROW_SIZE) {
+				return false;
+			}
+		}
+		return true;
+	}
+
+	string entryPath(const uint64_t CONTENT_HASH, const uint64_t PARAMS_HASH) const {
+		char name[48];
+		snprintf(name, sizeof(name), "%016llx-%016llx.px", (unsigned long long)CONTENT_HASH, (unsigned long long)PARAMS_HASH);
+		return (filesystem::path(directory) / name).string();
+	}
+
+	const string directory;
+	MappedFile entry;
+	long long hits = 0, misses = 0;
+};
+
+#endif //MAIN_PIXELCACHE_H
@@ -8,160 +8,377 @@
 // Import the necessary libraries for opencv and i/o
 #include <iostream>
 #include <vector>
+#include <chrono>
+#include <climits>
+#include <cfloat>
+#include <cmath>
 #include <opencv2/core.hpp>
 #include "headers/helper.h"
+#include "headers/deadline.h"
+#include "headers/multicascade.h"
+#include "headers/results.h"
 
 // Declaring the namespaces that would be used throughout the program
 // We can use 2 namespaces as long as there aren't any conflicts
 using namespace std;
 using namespace cv;
 
-// The skin color segmentation takes in a set of cropped faces, converts them to YCrCb color space, and uses the Cr component for Otsu thresholding
+// Converts a face to YCrCb color space and extracts its Cr component
 // Parameters:
-//          CROPPED_FACES: A vector of matrices with cropped face images
-//          DEBUG_MODE:    To control the image display outputs
-// Pre-condition: The vector contains valid matrices with cropped face images
-// Post-condition: Images are displayed at various stages of the segmentation if running in debug mode and then the final output is returned to the caller
-vector<Mat> skinColorSegmentation (const vector<Mat>& CROPPED_FACES, const bool DEBUG_MODE) {
-	// Converting cropped faces to YCrCb color space
-	print("Converting cropped faces to YCrCb color space", DEBUG_MODE);
-	vector<Mat> cropped_faces_ycrcb;
-	for (auto &face: CROPPED_FACES) {
-		Mat face_ycrcb;
-		cvtColor(face, face_ycrcb, COLOR_BGR2YCrCb);
-		cropped_faces_ycrcb.push_back(face_ycrcb);
-		display("YCrCb Faces", face_ycrcb, DEBUG_MODE);
+//          FACE:       A matrix with a cropped face image
+//          DEBUG_MODE: To control the image display outputs
+// Pre-condition: The matrix is a valid BGR image
+// Post-condition: Returns the single channel Cr component of the face
+template <bool DEBUG_MODE>
+Mat crComponent (const Mat& FACE) {
+	// Converting the cropped face to YCrCb color space
+	print<DEBUG_MODE>("Converting cropped face to YCrCb color space");
+	Mat face_ycrcb, cr;
+	cvtColor(FACE, face_ycrcb, COLOR_BGR2YCrCb);
+	display<DEBUG_MODE>("YCrCb Faces", face_ycrcb);
+
+	// Extracting only the Cr component instead of splitting all three channels
+	print<DEBUG_MODE>("Extracting Cr component of the image");
+	extractChannel(face_ycrcb, cr, 1);
+	display<DEBUG_MODE>("Cr component of the face image", cr);
+	return cr;
+}
+
+// Computes the Otsu threshold of a Cr component the same way threshold() does with THRESH_OTSU, without producing the thresholded image
+// Parameters:
+//          CR: The Cr component of the face used as the representative region for the threshold
+// Pre-condition: The matrix is a valid single channel 8 bit image
+// Post-condition: Returns the threshold; pixels strictly above it are skin pixels
+int otsuThreshold (const Mat& CR) {
+	// Building the histogram of the Cr values
+	const int N = 256;
+	int histogram[N] = {0};
+	for (int row = 0; row < CR.rows; row++) {
+		const uchar* pixels = CR.ptr<uchar>(row);
+		for (int col = 0; col < CR.cols; col++) {
+			histogram[pixels[col]] += 1;
+		}
 	}
 
-	// Extracting Cr component of the image
-	print("Extracting Cr component of the image", DEBUG_MODE);
-	vector<Mat> cr_faces;
-	for (auto &face: cropped_faces_ycrcb) {
-		Mat channels[3];
-		split(face, channels);
-		cr_faces.push_back(channels[1]);
-		display("Cr component of the face image", channels[1], DEBUG_MODE);
+	// Picking the value that maximizes the between class variance
+	const double SCALE = 1.0 / (double(CR.rows) * CR.cols);
+	double mu = 0;
+	for (int i = 0; i < N; i++) {
+		mu += i * double(histogram[i]);
+	}
+	mu *= SCALE;
+	double mu1 = 0, q1 = 0, max_sigma = 0;
+	int max_value = 0;
+	for (int i = 0; i < N; i++) {
+		const double P_I = histogram[i] * SCALE;
+		mu1 *= q1;
+		q1 += P_I;
+		const double Q2 = 1.0 - q1;
+		if (min(q1, Q2) < FLT_EPSILON || max(q1, Q2) > 1.0 - FLT_EPSILON) {
+			continue;
+		}
+		mu1 = (mu1 + i * P_I) / q1;
+		const double MU2 = (mu - q1 * mu1) / Q2;
+		const double SIGMA = q1 * Q2 * (mu1 - MU2) * (mu1 - MU2);
+		if (SIGMA > max_sigma) {
+			max_sigma = SIGMA;
+			max_value = i;
+		}
+	}
+	return max_value;
+}
+
+// The Cr component of a face and its Otsu threshold, computed once per face and shared by the stages that threshold the face
+//          cr:        The Cr component of the face, or empty until it is needed
+//          threshold: The Otsu threshold of the Cr component
+struct FaceCr {
+	Mat cr;
+	int threshold = 0;
+};
+
+// Computes the Cr component and the Otsu threshold of a face, unless an earlier stage already did
+// Parameters:
+//          FACE:       A matrix with a cropped face image
+//          face_cr:    The Cr component and threshold of the face, filled in if empty
+//          DEBUG_MODE: To control the image display outputs
+// Pre-condition: The matrix is a valid BGR image
+// Post-condition: Returns the filled in Cr component and threshold of the face
+template <bool DEBUG_MODE>
+const FaceCr& faceCr (const Mat& FACE, FaceCr& face_cr) {
+	if (face_cr.cr.empty()) {
+		face_cr.cr = crComponent<DEBUG_MODE>(FACE);
+		face_cr.threshold = otsuThreshold(face_cr.cr);
 	}
+	return face_cr;
+}
 
-	// Applying Otsu thresholding for skin color segmentation
-	print("Applying Otsu thresholding for skin color segmentation", DEBUG_MODE);
-	vector<Mat> otsu_cr_faces;
-	for (auto &face: cr_faces) {
-		Mat otsu;
-		threshold(face, otsu, 0, 255, THRESH_OTSU);
-		otsu_cr_faces.push_back(otsu);
-		display("Otsu Thresholding", otsu, DEBUG_MODE);
+// Counts the skin pixels of a region of a Cr component
+// Parameters:
+//          CR:        The Cr component (or a region of it)
+//          THRESHOLD: The Otsu threshold of the face
+// Pre-condition: The matrix is a valid single channel 8 bit image
+// Post-condition: Returns the number of pixels above the threshold, which equals countNonZero of the Otsu thresholded region
+int countSkinPixels (const Mat& CR, const int THRESHOLD) {
+	int skin_pixels = 0;
+	for (int row = 0; row < CR.rows; row++) {
+		const uchar* pixels = CR.ptr<uchar>(row);
+		for (int col = 0; col < CR.cols; col++) {
+			skin_pixels += pixels[col] > THRESHOLD;
+		}
 	}
+	return skin_pixels;
+}
+
+// The skin color segmentation takes in a set of cropped faces and their eye and oronasal regions, converts the faces to YCrCb color space, and uses the Cr component for Otsu thresholding
+// Faces without eyes are not segmented at all, and only the union of the eye and oronasal regions is thresholded
+// The Otsu threshold is still computed on the whole face so the decisions are the same as thresholding the whole face
+// Parameters:
+//          CROPPED_FACES: A vector of matrices with cropped face images
+//          face_crs:      Cr components and thresholds of the faces, reused where the eye search already computed them
+//          face_results:  Results of the faces holding their eye and oronasal regions
+//          DEBUG_MODE:    To control the image display outputs
+// Pre-condition: The faces, Cr components, and results correspond to the same face in the same order
+// Post-condition: The number of skin pixels in the eye region and in the oronasal region of each face with eyes is stored in its result
+template <bool DEBUG_MODE>
+void skinColorSegmentation (const vector<Mat>& CROPPED_FACES, vector<FaceCr>& face_crs, FaceResults& face_results) {
+	for (int i = 0; i < face_results.size(); i++) {
+		FaceResult& face_result = face_results[i];
+		const EyeNoseMouthBox& REGION = face_result.region;
+
+		// Eyes not detected for this face, so the segmentation would be discarded anyway
+		if (!REGION.eyes_detected) {
+			continue;
+		}
 
-	return otsu_cr_faces;
+		// Applying Otsu thresholding for skin color segmentation on the eye and oronasal regions only
+		print<DEBUG_MODE>("Applying Otsu thresholding for skin color segmentation");
+		const FaceCr& FACE_CR = faceCr<DEBUG_MODE>(CROPPED_FACES.at(i), face_crs.at(i));
+		const Mat& CR = FACE_CR.cr;
+		const int THRESHOLD = FACE_CR.threshold;
+		const Range COLUMNS(REGION.left_x, REGION.right_x);
+		face_result.eye_skin = countSkinPixels(CR(Range(REGION.eye_top_y, REGION.eye_bottom_nose_mouth_top_y), COLUMNS), THRESHOLD);
+		face_result.nose_mouth_skin = countSkinPixels(CR(Range(REGION.eye_bottom_nose_mouth_top_y, REGION.nose_mouth_bottom_y), COLUMNS), THRESHOLD);
+
+		if constexpr (DEBUG_MODE) {
+			Mat otsu;
+			threshold(CR(Range(REGION.eye_top_y, REGION.nose_mouth_bottom_y), COLUMNS), otsu, THRESHOLD, 255, THRESH_BINARY);
+			display<DEBUG_MODE>("Otsu Thresholding", otsu);
+		}
+	}
 }
 
+// Scratch space of the eye search, kept by the caller across images so it stops allocating once it has grown
+//          eyes:        Boxes found by one eye cascade
+//          shared_eyes: Boxes found by each of the shared eye cascades
+//          gray_face:   The face converted to grayscale
+struct EyeBuffers {
+	vector<Rect> eyes;
+	vector<vector<Rect>> shared_eyes;
+	Mat gray_face;
+};
+
 // The detection function loads 3 eye haar cascade file and uses it to detect eyes from a face image
-// This is then used to determine the bounding boxes for the eye region and oronasal region which is returned to the caller
+// This is then used to determine the bounding boxes for the eye region and oronasal region which is stored in the results of the faces
+// Each face is converted to grayscale once and the same grayscale face is scanned by the 3 cascades back to back while it is still in cache,
+// instead of every cascade converting its own copy of the face inside detectMultiScale
+// With the shared eye cascades, the face is scanned once and the cascades are evaluated together on every window, finding the same boxes
 // Parameters:
-//          cropped_faces:     A vector of matrices with the cropped face images and location of the haar cascade xml file
-//          left_eye_cascade:  Haar Cascade classifier object for left eye detection
-//          right_eye_cascade: Haar Cascade classifier object for right eye detection
-//          eye_glass_cascade: Haar Cascade classifier object for eyes (with or without glasses) detection
-//          DEBUG_MODE:        To control the image display outputs
+//          CROPPED_FACES:       A vector of matrices with the cropped face images
+//          left_eye_cascade:    Haar Cascade classifier object for left eye detection
+//          right_eye_cascade:   Haar Cascade classifier object for right eye detection
+//          eye_glass_cascade:   Haar Cascade classifier object for eyes (with or without glasses) detection
+//          shared_eye_cascades: The left eye, right eye, and eyeglasses cascades loaded to be scanned together, or nullptr to run the classifiers one by one
+//          face_results:        Results of the faces, one per cropped face
+//          deadline:            Budget of the image, or nullptr to run every cascade on every face
+//          buffers:             Scratch space of the search, reused from face to face and from image to image
+//          DEBUG_MODE:          To control the image display outputs
 // Pre-condition: The vector contains valid matrices with cropped face images and the cascade objects should be valid
-// Post-condition: The eye and oronsasal regions are first displayed if running in debug mode and then the coordinates of the bounding boxes are returned
-vector<vector<int>> eyeNoseMouthDetection (vector<Mat> cropped_faces, CascadeClassifier left_eye_cascade, CascadeClassifier right_eye_cascade, CascadeClassifier eye_glass_cascade, const bool DEBUG_MODE) {
+// Post-condition: The eye and oronsasal regions are first displayed if running in debug mode and then stored in the results of the faces
+//                 The eyeglasses cascade is skipped on the faces where the 3 cascades no longer fit in the budget
+template <bool DEBUG_MODE>
+void eyeNoseMouthDetection (const vector<Mat>& CROPPED_FACES, CascadeClassifier left_eye_cascade, CascadeClassifier right_eye_cascade, CascadeClassifier eye_glass_cascade, MultiCascade* shared_eye_cascades, FaceResults& face_results, Deadline* deadline, EyeBuffers& buffers) {
 
 	const Scalar EYE_COLOR = Scalar(255, 0, 255);
 	const Scalar NOSE_MOUTH_COLOR = Scalar(0, 0, 0);
 	const int THICKNESS = 1;
+	// The eyeglasses cascade comes last, so it is the one dropped when the budget runs short
+	CascadeClassifier* const EYE_CASCADES[] = {&left_eye_cascade, &right_eye_cascade, &eye_glass_cascade};
+
+	vector<Rect>& eyes = buffers.eyes;
+	vector<vector<Rect>>& shared_eyes = buffers.shared_eyes;
+	Mat& gray_face = buffers.gray_face;
+	for (int i = 0; i < face_results.size(); i++) {
+		const Mat& FACE = CROPPED_FACES.at(i);
+		// Converting the face to grayscale once for all the eye cascades (detectMultiScale would otherwise convert it per cascade)
+		cvtColor(FACE, gray_face, COLOR_BGR2GRAY);
 
-	vector<vector<int>> eye_nose_mouth_boxes;
-	for (auto &face: cropped_faces) {
-		// Detecting eyes in the image
-		print("Detecting eyes in the image", DEBUG_MODE);
-		vector<Rect> eyes;
-		int top_left_x = 999, top_left_y = 999, bottom_right_x = 0, bottom_right_y = 0;
-		left_eye_cascade.detectMultiScale(face, eyes);
-		for (auto & eye : eyes) {
-			top_left_x = min(top_left_x, eye.x);
-			top_left_y = min(top_left_y, eye.y);
-			bottom_right_x = max(bottom_right_x, eye.x + eye.width);
-			bottom_right_y = max(bottom_right_y, eye.y + eye.height);
-		}
-		right_eye_cascade.detectMultiScale(face, eyes);
-		for (auto & eye : eyes) {
-			top_left_x = min(top_left_x, eye.x);
-			top_left_y = min(top_left_y, eye.y);
-			bottom_right_x = max(bottom_right_x, eye.x + eye.width);
-			bottom_right_y = max(bottom_right_y, eye.y + eye.height);
-		}
-		eye_glass_cascade.detectMultiScale(face, eyes);
-		for (auto & eye : eyes) {
-			top_left_x = min(top_left_x, eye.x);
-			top_left_y = min(top_left_y, eye.y);
-			bottom_right_x = max(bottom_right_x, eye.x + eye.width);
-			bottom_right_y = max(bottom_right_y, eye.y + eye.height);
-		}
-
-		int nose_mouth_bottom_y = min(top_left_y + 3 * (bottom_right_y - top_left_y), face.rows);
-		eye_nose_mouth_boxes.push_back({top_left_x, top_left_y, bottom_right_x, bottom_right_y, nose_mouth_bottom_y});
-
-		if (DEBUG_MODE) {
-			// Eyes not detected for this face, so skipping to the next face
-			if (top_left_x == 999 && top_left_y == 999 && bottom_right_x == 0 && bottom_right_y == 0) {
-				print("Eyes not detected for this face, so skipping to the next face", DEBUG_MODE);
-				continue;
+		// Detecting eyes in the image and taking the union of the boxes found by all the cascades
+		print<DEBUG_MODE>("Detecting eyes in the image");
+		int top_left_x = INT_MAX, top_left_y = INT_MAX, bottom_right_x = 0, bottom_right_y = 0;
+		bool eyes_detected = false;
+		int cascades = 3;
+		if (deadline != nullptr && !deadline->affords(EYE_PASS, double(gray_face.total()), 3)) {
+			print<DEBUG_MODE>("Skipping the eyeglasses cascade to meet the deadline");
+			deadline->degrade(GLASSES_SKIPPED);
+			cascades = 2;
+		}
+		// The shared scan is recorded as one pass per cascade it ran, so its estimate stays comparable with the separate passes
+		if (shared_eye_cascades != nullptr) {
+			const auto PASS_START = chrono::steady_clock::now();
+			shared_eye_cascades->detect(gray_face, cascades, shared_eyes);
+			if (deadline != nullptr) {
+				deadline->record(EYE_PASS, double(gray_face.total()) * cascades, PASS_START);
 			}
+		}
+		for (int j = 0; j < cascades; j++) {
+			if (shared_eye_cascades == nullptr) {
+				const auto PASS_START = chrono::steady_clock::now();
+				{
+					// The candidate lists detectMultiScale builds on every call are OpenCV's own allocations
+					const LibraryAllocations LIBRARY;
+					EYE_CASCADES[j]->detectMultiScale(gray_face, eyes);
+				}
+				if (deadline != nullptr) {
+					deadline->record(EYE_PASS, double(gray_face.total()), PASS_START);
+				}
+			}
+			for (auto & eye : shared_eye_cascades != nullptr ? shared_eyes[j] : eyes) {
+				top_left_x = min(top_left_x, eye.x);
+				top_left_y = min(top_left_y, eye.y);
+				bottom_right_x = max(bottom_right_x, eye.x + eye.width);
+				bottom_right_y = max(bottom_right_y, eye.y + eye.height);
+				eyes_detected = true;
+			}
+		}
+
+		// Eyes not detected for this face, so skipping to the next face
+		if (!eyes_detected) {
+			print<DEBUG_MODE>("Eyes not detected for this face, so skipping to the next face");
+			continue;
+		}
+
+		int nose_mouth_bottom_y = min(top_left_y + 3 * (bottom_right_y - top_left_y), FACE.rows);
+		face_results[i].region = {top_left_x, top_left_y, bottom_right_x, bottom_right_y, nose_mouth_bottom_y, true};
+
+		if constexpr (DEBUG_MODE) {
+			// Drawing on a copy since the face is segmented after the eye detection
+			Mat annotated_face = FACE.clone();
 			Point pt1(top_left_x, top_left_y);
 			Point pt2(bottom_right_x, bottom_right_y);
-			rectangle(face, pt1, pt2, EYE_COLOR, THICKNESS);
+			rectangle(annotated_face, pt1, pt2, EYE_COLOR, THICKNESS);
 
 			Point pt3(top_left_x, bottom_right_y);
 			Point pt4(bottom_right_x, nose_mouth_bottom_y);
-			rectangle(face, pt3, pt4, NOSE_MOUTH_COLOR, THICKNESS);
+			rectangle(annotated_face, pt3, pt4, NOSE_MOUTH_COLOR, THICKNESS);
 
-			display("Eyes, Nose, and Mouth areas detected", face, DEBUG_MODE);
+			display<DEBUG_MODE>("Eyes, Nose, and Mouth areas detected", annotated_face);
 		}
 	}
+}
 
-	return eye_nose_mouth_boxes;
+// The geometry based detection function derives the eye and oronasal regions from fixed proportions of the face box without running any eye cascade
+// The eye line is placed on the row with the least skin in the Otsu thresholded Cr component (eyes and brows are not skin colored) inside the band where eyes are expected
+// Parameters:
+//          CROPPED_FACES: A vector of matrices with cropped face images
+//          face_crs:      Receives the Cr components and thresholds of the faces, which the skin color segmentation reuses
+//          face_results:  Results of the faces, one per cropped face
+//          DEBUG_MODE:    To control the image display outputs
+// Pre-condition: The vector contains valid matrices with cropped face images, and there is one Cr component per face
+// Post-condition: The eye and oronasal regions are stored in the results of the faces the same way as eyeNoseMouthDetection
+template <bool DEBUG_MODE>
+void eyeNoseMouthGeometry (const vector<Mat>& CROPPED_FACES, vector<FaceCr>& face_crs, FaceResults& face_results) {
+	// Proportions of the face box where the eyes of a frontal face are expected
+	const double LEFT_X = 0.15, RIGHT_X = 0.85;
+	const double EYE_SEARCH_TOP = 0.25, EYE_SEARCH_BOTTOM = 0.45;
+	const double EYE_BAND_HEIGHT = 0.16;
+
+	for (int i = 0; i < face_results.size(); i++) {
+		const Mat& face = CROPPED_FACES.at(i);
+		const int LEFT = int(LEFT_X * face.cols), RIGHT = int(RIGHT_X * face.cols);
+		const int SEARCH_TOP = int(EYE_SEARCH_TOP * face.rows), SEARCH_BOTTOM = int(EYE_SEARCH_BOTTOM * face.rows);
+		const int HALF_BAND = max(1, int(EYE_BAND_HEIGHT * face.rows / 2));
+
+		// Counting the skin pixels of each row to build the vertical Cr projection profile
+		print<DEBUG_MODE>("Building the vertical Cr projection profile");
+		const FaceCr& FACE_CR = faceCr<DEBUG_MODE>(face, face_crs.at(i));
+		const Mat& CR = FACE_CR.cr;
+		const int THRESHOLD = FACE_CR.threshold;
+		int eye_row = (SEARCH_TOP + SEARCH_BOTTOM) / 2, least_skin = INT_MAX;
+		for (int row = SEARCH_TOP; row < SEARCH_BOTTOM; row++) {
+			const int SKIN = countSkinPixels(CR(Range(row, row + 1), Range(LEFT, RIGHT)), THRESHOLD);
+			if (SKIN < least_skin) {
+				least_skin = SKIN;
+				eye_row = row;
+			}
+		}
+
+		const int TOP_Y = max(0, eye_row - HALF_BAND), BOTTOM_Y = min(face.rows, eye_row + HALF_BAND);
+		const int NOSE_MOUTH_BOTTOM_Y = min(TOP_Y + 3 * (BOTTOM_Y - TOP_Y), face.rows);
+		face_results[i].region = {LEFT, TOP_Y, RIGHT, BOTTOM_Y, NOSE_MOUTH_BOTTOM_Y, true};
+	}
+}
+
+// Maps the eye and oronasal regions found on the resampled faces back to the coordinates of the cropped faces
+// Parameters:
+//          SIZE:         Width and height the faces were resampled to
+//          face_results: Results of the faces holding their face boxes (the size of the cropped faces) and their eye and oronasal regions
+// Pre-condition: The size is positive
+// Post-condition: The regions of the faces with eyes are scaled to the cropped faces
+void mapRegionsToFaces(const int SIZE, FaceResults& face_results) {
+	for (int i = 0; i < face_results.size(); i++) {
+		EyeNoseMouthBox& region = face_results[i].region;
+		// Eyes not detected for this face, so there is nothing to map
+		if (!region.eyes_detected) {
+			continue;
+		}
+		const double SCALE_X = double(face_results[i].face.width) / SIZE;
+		const double SCALE_Y = double(face_results[i].face.height) / SIZE;
+		region.left_x = int(region.left_x * SCALE_X);
+		region.right_x = int(region.right_x * SCALE_X);
+		region.eye_top_y = int(region.eye_top_y * SCALE_Y);
+		region.eye_bottom_nose_mouth_top_y = int(region.eye_bottom_nose_mouth_top_y * SCALE_Y);
+		region.nose_mouth_bottom_y = int(region.nose_mouth_bottom_y * SCALE_Y);
+	}
 }
 
-// The mask detection function accepts the Otsu thresholded Cr components and eye bounding boxes for mask detection
+// The mask detection function accepts the skin pixel counts of the eye and oronasal regions for mask detection
 // by comparing skin areas between eye region and oronasal region
 // Parameters:
-//          otsu_cr_faces:        A vector of matrices with the Otsu thresholded Cr components and vector of eye bounding boxes
-//          eye_nose_mouth_boxes: Coordinates of the eye and oronasal regions
-//          DEBUG_MODE:           To control the image display outputs
-// Pre-condition: The vectors contains valid data and correspond to the same face in the same order
-// Post-condition: The function returns the number of faces wearing a mask
-vector<int>  oronasalEyeRegionComparison(vector<Mat> otsu_cr_faces, vector<vector<int>> eye_nose_mouth_boxes, const bool DEBUG_MODE) {
+//          face_results: Results of the faces holding their regions and skin pixel counts
+//          MASK_RATIO:   A face is wearing a mask when its eye region has more than this many times the skin pixels of its oronasal region
+//          DEBUG_MODE:   To control the image display outputs
+// Pre-condition: The skin pixel counts of the faces with eyes have been computed
+// Post-condition: The decision and skin ratio of every face is stored in its result and the number of faces wearing a mask is returned
+template <bool DEBUG_MODE>
+DetectionCounts oronasalEyeRegionComparison(FaceResults& face_results, const double MASK_RATIO) {
 	// Variables to track the number of faces and masks detected
-	int masks_detected = 0;
-	int masks_not_detected = 0;
-	int faces_skipped = 0;
+	DetectionCounts counts;
 
-	for (int i = 0; i < otsu_cr_faces.size(); i++) {
-		int left_x = eye_nose_mouth_boxes.at(i).at(0);
-		int right_x = eye_nose_mouth_boxes.at(i).at(2);
-		int eye_top_y = eye_nose_mouth_boxes.at(i).at(1);
-		int eye_bottom_nose_mouth_top_y = eye_nose_mouth_boxes.at(i).at(3);
-		int nose_mouth_bottom_y = eye_nose_mouth_boxes.at(i).at(4);
+	for (auto &face_result: face_results) {
+		const int EYE_SKIN = face_result.eye_skin, NOSE_MOUTH_SKIN = face_result.nose_mouth_skin;
+		face_result.skin_ratio = NOSE_MOUTH_SKIN > 0 ? float(EYE_SKIN) / float(NOSE_MOUTH_SKIN) : (EYE_SKIN > 0 ? INFINITY : 0);
 
 		// Eyes not detected for this face, so skipping to the next face
-		if (left_x == 999 && eye_top_y == 999 && right_x == 0 && eye_bottom_nose_mouth_top_y == 0) {
-			print("Eyes not detected for this face, so skipping to the next face", DEBUG_MODE);
-			faces_skipped += 1;
+		if (!face_result.region.eyes_detected) {
+			print<DEBUG_MODE>("Eyes not detected for this face, so skipping to the next face");
+			face_result.decision = Decision::SKIPPED;
+			face_result.skip_reason = SkipReason::NO_EYES;
+			counts.eyes_skipped += 1;
 		}
 
-		else if (countNonZero(otsu_cr_faces.at(i)(Range(eye_top_y, eye_bottom_nose_mouth_top_y), Range(left_x, right_x))) > 1.2 * countNonZero(otsu_cr_faces.at(i)(Range(eye_bottom_nose_mouth_top_y, nose_mouth_bottom_y), Range(left_x, right_x)))) {
-			print("Mask detected", DEBUG_MODE);
-			masks_detected += 1;
+		else if (EYE_SKIN > MASK_RATIO * NOSE_MOUTH_SKIN) {
+			print<DEBUG_MODE>("Mask detected");
+			face_result.decision = Decision::MASK;
+			counts.masked += 1;
 		}
 
 		else {
-			print("Mask not detected", DEBUG_MODE);
-			masks_not_detected += 1;
+			print<DEBUG_MODE>("Mask not detected");
+			face_result.decision = Decision::NO_MASK;
+			counts.not_masked += 1;
 		}
 	}
-	return {faces_skipped, masks_detected, masks_not_detected};
+	return counts;
 }
 
 #endif //MAIN_POSTPROCESSING_H
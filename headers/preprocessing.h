@@ -10,6 +10,7 @@
 #include <opencv2/core.hpp>
 #include <opencv2/imgproc.hpp>
 #include "headers/helper.h"
+#include "headers/config.h"
 
 // Declaring the namespaces that would be used throughout the program
 // We can use 2 namespaces as long as there aren't any conflicts
@@ -19,26 +20,27 @@ using namespace cv;
 // The pre-processing function accepts an image, converts it to grayscale, equalizes the histogram, and smoothens it
 // Parameters:
 //          image:      A map variable to hold the images from various pre-processing stages
+//          PARAMS:     Size and standard deviations of the blur kernel
 //          DEBUG_MODE: To control the image display outputs
 // Pre-condition: A valid image is passed to the function
 // Post-condition: The pre-processed image will be returned
 // Future improvements: Experiment with the blurring parameters
-Mat preProcessing (Mat image, const bool DEBUG_MODE) {
+template <bool DEBUG_MODE>
+Mat preProcessing (Mat image, const PreProcessingParams& PARAMS) {
 	// Converting the image to grayscale
-	print("Converting the image to grayscale", DEBUG_MODE);
+	print<DEBUG_MODE>("Converting the image to grayscale");
 	cvtColor(image, image, COLOR_BGR2GRAY);
-	display("Grayscale", image, DEBUG_MODE);
+	display<DEBUG_MODE>("Grayscale", image);
 
 	// Equalizing the histogram of the grayscale image to normalize brightness and increase contrast
-	print("Equalizing the histogram of the grayscale image", DEBUG_MODE);
+	print<DEBUG_MODE>("Equalizing the histogram of the grayscale image");
 	equalizeHist(image, image);
-	display("Equalized Histogram", image, DEBUG_MODE);
+	display<DEBUG_MODE>("Equalized Histogram", image);
 
 	// Blurring the image using a Gaussian Kernel to smoothen the image
-	print("Blurring the image", DEBUG_MODE);
-	int k_width = 5, k_height = 5, k_sigma_X = 0, k_sigma_Y = 0;
-	GaussianBlur(image, image, Size(k_width,k_height), k_sigma_X, k_sigma_Y);
-	display("Smoothened Image", image, DEBUG_MODE);
+	print<DEBUG_MODE>("Blurring the image");
+	GaussianBlur(image, image, Size(PARAMS.BLUR_WIDTH, PARAMS.BLUR_HEIGHT), PARAMS.BLUR_SIGMA_X, PARAMS.BLUR_SIGMA_Y);
+	display<DEBUG_MODE>("Smoothened Image", image);
 
 	return image;
 }
@@ -0,0 +1,113 @@
+// rescore.h
+// Description: Re-scores the faces of an earlier run for a sweep of mask ratios, straight from the skin pixel counts in its columnar results
+// Assumptions: The decision of a face with eyes only depends on its two skin pixel counts and the mask ratio, so no image has to be processed again
+
+#ifndef MAIN_RESCORE_H
+#define MAIN_RESCORE_H
+
+// Import the necessary libraries for i/o
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "headers/evaluation.h"
+#include "headers/logger.h"
+#include "headers/resultstore.h"
+
+// Declaring the namespaces that would be used throughout the program
+using namespace std;
+
+// Returns the smallest mask ratio at which a face is no longer decided as wearing a mask
+// Parameters:
+//          EYE_SKIN:        Skin pixels in the eye region
+//          NOSE_MOUTH_SKIN: Skin pixels in the oronasal region
+// Pre-condition:  N/A
+// Post-condition: The face is decided as wearing a mask for every ratio below the returned value, matching EYE_SKIN > ratio * NOSE_MOUTH_SKIN
+double criticalRatio(const int EYE_SKIN, const int NOSE_MOUTH_SKIN) {
+	if (NOSE_MOUTH_SKIN > 0) {
+		return double(EYE_SKIN) / NOSE_MOUTH_SKIN;
+	}
+	// Without oronasal skin, any eye skin means a mask whatever the ratio, and no skin at all never does
+	return EYE_SKIN > 0 ? INFINITY : -INFINITY;
+}
+
+// Prints the confusion matrix metrics of the faces of an earlier run for every mask ratio of a sweep
+// Parameters:
+//          RESULTS_PATH: Location the results were written to (without the .images and .faces suffixes)
+//          FROM, TO:     First and last mask ratio of the sweep
+//          STEP:         Increment between two mask ratios
+// Pre-condition:  The step is positive
+// Post-condition: Returns false if the results cannot be read; otherwise one row per ratio and the ratio with the best F1-score are displayed
+bool rescoreResults(const string& RESULTS_PATH, const double FROM, const double TO, const double STEP) {
+	ColumnarReader images, faces;
+	if (!images.open(RESULTS_PATH + ".images") || !faces.open(RESULTS_PATH + ".faces")) {
+		logger().log(LogLevel::ERROR, "invalid_results", RESULTS_PATH);
+		return false;
+	}
+	const int WITH_MASK_COLUMN = images.column("with_mask", ColumnType::UINT8);
+	const int IMAGE_COLUMN = faces.column("image", ColumnType::UINT64);
+	const int EYES_DETECTED_COLUMN = faces.column("eyes_detected", ColumnType::UINT8);
+	const int EYE_SKIN_COLUMN = faces.column("eye_skin", ColumnType::INT32);
+	const int NOSE_MOUTH_SKIN_COLUMN = faces.column("nose_mouth_skin", ColumnType::INT32);
+	if (min({WITH_MASK_COLUMN, IMAGE_COLUMN, EYES_DETECTED_COLUMN, EYE_SKIN_COLUMN, NOSE_MOUTH_SKIN_COLUMN}) < 0) {
+		logger().log(LogLevel::ERROR, "invalid_results", RESULTS_PATH);
+		return false;
+	}
+
+	// Labels of the images, indexed by their row in the image table
+	vector<uint8_t> with_mask;
+	with_mask.reserve(images.rowCount());
+	for (size_t block = 0; block < images.blockCount(); block++) {
+		const uint8_t* WITH_MASK = images.values<uint8_t>(block, WITH_MASK_COLUMN);
+		with_mask.insert(with_mask.end(), WITH_MASK, WITH_MASK + images.blockRows(block));
+	}
+
+	// One pass over the faces, keeping the critical ratio of every face with eyes by the label of its image
+	vector<double> positives, negatives;
+	for (size_t block = 0; block < faces.blockCount(); block++) {
+		const uint64_t* IMAGE = faces.values<uint64_t>(block, IMAGE_COLUMN);
+		const uint8_t* EYES_DETECTED = faces.values<uint8_t>(block, EYES_DETECTED_COLUMN);
+		const int32_t* EYE_SKIN = faces.values<int32_t>(block, EYE_SKIN_COLUMN);
+		const int32_t* NOSE_MOUTH_SKIN = faces.values<int32_t>(block, NOSE_MOUTH_SKIN_COLUMN);
+		for (uint64_t row = 0; row < faces.blockRows(block); row++) {
+			if (EYES_DETECTED[row] == 0 || IMAGE[row] >= with_mask.size()) {
+				continue;
+			}
+			(with_mask[IMAGE[row]] != 0 ? positives : negatives).push_back(criticalRatio(EYE_SKIN[row], NOSE_MOUTH_SKIN[row]));
+		}
+	}
+	sort(positives.begin(), positives.end());
+	sort(negatives.begin(), negatives.end());
+
+	// The faces decided as wearing a mask at a ratio are those whose critical ratio is above it
+	cout << left << setw(12) << "Mask ratio" << right << setw(10) << "Accuracy" << setw(11) << "Precision" << setw(8) << "Recall" << setw(10) << "F1-Score" << endl;
+	double best_ratio = FROM, best_f1 = -1;
+	const int STEPS = int(floor((TO - FROM) / STEP + 1e-9));
+	for (int i = 0; i <= STEPS; i++) {
+		const double RATIO = FROM + i * STEP;
+		ConfusionMatrix matrix;
+		matrix.true_positives = positives.end() - upper_bound(positives.begin(), positives.end(), RATIO);
+		matrix.false_negatives = (long long)positives.size() - matrix.true_positives;
+		matrix.false_positives = negatives.end() - upper_bound(negatives.begin(), negatives.end(), RATIO);
+		matrix.true_negatives = (long long)negatives.size() - matrix.false_positives;
+		cout << left << fixed << setprecision(2) << setw(12) << RATIO << right << setprecision(1)
+		     << setw(9) << 100 * matrix.accuracy() << "%" << setw(10) << 100 * matrix.precision() << "%"
+		     << setw(7) << 100 * matrix.recall() << "%" << setw(9) << 100 * matrix.f1() << "%" << endl;
+		cout.unsetf(ios::fixed);
+		cout << setprecision(6);
+		if (matrix.f1() > best_f1) {
+			best_f1 = matrix.f1();
+			best_ratio = RATIO;
+		}
+	}
+	cout << endl;
+	cout << "Faces re-scored: " << positives.size() + negatives.size() << endl;
+	cout << "Best F1-score: " << fixed << setprecision(1) << 100 * best_f1 << "% at mask ratio " << setprecision(2) << best_ratio << endl;
+	cout.unsetf(ios::fixed);
+	cout << setprecision(6);
+	return true;
+}
+
+#endif //MAIN_RESCORE_H
@@ -0,0 +1,294 @@
+// resultcache.h
+// Description: A persistent cache of the per face results, keyed by the content of the encoded image and by the cascades and parameters that produced them,
+//              so images seen before skip the decoding and the detection
+// Assumptions: RESULT_CACHE_VERSION must be bumped whenever the detection changes in a way the cascades and the parameters do not capture
+
+#ifndef MAIN_RESULTCACHE_H
+#define MAIN_RESULTCACHE_H
+
+// Import the necessary libraries for i/o and file mapping
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <list>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "headers/config.h"
+#include "headers/hash.h"
+#include "headers/logger.h"
+#include "headers/mappedfile.h"
+#include "headers/results.h"
+
+// Declaring the namespaces that would be used throughout the program
+using namespace std;
+
+// Identifies a result cache file and the version of its layout and of the detection that produced it
+const uint32_t RESULT_CACHE_MAGIC = 0x534C5352;  // "RSLS"
+const uint32_t RESULT_CACHE_VERSION = 1;
+
+// Layout of a result cache file: the header, the entries from the most to the least recently used, and the faces of every entry
+//          entry_count: Number of entry records
+//          face_count:  Number of face records
+struct ResultCacheHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t entry_count;
+	uint64_t face_count;
+};
+
+// A cached image
+//          key:          Hash of the encoded image combined with the hash of the cascades and parameters
+//          content_size: Size of the encoded image, checked along with the key
+//          first_face:   Index of its first face record
+//          face_count:   Number of faces detected in the image
+struct ResultCacheEntry {
+	uint64_t key;
+	uint64_t content_size;
+	uint64_t first_face;
+	uint32_t face_count;
+	uint32_t padding;
+};
+
+// The results of a face, as stored in the cache
+struct CachedFace {
+	int32_t x, y, width, height;
+	int32_t left_x, eye_top_y, right_x, eye_bottom_nose_mouth_top_y, nose_mouth_bottom_y;
+	int32_t eye_skin, nose_mouth_skin;
+	float skin_ratio;
+	uint8_t eyes_detected, decision, skip_reason, padding;
+};
+
+// The records are mapped in place, so their layout must not depend on the compiler's padding
+static_assert(sizeof(ResultCacheHeader) == 24 && sizeof(ResultCacheEntry) == 32 && sizeof(CachedFace) == 52, "Unexpected result cache record layout");
+
+// Tallies the decisions of the faces of an image
+// Parameters:
+//          FACES:    Results of the detected faces
+//          EXPECTED: Number of faces in the image
+// Pre-condition:  N/A
+// Post-condition: Returns the same counts oronasalEyeRegionComparison and maskDetection produced along with the decisions
+DetectionCounts countDecisions(const FaceResults& FACES, const int EXPECTED) {
+	DetectionCounts counts;
+	for (auto &face: FACES) {
+		counts.eyes_skipped += face.decision == Decision::SKIPPED ? 1 : 0;
+		counts.masked += face.decision == Decision::MASK ? 1 : 0;
+		counts.not_masked += face.decision == Decision::NO_MASK ? 1 : 0;
+	}
+	counts.faces_skipped = EXPECTED - FACES.size();
+	return counts;
+}
+
+// Keeps the results of up to CAPACITY images in memory, evicting the least recently used, and persists them between runs
+class ResultCache {
+public:
+	// Parameters:
+	//          PATH:          Location of the cache file (created at the end of the run if missing)
+	//          CAPACITY:      Maximum number of images kept
+	//          CASCADE_FILES: Cascade files used by the detection; the results of other cascades are never returned
+	ResultCache(const string& PATH, const size_t CAPACITY, const vector<string>& CASCADE_FILES) : path(PATH), capacity(CAPACITY) {
+		string contents;
+		cascades_hash = RESULT_CACHE_VERSION;
+		for (auto &file: CASCADE_FILES) {
+			ifstream cascade(file, ifstream::binary);
+			contents.assign(istreambuf_iterator<char>(cascade), istreambuf_iterator<char>());
+			cascades_hash = hashBytes(contents, cascades_hash);
+		}
+		if (!load()) {
+			entries.clear();
+			index.clear();
+		}
+	}
+
+	// Hash of the cascades and of the parameters of the detection, which every lookup and store is keyed by
+	uint64_t configHash(const Config& CONFIG) const {
+		string params;
+		const auto APPEND = [&params](const auto& VALUE) { params.append(reinterpret_cast<const char*>(&VALUE), sizeof(VALUE)); };
+		APPEND(CONFIG.PRE_PROCESSING.BLUR_WIDTH);
+		APPEND(CONFIG.DECODE_SCALE);
+		APPEND(CONFIG.FACE_CASCADES);
+		APPEND(CONFIG.PRE_PROCESSING.BLUR_HEIGHT);
+		APPEND(CONFIG.PRE_PROCESSING.BLUR_SIGMA_X);
+		APPEND(CONFIG.PRE_PROCESSING.BLUR_SIGMA_Y);
+		APPEND(CONFIG.FACE_DETECTION.SCALE_FACTOR);
+		APPEND(CONFIG.FACE_DETECTION.MIN_NEIGHBORS);
+		APPEND(CONFIG.FACE_DETECTION.MIN_FACE);
+		APPEND(CONFIG.FACE_DETECTION.MAX_FACE);
+		APPEND(CONFIG.EYE_SEARCH);
+		APPEND(CONFIG.CANONICAL_FACE_SIZE);
+		APPEND(CONFIG.MASK_RATIO);
+		return hashBytes(params, cascades_hash);
+	}
+
+	// Looks the results of an encoded image up
+	// Parameters:
+	//          BYTES:       The encoded image
+	//          CONFIG_HASH: Hash of the cascades and parameters of the run
+	//          faces:       Receives the results of the faces on a hit
+	// Pre-condition:  N/A
+	// Post-condition: Returns true on a hit, which makes the image the most recently used
+	bool lookup(const string_view BYTES, const uint64_t CONFIG_HASH, FaceResults& faces) {
+		const auto FOUND = index.find(key(BYTES, CONFIG_HASH));
+		if (FOUND == index.end() || FOUND->second->content_size != BYTES.size()) {
+			misses += 1;
+			return false;
+		}
+		entries.splice(entries.begin(), entries, FOUND->second);
+		faces.clear();
+		for (auto &cached: FOUND->second->faces) {
+			FaceResult face;
+			face.face = Rect(cached.x, cached.y, cached.width, cached.height);
+			face.region.left_x = cached.left_x;
+			face.region.eye_top_y = cached.eye_top_y;
+			face.region.right_x = cached.right_x;
+			face.region.eye_bottom_nose_mouth_top_y = cached.eye_bottom_nose_mouth_top_y;
+			face.region.nose_mouth_bottom_y = cached.nose_mouth_bottom_y;
+			face.region.eyes_detected = cached.eyes_detected != 0;
+			face.eye_skin = cached.eye_skin;
+			face.nose_mouth_skin = cached.nose_mouth_skin;
+			face.skin_ratio = cached.skin_ratio;
+			face.decision = Decision(cached.decision);
+			face.skip_reason = SkipReason(cached.skip_reason);
+			faces.push_back(face);
+		}
+		hits += 1;
+		return true;
+	}
+
+	// Stores the results of an encoded image, evicting the least recently used image once the cache is full
+	// Parameters:
+	//          BYTES:       The encoded image
+	//          CONFIG_HASH: Hash of the cascades and parameters of the run
+	//          FACES:       Results of the faces of the image
+	// Pre-condition:  N/A
+	// Post-condition: The image is the most recently used
+	void store(const string_view BYTES, const uint64_t CONFIG_HASH, const FaceResults& FACES) {
+		const uint64_t KEY = key(BYTES, CONFIG_HASH);
+		const auto FOUND = index.find(KEY);
+		if (FOUND != index.end()) {
+			entries.erase(FOUND->second);
+			index.erase(FOUND);
+		}
+		Entry entry;
+		entry.key = KEY;
+		entry.content_size = BYTES.size();
+		for (auto &face: FACES) {
+			CachedFace cached{};
+			cached.x = face.face.x;
+			cached.y = face.face.y;
+			cached.width = face.face.width;
+			cached.height = face.face.height;
+			cached.left_x = face.region.left_x;
+			cached.eye_top_y = face.region.eye_top_y;
+			cached.right_x = face.region.right_x;
+			cached.eye_bottom_nose_mouth_top_y = face.region.eye_bottom_nose_mouth_top_y;
+			cached.nose_mouth_bottom_y = face.region.nose_mouth_bottom_y;
+			cached.eyes_detected = face.region.eyes_detected;
+			cached.eye_skin = face.eye_skin;
+			cached.nose_mouth_skin = face.nose_mouth_skin;
+			cached.skin_ratio = face.skin_ratio;
+			cached.decision = uint8_t(face.decision);
+			cached.skip_reason = uint8_t(face.skip_reason);
+			entry.faces.push_back(cached);
+		}
+		entries.push_front(move(entry));
+		index[KEY] = entries.begin();
+		while (entries.size() > capacity) {
+			index.erase(entries.back().key);
+			entries.pop_back();
+			evictions += 1;
+		}
+		modified = true;
+	}
+
+	// Writes the cache back to its file if anything was stored
+	// Pre-condition:  N/A
+	// Post-condition: Returns false if the file could not be written; the previous file is kept in that case
+	bool save() {
+		if (!modified) {
+			return true;
+		}
+		const string TEMPORARY_PATH = path + ".tmp";
+		FILE* file = fopen(TEMPORARY_PATH.c_str(), "wb");
+		if (file == nullptr) {
+			return false;
+		}
+		ResultCacheHeader header{RESULT_CACHE_MAGIC, RESULT_CACHE_VERSION, entries.size(), 0};
+		vector<ResultCacheEntry> records;
+		records.reserve(entries.size());
+		for (auto &entry: entries) {
+			records.push_back(ResultCacheEntry{entry.key, entry.content_size, header.face_count, uint32_t(entry.faces.size()), 0});
+			header.face_count += entry.faces.size();
+		}
+		bool written = fwrite(&header, sizeof(header), 1, file) == 1;
+		written = written && (records.empty() || fwrite(records.data(), sizeof(ResultCacheEntry), records.size(), file) == records.size());
+		for (auto &entry: entries) {
+			written = written && (entry.faces.empty() || fwrite(entry.faces.data(), sizeof(CachedFace), entry.faces.size(), file) == entry.faces.size());
+		}
+		written = fclose(file) == 0 && written;
+		if (!written || rename(TEMPORARY_PATH.c_str(), path.c_str()) != 0) {
+			remove(TEMPORARY_PATH.c_str());
+			logger().log(LogLevel::WARNING, "result_cache_unwritable", path);
+			return false;
+		}
+		modified = false;
+		return true;
+	}
+
+	long long hitCount() const { return hits; }
+
+	long long missCount() const { return misses; }
+
+	long long evictionCount() const { return evictions; }
+
+private:
+	struct Entry {
+		uint64_t key = 0;
+		uint64_t content_size = 0;
+		vector<CachedFace> faces;
+	};
+
+	static uint64_t key(const string_view BYTES, const uint64_t CONFIG_HASH) {
+		return hashBytes(string_view(reinterpret_cast<const char*>(&CONFIG_HASH), sizeof(CONFIG_HASH)), hashBytes(BYTES));
+	}
+
+	// Reads the cache file, keeping the most recently used entries up to the capacity
+	bool load() {
+		MappedFile file;
+		if (!file.open(path) || file.size() < sizeof(ResultCacheHeader)) {
+			return false;
+		}
+		const auto* HEADER = reinterpret_cast<const ResultCacheHeader*>(file.data());
+		if (HEADER->magic != RESULT_CACHE_MAGIC || HEADER->version != RESULT_CACHE_VERSION
+		    || sizeof(ResultCacheHeader) + HEADER->entry_count * sizeof(ResultCacheEntry) + HEADER->face_count * sizeof(CachedFace) != file.size()) {
+			return false;
+		}
+		const auto* RECORDS = reinterpret_cast<const ResultCacheEntry*>(file.data() + sizeof(ResultCacheHeader));
+		const auto* FACES = reinterpret_cast<const CachedFace*>(RECORDS + HEADER->entry_count);
+		for (uint64_t i = 0; i < HEADER->entry_count && entries.size() < capacity; i++) {
+			if (RECORDS[i].first_face + RECORDS[i].face_count > HEADER->face_count) {
+				return false;
+			}
+			Entry entry;
+			entry.key = RECORDS[i].key;
+			entry.content_size = RECORDS[i].content_size;
+			entry.faces.assign(FACES + RECORDS[i].first_face, FACES + RECORDS[i].first_face + RECORDS[i].face_count);
+			entries.push_back(move(entry));
+			index[entries.back().key] = prev(entries.end());
+		}
+		// Entries dropped to fit a smaller capacity are only dropped from the file when it is written again
+		return true;
+	}
+
+	const string path;
+	const size_t capacity;
+	uint64_t cascades_hash = 0;
+	list<Entry> entries;
+	unordered_map<uint64_t, list<Entry>::iterator> index;
+	bool modified = false;
+	long long hits = 0, misses = 0, evictions = 0;
+};
+
+#endif //MAIN_RESULTCACHE_H
@@ -0,0 +1,134 @@
+// results.h
+// Description: Fixed layout result types produced by the mask detection algorithm for every face and image
+// Assumptions: An image rarely has more faces than MAX_INLINE_FACES, so the per image results normally live without any heap allocation
+
+#ifndef MAIN_RESULTS_H
+#define MAIN_RESULTS_H
+
+// Import the necessary libraries for opencv
+#include <vector>
+#include <cstdint>
+#include <opencv2/core.hpp>
+
+// Declaring the namespaces that would be used throughout the program
+// We can use 2 namespaces as long as there aren't any conflicts
+using namespace std;
+using namespace cv;
+
+// Number of faces per image stored inline before the results spill to the heap
+const int MAX_INLINE_FACES = 8;
+
+// Mask decision made for a face
+enum class Decision : uint8_t { SKIPPED, MASK, NO_MASK };
+
+// Reason a detected face was skipped without a mask decision
+enum class SkipReason : uint8_t { NONE, NO_EYES };
+
+// Work dropped from an image to meet its deadline, combined as flags
+//          DOWNSCALED:       The faces were searched on a downscaled image
+//          FALLBACK_SKIPPED: The second face cascade was not tried after the first found no face
+//          GLASSES_SKIPPED:  The eyeglasses cascade was not run on at least one face
+enum Degradation : uint8_t { NOT_DEGRADED = 0, DOWNSCALED = 1, FALLBACK_SKIPPED = 2, GLASSES_SKIPPED = 4 };
+
+// Eye and oronasal regions of a face, in the coordinates of the face
+//          left_x, right_x:             Horizontal extent shared by both regions
+//          eye_top_y:                   Top of the eye region
+//          eye_bottom_nose_mouth_top_y: Bottom of the eye region and top of the oronasal region
+//          nose_mouth_bottom_y:         Bottom of the oronasal region
+//          eyes_detected:               False when no eye was found, in which case the coordinates are meaningless
+struct EyeNoseMouthBox {
+	int left_x = 0, eye_top_y = 0, right_x = 0, eye_bottom_nose_mouth_top_y = 0, nose_mouth_bottom_y = 0;
+	bool eyes_detected = false;
+};
+
+// Everything computed for one detected face
+//          face:            Bounding box of the face in the image
+//          region:          Eye and oronasal regions in the coordinates of the cropped face
+//          eye_skin:        Skin pixels in the eye region (counted on the resampled face when face size normalization is on)
+//          nose_mouth_skin: Skin pixels in the oronasal region
+//          skin_ratio:      eye_skin / nose_mouth_skin (0 when both are 0)
+//          decision:        Whether the face is wearing a mask
+//          skip_reason:     Why no decision was made, if the face was skipped
+struct FaceResult {
+	Rect face;
+	EyeNoseMouthBox region;
+	int eye_skin = 0, nose_mouth_skin = 0;
+	float skin_ratio = 0;
+	Decision decision = Decision::SKIPPED;
+	SkipReason skip_reason = SkipReason::NONE;
+};
+
+// Counts of the outcomes of the faces in an image or a set of images
+//          eyes_skipped:  Faces skipped because no eyes were detected
+//          masked:        Faces detected as wearing a mask
+//          not_masked:    Faces detected as not wearing a mask
+//          faces_skipped: Expected faces that were not detected (ground truth minus detected faces)
+struct DetectionCounts {
+	int eyes_skipped = 0, masked = 0, not_masked = 0, faces_skipped = 0;
+
+	DetectionCounts& operator+=(const DetectionCounts& OTHER) {
+		eyes_skipped += OTHER.eyes_skipped;
+		masked += OTHER.masked;
+		not_masked += OTHER.not_masked;
+		faces_skipped += OTHER.faces_skipped;
+		return *this;
+	}
+};
+
+// A vector that keeps its first N items inline and only allocates when more are added
+// The heap storage is kept across clear() so a reused container stops allocating once it has grown
+template <typename T, int N>
+class SmallVector {
+public:
+	int size() const { return count; }
+	bool empty() const { return count == 0; }
+	T* begin() { return data(); }
+	T* end() { return data() + count; }
+	const T* begin() const { return data(); }
+	const T* end() const { return data() + count; }
+	T& operator[](const int INDEX) { return data()[INDEX]; }
+	const T& operator[](const int INDEX) const { return data()[INDEX]; }
+
+	void push_back(const T& ITEM) {
+		if (count < N) {
+			inline_items[count] = ITEM;
+		}
+		else {
+			// Moving the inline items to the heap the first time the inline storage runs out
+			if (count == N) {
+				overflow_items.assign(inline_items, inline_items + N);
+			}
+			overflow_items.push_back(ITEM);
+		}
+		count += 1;
+	}
+
+	void clear() {
+		count = 0;
+		overflow_items.clear();
+	}
+
+private:
+	T* data() { return count <= N ? inline_items : overflow_items.data(); }
+	const T* data() const { return count <= N ? inline_items : overflow_items.data(); }
+
+	T inline_items[N];
+	vector<T> overflow_items;
+	int count = 0;
+};
+
+typedef SmallVector<FaceResult, MAX_INLINE_FACES> FaceResults;
+
+// Results of the mask detection algorithm for one image
+//          faces:    Per face results in detection order
+//          counts:   Outcome counts of the faces of the image
+//          degraded: Degradation flags of the work dropped to meet the deadline of the image
+//          reused:   The faces were copied from a recent near-duplicate image instead of being detected
+struct ImageResult {
+	FaceResults faces;
+	DetectionCounts counts;
+	uint8_t degraded = NOT_DEGRADED;
+	bool reused = false;
+};
+
+#endif //MAIN_RESULTS_H
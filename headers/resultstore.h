@@ -0,0 +1,515 @@
+// resultstore.h
+// Description: A columnar binary format for the per image and per face results, written in large blocks by a background thread and read back through a memory mapping,
+//              along with the csv layout the results have always been reported in
+// Assumptions: Rows are only appended; a file is complete once its footer is written, so a crashed run leaves no file that a reader would accept
+
+#ifndef MAIN_RESULTSTORE_H
+#define MAIN_RESULTSTORE_H
+
+// Import the necessary libraries for i/o and threading
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "headers/concurrency.h"
+#include "headers/imagesource.h"
+#include "headers/logger.h"
+#include "headers/mappedfile.h"
+#include "headers/results.h"
+
+// Declaring the namespaces that would be used throughout the program
+using namespace std;
+
+// Identifies a columnar file and the version of its layout
+const uint32_t COLUMNAR_MAGIC = 0x4C4F434D;  // "MCOL"
+const uint32_t COLUMNAR_VERSION = 1;
+// Rows buffered before a block is handed to the writer thread
+const size_t COLUMNAR_BLOCK_ROWS = 65536;
+// Blocks waiting for the writer thread before the run has to wait
+const size_t COLUMNAR_QUEUE_SIZE = 4;
+// Longest column name stored in the file
+const int COLUMN_NAME_LENGTH = 24;
+
+// Type of the values of a column; TEXT columns store one offset per row (plus one) followed by the characters
+enum class ColumnType : uint8_t { UINT8, INT32, FLOAT32, UINT64, TEXT };
+
+// Name and type of a column
+struct ColumnSpec {
+	const char* name;
+	ColumnType type;
+};
+
+// Size of one value of a fixed size column
+size_t columnValueSize(const ColumnType TYPE) {
+	switch (TYPE) {
+		case ColumnType::UINT8: return 1;
+		case ColumnType::INT32: return 4;
+		case ColumnType::FLOAT32: return 4;
+		default: return 8;
+	}
+}
+
+// Layout of a columnar file: the header and column descriptors, the blocks, the footer with the offset of every block, and the trailer
+//          Each block starts with its row count and then holds every column in turn, each padded to 8 bytes
+struct ColumnarHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t column_count;
+	uint32_t reserved;
+};
+
+struct ColumnDescriptor {
+	char name[COLUMN_NAME_LENGTH];
+	uint8_t type;
+	uint8_t padding[7];
+};
+
+//          footer_offset: Offset of the block offsets
+//          block_count:   Number of blocks
+//          row_count:     Number of rows over every block
+struct ColumnarTrailer {
+	uint64_t footer_offset;
+	uint64_t block_count;
+	uint64_t row_count;
+	uint32_t magic;
+	uint32_t reserved;
+};
+
+// The records are mapped in place, so their layout must not depend on the compiler's padding
+static_assert(sizeof(ColumnarHeader) == 16 && sizeof(ColumnDescriptor) == 32 && sizeof(ColumnarTrailer) == 32, "Unexpected columnar record layout");
+
+// The values of every column for a range of rows
+struct ColumnBlock {
+	vector<vector<char>> values;
+	vector<vector<uint64_t>> text_offsets;
+	uint64_t rows = 0;
+};
+
+// Appends rows to a columnar file; full blocks are written by a background thread while the next block fills up
+class ColumnarWriter {
+public:
+	// Parameters:
+	//          PATH:    Location of the file; it is written under a temporary name and renamed when finished
+	//          COLUMNS: Names and types of the columns
+	ColumnarWriter(const string& PATH, const vector<ColumnSpec>& COLUMNS) : path(PATH), columns(COLUMNS), blocks(COLUMNAR_QUEUE_SIZE) {
+		file = fopen((path + ".tmp").c_str(), "wb");
+		if (file == nullptr) {
+			logger().log(LogLevel::ERROR, "results_unwritable", path);
+			exit(0);
+		}
+		// Large stdio buffers, since the blocks are written in a few big calls anyway
+		setvbuf(file, nullptr, _IOFBF, 1 << 20);
+		ColumnarHeader header{COLUMNAR_MAGIC, COLUMNAR_VERSION, uint32_t(columns.size()), 0};
+		written = fwrite(&header, sizeof(header), 1, file) == 1;
+		for (auto &column: columns) {
+			ColumnDescriptor descriptor{};
+			strncpy(descriptor.name, column.name, COLUMN_NAME_LENGTH - 1);
+			descriptor.type = uint8_t(column.type);
+			written = written && fwrite(&descriptor, sizeof(descriptor), 1, file) == 1;
+		}
+		offset = sizeof(ColumnarHeader) + columns.size() * sizeof(ColumnDescriptor);
+		startBlock();
+		writer = thread([this] { writeLoop(); });
+	}
+
+	~ColumnarWriter() { finish(); }
+
+	// Sets a value of the current row; every column must be set once per row
+	template <typename T>
+	void set(const int COLUMN, const T VALUE) {
+		vector<char>& values = block.values[size_t(COLUMN)];
+		values.insert(values.end(), reinterpret_cast<const char*>(&VALUE), reinterpret_cast<const char*>(&VALUE) + sizeof(T));
+	}
+
+	void setText(const int COLUMN, const string_view TEXT) {
+		vector<char>& values = block.values[size_t(COLUMN)];
+		values.insert(values.end(), TEXT.begin(), TEXT.end());
+		block.text_offsets[size_t(COLUMN)].push_back(values.size());
+	}
+
+	// Completes the current row, handing the block to the writer thread once it is full
+	void endRow() {
+		block.rows += 1;
+		rows += 1;
+		if (block.rows == COLUMNAR_BLOCK_ROWS) {
+			blocks.push(move(block));
+			startBlock();
+		}
+	}
+
+	uint64_t rowCount() const { return rows; }
+
+	// Writes the last block and the footer and moves the file into place
+	// Returns false if anything could not be written
+	bool finish() {
+		if (file == nullptr) {
+			return written;
+		}
+		if (block.rows > 0) {
+			blocks.push(move(block));
+		}
+		blocks.close();
+		writer.join();
+		ColumnarTrailer trailer{offset, block_offsets.size(), rows, COLUMNAR_MAGIC, 0};
+		written = written && (block_offsets.empty() || fwrite(block_offsets.data(), sizeof(uint64_t), block_offsets.size(), file) == block_offsets.size());
+		written = written && fwrite(&trailer, sizeof(trailer), 1, file) == 1;
+		written = fclose(file) == 0 && written;
+		file = nullptr;
+		written = written && rename((path + ".tmp").c_str(), path.c_str()) == 0;
+		if (!written) {
+			logger().log(LogLevel::ERROR, "results_unwritable", path);
+		}
+		return written;
+	}
+
+private:
+	void startBlock() {
+		block = ColumnBlock();
+		block.values.resize(columns.size());
+		block.text_offsets.resize(columns.size());
+		for (size_t i = 0; i < columns.size(); i++) {
+			if (columns[i].type == ColumnType::TEXT) {
+				block.text_offsets[i].push_back(0);
+			}
+		}
+	}
+
+	bool writePadded(const void* DATA, const size_t SIZE) {
+		const char ZEROS[8] = {};
+		const size_t PADDING = (8 - SIZE % 8) % 8;
+		offset += SIZE + PADDING;
+		return (SIZE == 0 || fwrite(DATA, 1, SIZE, file) == SIZE) && fwrite(ZEROS, 1, PADDING, file) == PADDING;
+	}
+
+	// Writes the blocks handed over by the run until the writer is finished
+	void writeLoop() {
+		ColumnBlock full;
+		while (blocks.pop(full)) {
+			block_offsets.push_back(offset);
+			written = written && writePadded(&full.rows, sizeof(full.rows));
+			for (size_t i = 0; i < columns.size(); i++) {
+				if (columns[i].type == ColumnType::TEXT) {
+					written = written && writePadded(full.text_offsets[i].data(), full.text_offsets[i].size() * sizeof(uint64_t));
+				}
+				written = written && writePadded(full.values[i].data(), full.values[i].size());
+			}
+		}
+	}
+
+	const string path;
+	const vector<ColumnSpec> columns;
+	FILE* file = nullptr;
+	bool written = false;
+	uint64_t offset = 0;
+	uint64_t rows = 0;
+	vector<uint64_t> block_offsets;
+	ColumnBlock block;
+	BoundedQueue<ColumnBlock> blocks;
+	thread writer;
+};
+
+// Reads a columnar file through a memory mapping; the values of a column within a block are a plain array
+class ColumnarReader {
+public:
+	// Maps the file and locates every column of every block
+	// Parameters:
+	//          PATH: Location of the file
+	// Pre-condition:  N/A
+	// Post-condition: Returns false if the file is missing, incomplete, or corrupt
+	bool open(const string& PATH) {
+		if (!file.open(PATH) || file.size() < sizeof(ColumnarHeader) + sizeof(ColumnarTrailer)) {
+			return false;
+		}
+		const auto* HEADER = reinterpret_cast<const ColumnarHeader*>(file.data());
+		const auto* TRAILER = reinterpret_cast<const ColumnarTrailer*>(file.data() + file.size() - sizeof(ColumnarTrailer));
+		if (HEADER->magic != COLUMNAR_MAGIC || HEADER->version != COLUMNAR_VERSION || TRAILER->magic != COLUMNAR_MAGIC
+		    || TRAILER->block_count > file.size() / sizeof(uint64_t)
+		    || TRAILER->footer_offset + TRAILER->block_count * sizeof(uint64_t) + sizeof(ColumnarTrailer) != file.size()) {
+			return false;
+		}
+		// The column descriptors come before the first block, so they end before the footer
+		if (sizeof(ColumnarHeader) + uint64_t(HEADER->column_count) * sizeof(ColumnDescriptor) > TRAILER->footer_offset) {
+			return false;
+		}
+		const auto* DESCRIPTORS = reinterpret_cast<const ColumnDescriptor*>(file.data() + sizeof(ColumnarHeader));
+		for (uint32_t i = 0; i < HEADER->column_count; i++) {
+			if (DESCRIPTORS[i].type > uint8_t(ColumnType::TEXT)) {
+				return false;
+			}
+			names.emplace_back(DESCRIPTORS[i].name, strnlen(DESCRIPTORS[i].name, COLUMN_NAME_LENGTH));
+			types.push_back(ColumnType(DESCRIPTORS[i].type));
+		}
+		row_count = TRAILER->row_count;
+
+		const auto* BLOCK_OFFSETS = reinterpret_cast<const uint64_t*>(file.data() + TRAILER->footer_offset);
+		for (uint64_t i = 0; i < TRAILER->block_count; i++) {
+			uint64_t position = BLOCK_OFFSETS[i];
+			if (position > TRAILER->footer_offset - sizeof(uint64_t)) {
+				return false;
+			}
+			const uint64_t ROWS = *reinterpret_cast<const uint64_t*>(file.data() + position);
+			// Every value takes at least a byte, so a larger row count cannot fit before the footer
+			if (ROWS > TRAILER->footer_offset) {
+				return false;
+			}
+			position += sizeof(uint64_t);
+			block_rows.push_back(ROWS);
+			vector<uint64_t> offsets;
+			for (size_t j = 0; j < types.size(); j++) {
+				uint64_t size = ROWS * columnValueSize(types[j]);
+				if (types[j] == ColumnType::TEXT) {
+					offsets.push_back(position);
+					const uint64_t OFFSETS_SIZE = (ROWS + 1) * sizeof(uint64_t);
+					if (position + OFFSETS_SIZE > TRAILER->footer_offset) {
+						return false;
+					}
+					// The row offsets are followed as they are when a value is read, so each one must start where the previous one ended and stay within the characters
+					const uint64_t* TEXT_OFFSETS = reinterpret_cast<const uint64_t*>(file.data() + position);
+					size = TEXT_OFFSETS[ROWS];
+					if (TEXT_OFFSETS[0] != 0) {
+						return false;
+					}
+					for (uint64_t row = 0; row < ROWS; row++) {
+						if (TEXT_OFFSETS[row + 1] < TEXT_OFFSETS[row]) {
+							return false;
+						}
+					}
+					position += (OFFSETS_SIZE + 7) / 8 * 8;
+				}
+				offsets.push_back(position);
+				if (position > TRAILER->footer_offset || size > TRAILER->footer_offset - position) {
+					return false;
+				}
+				position += (size + 7) / 8 * 8;
+				if (position > TRAILER->footer_offset) {
+					return false;
+				}
+			}
+			column_offsets.push_back(offsets);
+		}
+		return true;
+	}
+
+	size_t blockCount() const { return block_rows.size(); }
+
+	uint64_t blockRows(const size_t BLOCK) const { return block_rows[BLOCK]; }
+
+	uint64_t rowCount() const { return row_count; }
+
+	// Returns the index of a column, or -1 if the file has no column with that name
+	int column(const string_view NAME) const {
+		for (size_t i = 0; i < names.size(); i++) {
+			if (names[i] == NAME) {
+				return int(i);
+			}
+		}
+		return -1;
+	}
+
+	// Returns the index of a column, or -1 if the file has no column with that name and type
+	int column(const string_view NAME, const ColumnType TYPE) const {
+		const int COLUMN = column(NAME);
+		return COLUMN >= 0 && types[size_t(COLUMN)] == TYPE ? COLUMN : -1;
+	}
+
+	// Returns the values of a fixed size column within a block
+	template <typename T>
+	const T* values(const size_t BLOCK, const int COLUMN) const {
+		return reinterpret_cast<const T*>(file.data() + columnOffset(BLOCK, COLUMN));
+	}
+
+	// Returns a value of a text column; its offsets were checked against the size of the column when the file was opened
+	string_view text(const size_t BLOCK, const int COLUMN, const uint64_t ROW) const {
+		const uint64_t* OFFSETS = reinterpret_cast<const uint64_t*>(file.data() + column_offsets[BLOCK][textIndex(COLUMN)]);
+		const char* CHARACTERS = file.data() + columnOffset(BLOCK, COLUMN);
+		return string_view(CHARACTERS + OFFSETS[ROW], OFFSETS[ROW + 1] - OFFSETS[ROW]);
+	}
+
+private:
+	// Text columns take two slots in the offsets of a block: their row offsets and then their characters
+	size_t textIndex(const int COLUMN) const {
+		size_t index = 0;
+		for (int i = 0; i < COLUMN; i++) {
+			index += types[size_t(i)] == ColumnType::TEXT ? 2 : 1;
+		}
+		return index;
+	}
+
+	uint64_t columnOffset(const size_t BLOCK, const int COLUMN) const {
+		return column_offsets[BLOCK][textIndex(COLUMN) + (types[size_t(COLUMN)] == ColumnType::TEXT ? 1 : 0)];
+	}
+
+	MappedFile file;
+	vector<string> names;
+	vector<ColumnType> types;
+	vector<uint64_t> block_rows;
+	vector<vector<uint64_t>> column_offsets;
+	uint64_t row_count = 0;
+};
+
+// Columns of the image table, one row per image
+enum ImageColumn { IMAGE_PATH, IMAGE_ID, IMAGE_WITH_MASK, IMAGE_GROUND_TRUTH, IMAGE_FACES_SKIPPED, IMAGE_EYES_SKIPPED, IMAGE_MASKED, IMAGE_NOT_MASKED, IMAGE_FIRST_FACE, IMAGE_FACE_COUNT, IMAGE_LOAD_MS, IMAGE_DETECT_MS, IMAGE_DEGRADED, IMAGE_REUSED };
+const vector<ColumnSpec> IMAGE_COLUMNS = {
+	{"path", ColumnType::TEXT}, {"image_id", ColumnType::INT32}, {"with_mask", ColumnType::UINT8}, {"ground_truth", ColumnType::INT32},
+	{"faces_skipped", ColumnType::INT32}, {"eyes_skipped", ColumnType::INT32}, {"masked", ColumnType::INT32}, {"not_masked", ColumnType::INT32},
+	{"first_face", ColumnType::UINT64}, {"face_count", ColumnType::INT32}, {"load_ms", ColumnType::FLOAT32}, {"detect_ms", ColumnType::FLOAT32},
+	{"degraded", ColumnType::UINT8}, {"reused", ColumnType::UINT8}
+};
+
+// Columns of the face table, one row per detected face; image is the row of the face's image in the image table
+enum FaceColumn { FACE_IMAGE, FACE_X, FACE_Y, FACE_WIDTH, FACE_HEIGHT, FACE_LEFT_X, FACE_EYE_TOP_Y, FACE_RIGHT_X, FACE_EYE_BOTTOM_NOSE_MOUTH_TOP_Y, FACE_NOSE_MOUTH_BOTTOM_Y,
+	FACE_EYES_DETECTED, FACE_EYE_SKIN, FACE_NOSE_MOUTH_SKIN, FACE_SKIN_RATIO, FACE_DECISION, FACE_SKIP_REASON };
+const vector<ColumnSpec> FACE_COLUMNS = {
+	{"image", ColumnType::UINT64}, {"x", ColumnType::INT32}, {"y", ColumnType::INT32}, {"width", ColumnType::INT32}, {"height", ColumnType::INT32},
+	{"left_x", ColumnType::INT32}, {"eye_top_y", ColumnType::INT32}, {"right_x", ColumnType::INT32}, {"eye_bottom_nose_mouth_top_y", ColumnType::INT32}, {"nose_mouth_bottom_y", ColumnType::INT32},
+	{"eyes_detected", ColumnType::UINT8}, {"eye_skin", ColumnType::INT32}, {"nose_mouth_skin", ColumnType::INT32}, {"skin_ratio", ColumnType::FLOAT32},
+	{"decision", ColumnType::UINT8}, {"skip_reason", ColumnType::UINT8}
+};
+
+// Writes the results of a run into an image table (PATH.images) and a face table (PATH.faces)
+class ResultsWriter {
+public:
+	explicit ResultsWriter(const string& PATH) : images(PATH + ".images", IMAGE_COLUMNS), faces(PATH + ".faces", FACE_COLUMNS) {}
+
+	// Appends the results of an image
+	// Parameters:
+	//          ENTRY:     The image along with its ground truth
+	//          RESULT:    Results of the image
+	//          LOAD_MS:   Time spent reading, decoding, and pre-processing the image
+	//          DETECT_MS: Time spent detecting the faces and masks
+	// Pre-condition:  N/A
+	// Post-condition: A row is added to the image table and one per detected face to the face table
+	void add(const ImageEntry& ENTRY, const ImageResult& RESULT, const float LOAD_MS, const float DETECT_MS) {
+		const uint64_t IMAGE_ROW = images.rowCount();
+		images.setText(IMAGE_PATH, ENTRY.path);
+		images.set<int32_t>(IMAGE_ID, ENTRY.image_id);
+		images.set<uint8_t>(IMAGE_WITH_MASK, ENTRY.with_mask);
+		images.set<int32_t>(IMAGE_GROUND_TRUTH, ENTRY.faces);
+		images.set<int32_t>(IMAGE_FACES_SKIPPED, RESULT.counts.faces_skipped);
+		images.set<int32_t>(IMAGE_EYES_SKIPPED, RESULT.counts.eyes_skipped);
+		images.set<int32_t>(IMAGE_MASKED, RESULT.counts.masked);
+		images.set<int32_t>(IMAGE_NOT_MASKED, RESULT.counts.not_masked);
+		images.set<uint64_t>(IMAGE_FIRST_FACE, faces.rowCount());
+		images.set<int32_t>(IMAGE_FACE_COUNT, int32_t(RESULT.faces.size()));
+		images.set<float>(IMAGE_LOAD_MS, LOAD_MS);
+		images.set<float>(IMAGE_DETECT_MS, DETECT_MS);
+		images.set<uint8_t>(IMAGE_DEGRADED, RESULT.degraded);
+		images.set<uint8_t>(IMAGE_REUSED, RESULT.reused);
+		images.endRow();
+
+		for (auto &face: RESULT.faces) {
+			faces.set<uint64_t>(FACE_IMAGE, IMAGE_ROW);
+			faces.set<int32_t>(FACE_X, face.face.x);
+			faces.set<int32_t>(FACE_Y, face.face.y);
+			faces.set<int32_t>(FACE_WIDTH, face.face.width);
+			faces.set<int32_t>(FACE_HEIGHT, face.face.height);
+			faces.set<int32_t>(FACE_LEFT_X, face.region.left_x);
+			faces.set<int32_t>(FACE_EYE_TOP_Y, face.region.eye_top_y);
+			faces.set<int32_t>(FACE_RIGHT_X, face.region.right_x);
+			faces.set<int32_t>(FACE_EYE_BOTTOM_NOSE_MOUTH_TOP_Y, face.region.eye_bottom_nose_mouth_top_y);
+			faces.set<int32_t>(FACE_NOSE_MOUTH_BOTTOM_Y, face.region.nose_mouth_bottom_y);
+			faces.set<uint8_t>(FACE_EYES_DETECTED, face.region.eyes_detected);
+			faces.set<int32_t>(FACE_EYE_SKIN, face.eye_skin);
+			faces.set<int32_t>(FACE_NOSE_MOUTH_SKIN, face.nose_mouth_skin);
+			faces.set<float>(FACE_SKIN_RATIO, face.skin_ratio);
+			faces.set<uint8_t>(FACE_DECISION, uint8_t(face.decision));
+			faces.set<uint8_t>(FACE_SKIP_REASON, uint8_t(face.skip_reason));
+			faces.endRow();
+		}
+	}
+
+	// Completes both tables; returns false if either could not be written
+	bool finish() {
+		const bool IMAGES_WRITTEN = images.finish();
+		return faces.finish() && IMAGES_WRITTEN;
+	}
+
+private:
+	ColumnarWriter images, faces;
+};
+
+// Writes the header of the per image csv file
+// Parameters:
+//          csv:         Stream receiving the header
+//          WITH_REUSED: Whether the rows end with the Reused column, only written by runs reusing near-duplicate results
+// Pre-condition:  N/A
+// Post-condition: The header is appended to the stream
+void writeCsvHeader(ostream& csv, const bool WITH_REUSED) {
+	csv << "File Type,Image ID,Ground Truth,Skipped Faces (Face issue),Skipped Faces (Eye issue),Masked Faces,Non-masked Faces" << (WITH_REUSED ? ",Reused" : "") << "\n";
+}
+
+// Writes the csv row of an image
+// Parameters:
+//          csv:         Stream receiving the row
+//          WITH_MASK:   Whether the faces in the image wear masks
+//          IMAGE_ID:    Number identifying the image within its class
+//          FACES:       Number of faces in the image
+//          COUNTS:      Tallies of the image
+//          WITH_REUSED: Whether the row ends with the Reused column
+//          REUSED:      Whether the faces were copied from a near-duplicate image instead of being detected
+// Pre-condition:  N/A
+// Post-condition: The row is appended to the stream
+void writeCsvRow(ostream& csv, const bool WITH_MASK, const int IMAGE_ID, const int FACES, const DetectionCounts& COUNTS, const bool WITH_REUSED, const bool REUSED) {
+	// The face issue column of masked images has always been reported multiplied by the number of faces
+	csv << (WITH_MASK ? "With Mask" : "Without Mask") << "," << IMAGE_ID << "," << FACES << "," << (WITH_MASK ? COUNTS.faces_skipped * FACES : COUNTS.faces_skipped) << "," << COUNTS.eyes_skipped << "," << COUNTS.masked << "," << COUNTS.not_masked;
+	if (WITH_REUSED) {
+		csv << "," << (REUSED ? 1 : 0);
+	}
+	csv << "\n";
+}
+
+// Converts the image table of a results file into the per image csv layout
+// Parameters:
+//          RESULTS_PATH: Location the results were written to (without the .images suffix)
+//          CSV_PATH:     Location of the csv file
+//          WITH_REUSED:  Whether the csv file gets the Reused column, as the csv file of a run reusing near-duplicate results does
+// Pre-condition:  N/A
+// Post-condition: Returns false if the results cannot be read or the csv file cannot be written
+bool exportCsv(const string& RESULTS_PATH, const string& CSV_PATH, const bool WITH_REUSED) {
+	ColumnarReader images;
+	if (!images.open(RESULTS_PATH + ".images")) {
+		logger().log(LogLevel::ERROR, "invalid_results", RESULTS_PATH + ".images");
+		return false;
+	}
+	const int ID_COLUMN = images.column("image_id", ColumnType::INT32);
+	const int WITH_MASK_COLUMN = images.column("with_mask", ColumnType::UINT8);
+	const int GROUND_TRUTH_COLUMN = images.column("ground_truth", ColumnType::INT32);
+	const int FACES_SKIPPED_COLUMN = images.column("faces_skipped", ColumnType::INT32);
+	const int EYES_SKIPPED_COLUMN = images.column("eyes_skipped", ColumnType::INT32);
+	const int MASKED_COLUMN = images.column("masked", ColumnType::INT32);
+	const int NOT_MASKED_COLUMN = images.column("not_masked", ColumnType::INT32);
+	const int REUSED_COLUMN = images.column("reused", ColumnType::UINT8);
+	if (min({ID_COLUMN, WITH_MASK_COLUMN, GROUND_TRUTH_COLUMN, FACES_SKIPPED_COLUMN, EYES_SKIPPED_COLUMN, MASKED_COLUMN, NOT_MASKED_COLUMN, REUSED_COLUMN}) < 0) {
+		logger().log(LogLevel::ERROR, "invalid_results", RESULTS_PATH + ".images");
+		return false;
+	}
+	ofstream csv(CSV_PATH, ofstream::trunc);
+	writeCsvHeader(csv, WITH_REUSED);
+	for (size_t block = 0; block < images.blockCount(); block++) {
+		const int32_t* IDS = images.values<int32_t>(block, ID_COLUMN);
+		const uint8_t* WITH_MASK = images.values<uint8_t>(block, WITH_MASK_COLUMN);
+		const int32_t* GROUND_TRUTH = images.values<int32_t>(block, GROUND_TRUTH_COLUMN);
+		const int32_t* FACES_SKIPPED = images.values<int32_t>(block, FACES_SKIPPED_COLUMN);
+		const int32_t* EYES_SKIPPED = images.values<int32_t>(block, EYES_SKIPPED_COLUMN);
+		const int32_t* MASKED = images.values<int32_t>(block, MASKED_COLUMN);
+		const int32_t* NOT_MASKED = images.values<int32_t>(block, NOT_MASKED_COLUMN);
+		const uint8_t* REUSED = images.values<uint8_t>(block, REUSED_COLUMN);
+		for (uint64_t row = 0; row < images.blockRows(block); row++) {
+			DetectionCounts counts;
+			counts.faces_skipped = FACES_SKIPPED[row];
+			counts.eyes_skipped = EYES_SKIPPED[row];
+			counts.masked = MASKED[row];
+			counts.not_masked = NOT_MASKED[row];
+			writeCsvRow(csv, WITH_MASK[row] != 0, IDS[row], GROUND_TRUTH[row], counts, WITH_REUSED, REUSED[row] != 0);
+		}
+	}
+	csv.close();
+	return !csv.fail();
+}
+
+#endif //MAIN_RESULTSTORE_H
@@ -0,0 +1,190 @@
+// sampling.h
+// Description: A stratified random sample of the dataset that grows until the masked face rate is known to a requested confidence interval,
+//              using the combined ratio estimator over the strata
+// Assumptions: The images of the dataset can all be listed up front (listing is cheap next to the detection), and images are read from their paths
+
+#ifndef MAIN_SAMPLING_H
+#define MAIN_SAMPLING_H
+
+// Import the necessary libraries for random numbers and i/o
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+#include "headers/config.h"
+#include "headers/imagesource.h"
+#include "headers/results.h"
+
+// Declaring the namespaces that would be used throughout the program
+using namespace std;
+
+// Images sampled before the interval is checked for the first time, so the variance estimates are not made from a handful of images
+const int SAMPLE_MIN_IMAGES = 30;
+
+// Returns the two-sided standard normal quantile of a confidence level, e.g. 1.96 for 0.95
+double normalQuantile(const double CONFIDENCE) {
+	const double TARGET = 1 - (1 - CONFIDENCE) / 2;
+	double low = 0, high = 10;
+	// Bisecting the normal cumulative distribution function
+	for (int i = 0; i < 100; i++) {
+		const double MIDDLE = (low + high) / 2;
+		(0.5 * erfc(-MIDDLE / sqrt(2.0)) < TARGET ? low : high) = MIDDLE;
+	}
+	return (low + high) / 2;
+}
+
+// An estimate of the masked face rate along with its confidence interval
+//          rate:       Masked faces over the faces with a decision
+//          half_width: Half the width of the interval around the rate
+struct RateEstimate {
+	double rate = 0;
+	double half_width = 0;
+};
+
+// Produces the images of a stratified random sample of the dataset, one stratum at a time in proportion to its size,
+// until the confidence interval of the masked face rate is narrow enough or every image was produced
+class StratifiedSampler : public ImageSource {
+public:
+	// Parameters:
+	//          images: Source of every image of the dataset; it is read to the end up front
+	//          CONFIG: Run-time options holding the strata, the target half width, the confidence, and the seed
+	StratifiedSampler(ImageSource& images, const Config& CONFIG) : target(CONFIG.SAMPLE_CI / 100), z(normalQuantile(CONFIG.SAMPLE_CONFIDENCE)) {
+		map<string, size_t> indices;
+		ImageEntry entry;
+		while (images.next(entry)) {
+			// The bytes of an entry do not outlive the next one, so the sampled images are read from their paths
+			entry.bytes = {};
+			const string NAME = CONFIG.SAMPLE_STRATA == SampleStrata::LABEL ? (entry.with_mask ? "with_mask" : "without_mask") : filesystem::path(entry.path).parent_path().string();
+			const auto INSERTED = indices.emplace(NAME, strata.size());
+			if (INSERTED.second) {
+				strata.emplace_back();
+				strata.back().name = NAME;
+			}
+			strata[INSERTED.first->second].entries.push_back(entry);
+			population += 1;
+		}
+		// Shuffling every stratum once, so taking its images in order samples it without replacement
+		mt19937_64 random(uint64_t(CONFIG.SAMPLE_SEED));
+		for (auto &stratum: strata) {
+			shuffle(stratum.entries.begin(), stratum.entries.end(), random);
+		}
+	}
+
+	bool next(ImageEntry& entry) override {
+		if (sampled >= SAMPLE_MIN_IMAGES && estimate().half_width <= target) {
+			return false;
+		}
+		// Taking the next image from the stratum furthest behind its share of the sample
+		Stratum* behind = nullptr;
+		for (auto &stratum: strata) {
+			if (stratum.taken < stratum.entries.size() && (behind == nullptr || double(stratum.taken + 1) / stratum.entries.size() < double(behind->taken + 1) / behind->entries.size())) {
+				behind = &stratum;
+			}
+		}
+		if (behind == nullptr) {
+			return false;
+		}
+		entry = behind->entries[behind->taken];
+		behind->taken += 1;
+		current = behind;
+		return true;
+	}
+
+	// Adds the outcome of the last image produced to its stratum; images that were not processed are simply never recorded
+	void record(const DetectionCounts& COUNTS) {
+		if (current == nullptr) {
+			return;
+		}
+		const double MASKED = COUNTS.masked, DECIDED = COUNTS.masked + COUNTS.not_masked;
+		current->n += 1;
+		current->masked += MASKED;
+		current->decided += DECIDED;
+		current->masked_squares += MASKED * MASKED;
+		current->decided_squares += DECIDED * DECIDED;
+		current->products += MASKED * DECIDED;
+		current = nullptr;
+		sampled += 1;
+	}
+
+	// Returns the combined ratio estimate of the masked face rate over every stratum and its interval
+	RateEstimate estimate() const {
+		RateEstimate result;
+		double masked = 0, decided = 0;
+		for (auto &stratum: strata) {
+			if (stratum.n > 0) {
+				masked += double(stratum.entries.size()) * stratum.masked / stratum.n;
+				decided += double(stratum.entries.size()) * stratum.decided / stratum.n;
+			}
+		}
+		if (decided == 0) {
+			result.half_width = INFINITY;
+			return result;
+		}
+		result.rate = masked / decided;
+		double variance = 0;
+		for (auto &stratum: strata) {
+			const double N = double(stratum.entries.size());
+			if (stratum.n == N) {
+				continue;
+			}
+			// A stratum with fewer than 2 images has no variance estimate yet, so the interval stays open
+			if (stratum.n < 2) {
+				result.half_width = INFINITY;
+				return result;
+			}
+			variance += N * N * (1 - stratum.n / N) * stratum.residualVariance(result.rate) / stratum.n;
+		}
+		result.half_width = z * sqrt(variance) / decided;
+		return result;
+	}
+
+	// Displays the masked face rate within every stratum, along with its sample and population sizes
+	void printStrata() const {
+		cout << left << setw(40) << "Stratum" << right << setw(10) << "Sampled" << setw(10) << "Images" << setw(14) << "Masked faces" << endl;
+		for (auto &stratum: strata) {
+			cout << left << setw(40) << stratum.name << right << setw(10) << stratum.n << setw(10) << stratum.entries.size() << fixed << setprecision(1);
+			if (stratum.decided > 0) {
+				cout << setw(13) << 100 * stratum.masked / stratum.decided << "%" << endl;
+			}
+			else {
+				cout << setw(14) << "-" << endl;
+			}
+			cout.unsetf(ios::fixed);
+			cout << setprecision(6);
+		}
+	}
+
+	long long sampledCount() const { return sampled; }
+
+	long long populationCount() const { return population; }
+
+private:
+	// The images of a stratum and the sums over its sampled images of the masked faces (m), the faces with a decision (f), and their squares and products
+	struct Stratum {
+		string name;
+		vector<ImageEntry> entries;
+		size_t taken = 0;
+		double n = 0;
+		double masked = 0, decided = 0, masked_squares = 0, decided_squares = 0, products = 0;
+
+		// Sample variance of the residuals m - RATE * f
+		double residualVariance(const double RATE) const {
+			const double SUM = masked - RATE * decided;
+			const double SQUARES = masked_squares - 2 * RATE * products + RATE * RATE * decided_squares;
+			return max(0.0, (SQUARES - SUM * SUM / n) / (n - 1));
+		}
+	};
+
+	const double target;
+	const double z;
+	vector<Stratum> strata;
+	Stratum* current = nullptr;
+	long long sampled = 0, population = 0;
+};
+
+#endif //MAIN_SAMPLING_H
@@ -0,0 +1,195 @@
+// scanner.h
+// Description: A parallel directory walker that streams the test images to the mask detection run while it is still enumerating the dataset
+// Assumptions: The order of the images does not matter; memory stays flat because the walkers wait whenever the run falls behind
+
+#ifndef MAIN_SCANNER_H
+#define MAIN_SCANNER_H
+
+// Import the necessary libraries for directory access and threading
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <filesystem>
+#endif
+#include "headers/concurrency.h"
+#include "headers/imagesource.h"
+#include "headers/logger.h"
+
+// Declaring the namespaces that would be used throughout the program
+using namespace std;
+
+// Number of directories walked at the same time
+const int SCANNER_THREADS = 4;
+// Number of images found but not yet taken by the run
+const size_t SCANNER_QUEUE_SIZE = 1024;
+// Bytes of directory entries fetched per getdents64 call
+const size_t SCANNER_BUFFER_SIZE = 64 * 1024;
+
+// Lists a single directory, handing its regular files to a callback and collecting its subdirectories
+// Parameters:
+//          DIRECTORY:      Directory to list
+//          subdirectories: Receives the paths of the subdirectories (links to directories are not followed)
+//          ON_FILE:        Called with the name of every regular file; returning false stops the listing
+// Pre-condition:  N/A
+// Post-condition: Returns false if the callback stopped the listing; an unreadable directory is logged and treated as empty
+template <typename OnFile>
+bool readDirectory(const string& DIRECTORY, vector<string>& subdirectories, const OnFile& ON_FILE) {
+#ifdef __linux__
+	// Reading the raw directory entries in large batches, which also gives the entry types without a stat per file
+	const int FD = open(DIRECTORY.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+	if (FD < 0) {
+		logger().log(LogLevel::WARNING, "directory_unreadable", DIRECTORY);
+		return true;
+	}
+	vector<char> buffer(SCANNER_BUFFER_SIZE);
+	bool running = true;
+	long bytes;
+	while (running && (bytes = syscall(SYS_getdents64, FD, buffer.data(), buffer.size())) > 0) {
+		for (long offset = 0; running && offset < bytes;) {
+			const auto* RECORD = reinterpret_cast<const struct dirent64*>(buffer.data() + offset);
+			offset += RECORD->d_reclen;
+			const string_view NAME = RECORD->d_name;
+			if (NAME == "." || NAME == "..") {
+				continue;
+			}
+			unsigned char type = RECORD->d_type;
+			// Some file systems do not report the type, and links are followed to files but not to directories
+			if (type == DT_UNKNOWN || type == DT_LNK) {
+				struct stat status;
+				const int FLAGS = type == DT_LNK ? 0 : AT_SYMLINK_NOFOLLOW;
+				if (fstatat(FD, RECORD->d_name, &status, FLAGS) != 0) {
+					continue;
+				}
+				type = S_ISREG(status.st_mode) ? DT_REG : S_ISDIR(status.st_mode) && type == DT_UNKNOWN ? DT_DIR : DT_UNKNOWN;
+			}
+			if (type == DT_DIR) {
+				subdirectories.push_back(DIRECTORY + "/" + string(NAME));
+			}
+			else if (type == DT_REG) {
+				running = ON_FILE(NAME);
+			}
+		}
+	}
+	close(FD);
+	return running;
+#else
+	error_code error;
+	for (const auto& entry: filesystem::directory_iterator(DIRECTORY, error)) {
+		if (entry.is_directory() && !entry.is_symlink()) {
+			subdirectories.push_back(entry.path().string());
+		}
+		else if (entry.is_regular_file() && !ON_FILE(entry.path().filename().string())) {
+			return false;
+		}
+	}
+	if (error) {
+		logger().log(LogLevel::WARNING, "directory_unreadable", DIRECTORY);
+	}
+	return true;
+#endif
+}
+
+// Walks a directory tree with a pool of threads, one directory at a time per thread, and produces the jpg images it finds
+class DirectoryScanner : public ImageSource {
+public:
+	// Parameters:
+	//          ROOT:    Directory to walk recursively
+	//          THREADS: Number of walker threads
+	explicit DirectoryScanner(const string& ROOT, const int THREADS = SCANNER_THREADS) : entries(SCANNER_QUEUE_SIZE) {
+		pending.push_back(ROOT);
+		for (int i = 0; i < max(1, THREADS); i++) {
+			walkers.emplace_back([this] { walkLoop(); });
+		}
+	}
+
+	// Stops the walkers even if the tree was not fully enumerated
+	~DirectoryScanner() override {
+		{
+			lock_guard<mutex> lock(pending_mutex);
+			stopped = true;
+		}
+		pending_changed.notify_all();
+		entries.close();
+		for (auto &walker: walkers) {
+			walker.join();
+		}
+	}
+
+	bool next(ImageEntry& entry) override { return entries.pop(entry); }
+
+private:
+	// Takes directories off the shared stack until the tree is exhausted or the scanner is stopped
+	void walkLoop() {
+		while (true) {
+			string directory;
+			{
+				unique_lock<mutex> lock(pending_mutex);
+				pending_changed.wait(lock, [this] { return stopped || !pending.empty() || active == 0; });
+				// Nothing left to walk and nobody walking who could add more
+				if (stopped || pending.empty()) {
+					break;
+				}
+				directory = move(pending.back());
+				pending.pop_back();
+				active += 1;
+			}
+
+			vector<string> subdirectories;
+			const bool CONTINUE = walkDirectory(directory, subdirectories);
+			{
+				lock_guard<mutex> lock(pending_mutex);
+				for (auto &subdirectory: subdirectories) {
+					pending.push_back(move(subdirectory));
+				}
+				active -= 1;
+				if (!CONTINUE) {
+					stopped = true;
+				}
+				if (stopped || (pending.empty() && active == 0)) {
+					entries.close();
+				}
+			}
+			pending_changed.notify_all();
+		}
+	}
+
+	// Produces the images of a directory and collects its subdirectories
+	// Returns false if the run stopped taking images
+	bool walkDirectory(const string& DIRECTORY, vector<string>& subdirectories) {
+		return readDirectory(DIRECTORY, subdirectories, [&](const string_view NAME) { return produce(DIRECTORY, NAME); });
+	}
+
+	// Parses an image file name and hands the image to the run, waiting while the run is behind
+	// Returns false if the run stopped taking images
+	bool produce(const string& DIRECTORY, const string_view NAME) {
+		if (!isImageFile(NAME)) {
+			return true;
+		}
+		ImageEntry entry;
+		entry.path = DIRECTORY + "/" + string(NAME);
+		if (!parseImageName(NAME, entry)) {
+			logger().log(LogLevel::WARNING, "unparsed_file_name", entry.path);
+			return true;
+		}
+		return entries.push(move(entry));
+	}
+
+	BoundedQueue<ImageEntry> entries;
+	mutex pending_mutex;
+	condition_variable pending_changed;
+	vector<string> pending;
+	int active = 0;
+	bool stopped = false;
+	vector<thread> walkers;
+};
+
+#endif //MAIN_SCANNER_H
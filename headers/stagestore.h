@@ -0,0 +1,233 @@
+// stagestore.h
+// Description: Persistent stores of the intermediate results of the detection stages (face boxes, eye and oronasal regions, and skin pixel counts),
+//              so a run with a changed stage only recomputes that stage and the stages after it
+// Assumptions: The key of a stage chains the key of the stage before it with the parameters and the STAGE_VERSION of the stage itself;
+//              a version must be bumped whenever the code of its stage changes the results
+
+#ifndef MAIN_STAGESTORE_H
+#define MAIN_STAGESTORE_H
+
+// Import the necessary libraries for i/o and file mapping
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "headers/config.h"
+#include "headers/hash.h"
+#include "headers/logger.h"
+#include "headers/mappedfile.h"
+#include "headers/results.h"
+
+// Declaring the namespaces that would be used throughout the program
+using namespace std;
+
+// The stages with a store; the pre-processed images are kept by the pixel cache and the decisions are cheap enough to always recompute
+enum Stage { FACE_STAGE, EYE_STAGE, SKIN_STAGE, STAGE_COUNT };
+
+// Versions of the code of every stage, part of the keys of the stage and of the stages after it
+const uint32_t FACE_STAGE_VERSION = 1;
+const uint32_t EYE_STAGE_VERSION = 1;
+const uint32_t SKIN_STAGE_VERSION = 1;
+
+// Record preceding every value in a store file
+//          key:   Key of the value
+//          size:  Bytes of the value following the record
+//          magic: STAGE_RECORD_MAGIC, to tell a record apart from a torn write at the end of the file
+struct StageRecord {
+	uint64_t key;
+	uint32_t size;
+	uint32_t magic;
+};
+
+const uint32_t STAGE_RECORD_MAGIC = 0x47545353;  // "SSTG"
+
+// Values of the stages, one per face
+struct StoredBox {
+	int32_t x, y, width, height;
+};
+
+struct StoredRegion {
+	int32_t left_x, eye_top_y, right_x, eye_bottom_nose_mouth_top_y, nose_mouth_bottom_y;
+	uint8_t eyes_detected;
+	uint8_t padding[3];
+};
+
+struct StoredSkin {
+	int32_t eye_skin, nose_mouth_skin;
+};
+
+// The values are copied out of the files byte for byte, so their layout must not depend on the compiler's padding
+static_assert(sizeof(StageRecord) == 16 && sizeof(StoredBox) == 16 && sizeof(StoredRegion) == 24 && sizeof(StoredSkin) == 8, "Unexpected stage record layout");
+
+// Keys of the stages of an image
+struct StageKeys {
+	uint64_t keys[STAGE_COUNT];
+};
+
+// Keeps one append-only file per stage in a directory; values stored during the run are appended to the files, and the last value of a key wins
+class StageStore {
+public:
+	// Parameters:
+	//          DIRECTORY:          Directory holding the store files (created if missing)
+	//          FACE_CASCADE_FILES: Cascade files used by the face stage
+	//          EYE_CASCADE_FILES:  Cascade files used by the eye stage
+	StageStore(const string& DIRECTORY, const vector<string>& FACE_CASCADE_FILES, const vector<string>& EYE_CASCADE_FILES) {
+		filesystem::create_directories(DIRECTORY);
+		face_cascades_hash = hashFiles(FACE_CASCADE_FILES);
+		eye_cascades_hash = hashFiles(EYE_CASCADE_FILES);
+		const char* NAMES[STAGE_COUNT] = {"faces.stage", "eyes.stage", "skin.stage"};
+		for (int stage = 0; stage < STAGE_COUNT; stage++) {
+			const string PATH = (filesystem::path(DIRECTORY) / NAMES[stage]).string();
+			const uint64_t VALID_SIZE = load(PATH, values[stage]);
+			// Dropping a torn record left by an interrupted run before appending to the file
+			error_code error;
+			if (filesystem::exists(PATH, error) && filesystem::file_size(PATH, error) != VALID_SIZE) {
+				filesystem::resize_file(PATH, VALID_SIZE, error);
+			}
+			files[stage] = fopen(PATH.c_str(), "ab");
+			if (files[stage] == nullptr) {
+				logger().log(LogLevel::ERROR, "stage_store_unwritable", PATH);
+				exit(0);
+			}
+		}
+	}
+
+	StageStore(const StageStore&) = delete;
+	StageStore& operator=(const StageStore&) = delete;
+
+	~StageStore() {
+		for (FILE* file: files) {
+			if (file != nullptr) {
+				fclose(file);
+			}
+		}
+	}
+
+	// Derives the keys of every stage of an image
+	// Parameters:
+	//          BYTES:  The encoded image
+	//          CONFIG: Run-time options holding the parameters of the stages
+	// Pre-condition:  N/A
+	// Post-condition: Returns the keys; a stage's key changes with its own parameters and with those of every stage before it
+	StageKeys keys(const string_view BYTES, const Config& CONFIG) const {
+		string params;
+		const auto APPEND = [&params](const auto& VALUE) { params.append(reinterpret_cast<const char*>(&VALUE), sizeof(VALUE)); };
+		StageKeys stage_keys{};
+
+		APPEND(FACE_STAGE_VERSION);
+		APPEND(face_cascades_hash);
+		APPEND(CONFIG.DECODE_SCALE);
+		APPEND(CONFIG.FACE_CASCADES);
+		APPEND(CONFIG.PRE_PROCESSING.BLUR_WIDTH);
+		APPEND(CONFIG.PRE_PROCESSING.BLUR_HEIGHT);
+		APPEND(CONFIG.PRE_PROCESSING.BLUR_SIGMA_X);
+		APPEND(CONFIG.PRE_PROCESSING.BLUR_SIGMA_Y);
+		APPEND(CONFIG.FACE_DETECTION.SCALE_FACTOR);
+		APPEND(CONFIG.FACE_DETECTION.MIN_NEIGHBORS);
+		APPEND(CONFIG.FACE_DETECTION.MIN_FACE);
+		APPEND(CONFIG.FACE_DETECTION.MAX_FACE);
+		stage_keys.keys[FACE_STAGE] = hashBytes(params, hashBytes(BYTES));
+
+		params.clear();
+		APPEND(EYE_STAGE_VERSION);
+		APPEND(eye_cascades_hash);
+		APPEND(CONFIG.EYE_SEARCH);
+		APPEND(CONFIG.CANONICAL_FACE_SIZE);
+		stage_keys.keys[EYE_STAGE] = hashBytes(params, stage_keys.keys[FACE_STAGE]);
+
+		params.clear();
+		APPEND(SKIN_STAGE_VERSION);
+		stage_keys.keys[SKIN_STAGE] = hashBytes(params, stage_keys.keys[EYE_STAGE]);
+		return stage_keys;
+	}
+
+	// Looks a value of a stage up
+	// Parameters:
+	//          STAGE: The stage
+	//          KEY:   Key of the value within the stage
+	//          value: Receives the value on a hit
+	// Pre-condition:  T is the value type of the stage
+	// Post-condition: Returns true on a hit
+	template <typename T>
+	bool get(const Stage STAGE, const uint64_t KEY, vector<T>& value) {
+		const auto FOUND = values[STAGE].find(KEY);
+		if (FOUND == values[STAGE].end() || FOUND->second.size() % sizeof(T) != 0) {
+			misses[STAGE] += 1;
+			return false;
+		}
+		value.resize(FOUND->second.size() / sizeof(T));
+		if (!value.empty()) {
+			memcpy(value.data(), FOUND->second.data(), FOUND->second.size());
+		}
+		hits[STAGE] += 1;
+		return true;
+	}
+
+	// Stores a value of a stage and appends it to the stage's file
+	template <typename T>
+	void put(const Stage STAGE, const uint64_t KEY, const vector<T>& VALUE) {
+		string& stored = values[STAGE][KEY];
+		stored.assign(reinterpret_cast<const char*>(VALUE.data()), VALUE.size() * sizeof(T));
+		const StageRecord RECORD{KEY, uint32_t(stored.size()), STAGE_RECORD_MAGIC};
+		fwrite(&RECORD, sizeof(RECORD), 1, files[STAGE]);
+		fwrite(stored.data(), 1, stored.size(), files[STAGE]);
+	}
+
+	// Returns true if every stage of an image is stored, in which case the image does not need to be decoded
+	bool complete(const StageKeys& KEYS) const {
+		const auto FACES = values[FACE_STAGE].find(KEYS.keys[FACE_STAGE]);
+		if (FACES == values[FACE_STAGE].end()) {
+			return false;
+		}
+		// An image without faces has nothing after its face stage
+		return FACES->second.empty() || (values[EYE_STAGE].count(KEYS.keys[EYE_STAGE]) != 0 && values[SKIN_STAGE].count(KEYS.keys[SKIN_STAGE]) != 0);
+	}
+
+	long long hitCount(const Stage STAGE) const { return hits[STAGE]; }
+
+	long long missCount(const Stage STAGE) const { return misses[STAGE]; }
+
+private:
+	static uint64_t hashFiles(const vector<string>& FILES) {
+		uint64_t hash = 0;
+		string contents;
+		for (auto &file: FILES) {
+			ifstream input(file, ifstream::binary);
+			contents.assign(istreambuf_iterator<char>(input), istreambuf_iterator<char>());
+			hash = hashBytes(contents, hash);
+		}
+		return hash;
+	}
+
+	// Reads every complete record of a store file and returns the size they take up
+	static uint64_t load(const string& PATH, unordered_map<uint64_t, string>& stored) {
+		MappedFile file;
+		if (!file.open(PATH)) {
+			return 0;
+		}
+		uint64_t offset = 0;
+		while (offset + sizeof(StageRecord) <= file.size()) {
+			StageRecord record;
+			memcpy(&record, file.data() + offset, sizeof(record));
+			if (record.magic != STAGE_RECORD_MAGIC || offset + sizeof(StageRecord) + record.size > file.size()) {
+				break;
+			}
+			stored[record.key].assign(file.data() + offset + sizeof(StageRecord), record.size);
+			offset += sizeof(StageRecord) + record.size;
+		}
+		return offset;
+	}
+
+	uint64_t face_cascades_hash = 0, eye_cascades_hash = 0;
+	unordered_map<uint64_t, string> values[STAGE_COUNT];
+	FILE* files[STAGE_COUNT] = {};
+	long long hits[STAGE_COUNT] = {}, misses[STAGE_COUNT] = {};
+};
+
+#endif //MAIN_STAGESTORE_H
@@ -0,0 +1,261 @@
+// tuner.h
+// Description: Searches the face detection and blur parameters over a labeled sample of the dataset, measuring the throughput and accuracy of every candidate,
+//              and reports the candidates no other candidate beats on both (the Pareto frontier)
+// Assumptions: The candidates run side by side on separate threads, so their throughput is measured under the same load and only compares them with each other
+
+#ifndef MAIN_TUNER_H
+#define MAIN_TUNER_H
+
+// Import the necessary libraries for opencv, threading, and i/o
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include <opencv2/core.hpp>
+#include <opencv2/objdetect.hpp>
+#include "headers/config.h"
+#include "headers/evaluation.h"
+#include "headers/helper.h"
+#include "headers/imagesource.h"
+#include "headers/logger.h"
+#include "headers/maskdetection.h"
+#include "headers/preprocessing.h"
+
+// Declaring the namespaces that would be used throughout the program
+// We can use 2 namespaces as long as there aren't any conflicts
+using namespace std;
+using namespace cv;
+
+// Values searched for every tuned parameter; the candidates are every combination of them
+const double TUNE_SCALE_FACTORS[] = {1.05, 1.1, 1.2, 1.3};
+const int TUNE_MIN_NEIGHBORS[] = {2, 3, 5};
+const int TUNE_MIN_FACES[] = {0, 40};
+const int TUNE_MAX_FACES[] = {0, 300};
+const int TUNE_BLUR_SIZES[] = {3, 5, 7};
+
+// A decoded image of the tuning sample along with its ground truth
+struct TuningImage {
+	bool with_mask = false;
+	int faces = 0;
+	Mat image;
+};
+
+// A setting of the tuned parameters along with its measurements
+//          images_per_second: Images processed per second by one thread, pre-processing included
+//          accuracy:          Correct decisions over the faces of the sample (or over the decisions, if more faces were detected than there are)
+struct TuningCandidate {
+	PreProcessingParams pre_processing;
+	FaceDetectionParams face_detection;
+	double images_per_second = 0;
+	double accuracy = 0;
+	ConfusionMatrix matrix;
+};
+
+// Draws the tuning sample from the dataset, half of it from each label
+// Parameters:
+//          images: Source of the images of the dataset
+//          COUNT:  Number of images to draw
+//          SCALE:  The images are decoded at 1/SCALE of their size
+// Pre-condition:  N/A
+// Post-condition: Returns up to COUNT decoded images, drawn uniformly within each label with a fixed seed so every tuning run measures the same images
+vector<TuningImage> sampleTuningImages(ImageSource& images, const int COUNT, const int SCALE) {
+	// Reservoir sampling, since the number of images is only known once the source is exhausted
+	const size_t PER_LABEL[2] = {size_t(COUNT / 2), size_t(COUNT - COUNT / 2)};
+	vector<TuningImage> reservoirs[2];
+	long long seen[2] = {0, 0};
+	mt19937_64 random(0);
+	ImageEntry entry;
+	while (images.next(entry)) {
+		const int LABEL = entry.with_mask ? 1 : 0;
+		seen[LABEL] += 1;
+		size_t slot = reservoirs[LABEL].size();
+		if (slot >= PER_LABEL[LABEL]) {
+			slot = size_t(uniform_int_distribution<long long>(0, seen[LABEL] - 1)(random));
+			if (slot >= PER_LABEL[LABEL]) {
+				continue;
+			}
+		}
+		TuningImage sampled;
+		sampled.with_mask = entry.with_mask;
+		sampled.faces = entry.faces;
+		sampled.image = entry.bytes.empty() ? readDisplay<false>(entry.path, "Image", SCALE) : decodeDisplay<false>(entry.bytes, entry.path, "Image", SCALE);
+		if (sampled.image.empty()) {
+			continue;
+		}
+		if (slot == reservoirs[LABEL].size()) {
+			reservoirs[LABEL].push_back(sampled);
+		}
+		else {
+			reservoirs[LABEL][slot] = sampled;
+		}
+	}
+	vector<TuningImage> sample = move(reservoirs[0]);
+	sample.insert(sample.end(), reservoirs[1].begin(), reservoirs[1].end());
+	return sample;
+}
+
+// Lists every combination of the searched values, keeping the remaining options of the run
+vector<TuningCandidate> tuningCandidates(const Config& CONFIG) {
+	vector<TuningCandidate> candidates;
+	for (const int BLUR_SIZE: TUNE_BLUR_SIZES) {
+		for (const double SCALE_FACTOR: TUNE_SCALE_FACTORS) {
+			for (const int MIN_NEIGHBORS: TUNE_MIN_NEIGHBORS) {
+				for (const int MIN_FACE: TUNE_MIN_FACES) {
+					for (const int MAX_FACE: TUNE_MAX_FACES) {
+						TuningCandidate candidate;
+						candidate.pre_processing = CONFIG.PRE_PROCESSING;
+						candidate.pre_processing.BLUR_WIDTH = candidate.pre_processing.BLUR_HEIGHT = BLUR_SIZE;
+						candidate.face_detection = FaceDetectionParams{SCALE_FACTOR, MIN_NEIGHBORS, MIN_FACE, MAX_FACE};
+						candidates.push_back(candidate);
+					}
+				}
+			}
+		}
+	}
+	return candidates;
+}
+
+// Runs the pre-processing and the mask detection of a candidate over the sample
+// Parameters:
+//          SAMPLE:              The tuning images
+//          CASCADES:            Face Haar, face LBP, left eye, right eye, and eyeglasses cascades, owned by the calling thread
+//          shared_eye_cascades: The eye cascades loaded to be scanned together, owned by the calling thread
+//          CONFIG:              Run-time options of the run
+//          candidate:           The candidate, receiving its throughput and accuracy
+// Pre-condition:  The cascades are loaded
+// Post-condition: The measurements of the candidate are set; no image is displayed, since several candidates run at once
+void measureCandidate(const vector<TuningImage>& SAMPLE, const vector<CascadeClassifier>& CASCADES, MultiCascade& shared_eye_cascades, const Config& CONFIG, TuningCandidate& candidate) {
+	Config config = CONFIG;
+	config.PRE_PROCESSING = candidate.pre_processing;
+	config.FACE_DETECTION = candidate.face_detection;
+	RunSummary summary;
+	DetectionBuffers detection_buffers;
+	const auto START = chrono::steady_clock::now();
+	for (auto &sampled: SAMPLE) {
+		const Mat PRE_PROCESSED_IMAGE = preProcessing<false>(sampled.image, config.PRE_PROCESSING);
+		const ImageResult RESULT = maskDetection<false>(sampled.image, PRE_PROCESSED_IMAGE, sampled.faces, CASCADES[0], CASCADES[1], CASCADES[2], CASCADES[3], CASCADES[4], shared_eye_cascades, config, nullptr, StageKeys{}, nullptr, detection_buffers);
+		(sampled.with_mask ? summary.masked_counts : summary.not_masked_counts) += RESULT.counts;
+		(sampled.with_mask ? summary.ground_truth_masks : summary.ground_truth_no_masks) += sampled.faces;
+	}
+	const double SECONDS = chrono::duration<double>(chrono::steady_clock::now() - START).count();
+	candidate.images_per_second = SECONDS > 0 ? SAMPLE.size() / SECONDS : 0;
+	candidate.matrix = summary.confusionMatrix();
+	// Faces that were never detected count as wrong, so missing faces cannot buy accuracy
+	const long long DECISIONS = candidate.matrix.true_positives + candidate.matrix.false_negatives + candidate.matrix.false_positives + candidate.matrix.true_negatives;
+	const long long FACES = max<long long>(summary.ground_truth_masks + summary.ground_truth_no_masks, DECISIONS);
+	candidate.accuracy = FACES == 0 ? 0 : double(candidate.matrix.true_positives + candidate.matrix.true_negatives) / FACES;
+}
+
+// Returns the candidates that no other candidate beats on both throughput and accuracy, from the fastest to the most accurate
+vector<TuningCandidate> paretoFrontier(vector<TuningCandidate> candidates) {
+	sort(candidates.begin(), candidates.end(), [](const TuningCandidate& A, const TuningCandidate& B) {
+		return A.images_per_second != B.images_per_second ? A.images_per_second > B.images_per_second : A.accuracy > B.accuracy;
+	});
+	vector<TuningCandidate> frontier;
+	for (auto &candidate: candidates) {
+		if (frontier.empty() || candidate.accuracy > frontier.back().accuracy) {
+			frontier.push_back(candidate);
+		}
+	}
+	return frontier;
+}
+
+// Writes the parameters of a candidate as a config file read back with --config
+// Parameters:
+//          PATH:      Location of the config file
+//          CANDIDATE: The chosen candidate
+//          IMAGES:    Number of images the candidate was measured on
+// Pre-condition:  N/A
+// Post-condition: Returns false if the file could not be written; the file is replaced as a whole, never left half written
+bool writeTunedConfig(const string& PATH, const TuningCandidate& CANDIDATE, const size_t IMAGES) {
+	const string TEMPORARY_PATH = PATH + ".tmp";
+	{
+		ofstream file(TEMPORARY_PATH, ofstream::trunc);
+		file << "# Chosen by --tune on " << IMAGES << " images: " << fixed << setprecision(1) << CANDIDATE.images_per_second << " images/sec per thread, "
+		     << 100 * CANDIDATE.accuracy << "% accuracy" << endl;
+		file << defaultfloat << setprecision(6);
+		file << "--blur " << CANDIDATE.pre_processing.BLUR_WIDTH << endl;
+		file << "--scale-factor " << CANDIDATE.face_detection.SCALE_FACTOR << endl;
+		file << "--min-neighbors " << CANDIDATE.face_detection.MIN_NEIGHBORS << endl;
+		file << "--min-face " << CANDIDATE.face_detection.MIN_FACE << endl;
+		file << "--max-face " << CANDIDATE.face_detection.MAX_FACE << endl;
+		if (!file.flush()) {
+			remove(TEMPORARY_PATH.c_str());
+			return false;
+		}
+	}
+	return rename(TEMPORARY_PATH.c_str(), PATH.c_str()) == 0;
+}
+
+// Searches the tuned parameters and writes the chosen ones to CONFIG.TUNE_PATH
+// Parameters:
+//          images:            Source of the images of the dataset
+//          CASCADE_FILENAMES: Face Haar, face LBP, left eye, right eye, and eyeglasses cascade files
+//          CONFIG:            Run-time options of the run, holding the sample size and the tolerance
+// Pre-condition:  N/A
+// Post-condition: The Pareto frontier is printed and the fastest candidate within the tolerance of the most accurate one is written; returns false if nothing could be measured or written
+bool tuneParameters(ImageSource& images, const vector<string>& CASCADE_FILENAMES, const Config& CONFIG) {
+	const vector<TuningImage> SAMPLE = sampleTuningImages(images, CONFIG.TUNE_IMAGES, CONFIG.DECODE_SCALE);
+	if (SAMPLE.empty()) {
+		logger().log(LogLevel::ERROR, "tune_no_images", CONFIG.DIRECTORY_PATH);
+		return false;
+	}
+	vector<TuningCandidate> candidates = tuningCandidates(CONFIG);
+	logger().log(LogLevel::INFO, "tune_candidates", CONFIG.TUNE_PATH, (long long)candidates.size(), true);
+
+	// Every thread loads its own cascades, since a classifier keeps scratch buffers while it scans
+	atomic<size_t> next_candidate(0);
+	const int THREADS = int(max(1u, thread::hardware_concurrency()));
+	vector<thread> workers;
+	for (int i = 0; i < THREADS; i++) {
+		workers.emplace_back([&] {
+			vector<CascadeClassifier> cascades;
+			for (auto &file: CASCADE_FILENAMES) {
+				cascades.push_back(loadCascade<false>(file));
+			}
+			MultiCascade shared_eye_cascades = loadMultiCascade<false>(vector<string>(CASCADE_FILENAMES.begin() + 2, CASCADE_FILENAMES.end()));
+			for (size_t index = next_candidate++; index < candidates.size(); index = next_candidate++) {
+				measureCandidate(SAMPLE, cascades, shared_eye_cascades, CONFIG, candidates[index]);
+			}
+		});
+	}
+	for (auto &worker: workers) {
+		worker.join();
+	}
+
+	const vector<TuningCandidate> FRONTIER = paretoFrontier(candidates);
+	logger().flush();
+	cout << endl;
+	cout << "Pareto frontier over " << SAMPLE.size() << " images (" << candidates.size() << " candidates):" << endl;
+	cout << right << setw(6) << "Blur" << setw(8) << "Scale" << setw(11) << "Neighbors" << setw(10) << "Min face" << setw(10) << "Max face"
+	     << setw(12) << "Images/sec" << setw(10) << "Accuracy" << setw(11) << "Precision" << setw(8) << "Recall" << setw(10) << "F1-Score" << endl;
+	for (auto &candidate: FRONTIER) {
+		cout << setw(6) << candidate.pre_processing.BLUR_WIDTH << setw(8) << candidate.face_detection.SCALE_FACTOR << setw(11) << candidate.face_detection.MIN_NEIGHBORS
+		     << setw(10) << candidate.face_detection.MIN_FACE << setw(10) << candidate.face_detection.MAX_FACE << fixed << setprecision(1)
+		     << setw(12) << candidate.images_per_second << setw(9) << 100 * candidate.accuracy << "%" << setw(10) << 100 * candidate.matrix.precision() << "%"
+		     << setw(7) << 100 * candidate.matrix.recall() << "%" << setw(9) << 100 * candidate.matrix.f1() << "%" << endl;
+		cout.unsetf(ios::fixed);
+		cout << setprecision(6);
+	}
+
+	// The frontier runs from the fastest to the most accurate, so the first candidate within the tolerance is the fastest of them
+	const double TARGET = FRONTIER.back().accuracy - CONFIG.TUNE_TOLERANCE / 100;
+	const TuningCandidate& CHOSEN = *find_if(FRONTIER.begin(), FRONTIER.end(), [TARGET](const TuningCandidate& CANDIDATE) { return CANDIDATE.accuracy >= TARGET; });
+	if (!writeTunedConfig(CONFIG.TUNE_PATH, CHOSEN, SAMPLE.size())) {
+		logger().log(LogLevel::ERROR, "tune_config_unwritable", CONFIG.TUNE_PATH);
+		return false;
+	}
+	cout << endl;
+	cout << "Chosen: --blur " << CHOSEN.pre_processing.BLUR_WIDTH << " --scale-factor " << CHOSEN.face_detection.SCALE_FACTOR << " --min-neighbors " << CHOSEN.face_detection.MIN_NEIGHBORS
+	     << " --min-face " << CHOSEN.face_detection.MIN_FACE << " --max-face " << CHOSEN.face_detection.MAX_FACE << " (written to " << CONFIG.TUNE_PATH << ")" << endl;
+	return true;
+}
+
+#endif //MAIN_TUNER_H
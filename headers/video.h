@@ -0,0 +1,184 @@
+// video.h
+// Description: Runs the mask detection algorithm on the frames of a local video file, decoding them on a dedicated thread and keeping
+//              one frame out of every few frames or milliseconds
+// Assumptions: A video has no ground truth, so only the decisions are counted; a handful of decoded frames fit in memory at once
+
+#ifndef MAIN_VIDEO_H
+#define MAIN_VIDEO_H
+
+// Import the necessary libraries for opencv, threading, and i/o
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <opencv2/core.hpp>
+#include <opencv2/imgproc.hpp>
+#include <opencv2/objdetect.hpp>
+#include <opencv2/videoio.hpp>
+#include "headers/concurrency.h"
+#include "headers/config.h"
+#include "headers/deadline.h"
+#include "headers/dedup.h"
+#include "headers/logger.h"
+#include "headers/maskdetection.h"
+#include "headers/preprocessing.h"
+#include "headers/resultcache.h"
+
+// Declaring the namespaces that would be used throughout the program
+// We can use 2 namespaces as long as there aren't any conflicts
+using namespace std;
+using namespace cv;
+
+// Number of decoded frames waiting for the detection before the decoding thread waits
+const size_t VIDEO_QUEUE_FRAMES = 8;
+
+// A decoded frame kept for the detection
+//          index:        Position of the frame in the video, from 0
+//          timestamp_ms: Presentation time of the frame
+//          image:        The decoded frame
+struct VideoFrame {
+	long long index = 0;
+	double timestamp_ms = 0;
+	Mat image;
+};
+
+// Grabs every frame of a video and decodes the kept ones into a queue, closing it at the end of the video
+// Parameters:
+//          capture:     The opened video
+//          STRIDE:      Keeps one frame out of every STRIDE frames
+//          INTERVAL_MS: Least time between two kept frames, or 0 to keep every frame of the stride
+//          frames:      Queue receiving the kept frames
+//          read:        Receives the number of frames grabbed, read once the thread has joined
+// Pre-condition:  The video is opened and the stride is positive
+// Post-condition: Frames that are not kept are only grabbed, never decoded
+void decodeVideoFrames(VideoCapture& capture, const int STRIDE, const double INTERVAL_MS, BoundedQueue<VideoFrame>& frames, long long& read) {
+	const double FPS = capture.get(CAP_PROP_FPS);
+	double next_timestamp_ms = 0;
+	for (long long index = 0; capture.grab(); index++) {
+		read = index + 1;
+		// Some backends report no position, in which case the timestamp follows from the frame rate
+		double timestamp_ms = capture.get(CAP_PROP_POS_MSEC);
+		if (timestamp_ms <= 0 && index > 0 && FPS > 0) {
+			timestamp_ms = index * 1000 / FPS;
+		}
+		if (index % STRIDE != 0 || timestamp_ms < next_timestamp_ms) {
+			continue;
+		}
+		VideoFrame frame;
+		frame.index = index;
+		frame.timestamp_ms = timestamp_ms;
+		if (!capture.retrieve(frame.image) || frame.image.empty()) {
+			logger().log(LogLevel::WARNING, "frame_unreadable", to_string(index));
+			continue;
+		}
+		next_timestamp_ms = timestamp_ms + INTERVAL_MS;
+		if (!frames.push(move(frame))) {
+			break;
+		}
+	}
+	frames.close();
+}
+
+// Runs the mask detection algorithm on the kept frames of a video and writes the per frame results to the csv file
+// Parameters:
+//          FACE_HAAR_CASCADE:   Haar Cascade classifier object for face detection
+//          FACE_LBP_CASCADE:    LBP Cascade classifier object for face detection
+//          LEFT_EYE_CASCADE:    Haar Cascade classifier object for left eye detection
+//          RIGHT_EYE_CASCADE:   Haar Cascade classifier object for right eye detection
+//          EYE_GLASS_CASCADE:   Haar Cascade classifier object for eyes (with or without glasses) detection
+//          shared_eye_cascades: The eye cascades loaded to be scanned together, used by the shared eye search
+//          CONFIG:              Run-time options holding the video, the frame sampling, the output, and the options of the detection
+//          DEBUG_MODE:          To control the image display outputs
+// Pre-condition:  Expects loaded cascade classifiers
+// Post-condition: Returns false if the video cannot be opened; otherwise one csv row per kept frame is written,
+//                 and the counts of the decisions and the throughput in frames per second are displayed
+template <bool DEBUG_MODE>
+bool runVideo(const CascadeClassifier& FACE_HAAR_CASCADE, const CascadeClassifier& FACE_LBP_CASCADE, const CascadeClassifier& LEFT_EYE_CASCADE, const CascadeClassifier& RIGHT_EYE_CASCADE, const CascadeClassifier& EYE_GLASS_CASCADE, MultiCascade& shared_eye_cascades, const Config& CONFIG) {
+	VideoCapture capture(CONFIG.VIDEO_PATH);
+	if (!capture.isOpened()) {
+		logger().log(LogLevel::ERROR, "invalid_video", CONFIG.VIDEO_PATH);
+		return false;
+	}
+	ofstream output(CONFIG.OUTPUT_PATH, ofstream::trunc);
+	output << "Frame,Timestamp (ms),Detected Faces,Skipped Faces (Eye issue),Masked Faces,Non-masked Faces" << (CONFIG.DEDUP ? ",Reused" : "") << "\n";
+
+	const unique_ptr<Deadline> deadline = CONFIG.DEADLINE_MS > 0 ? make_unique<Deadline>(CONFIG.DEADLINE_MS) : nullptr;
+	const unique_ptr<DuplicateIndex> duplicates = CONFIG.DEDUP ? make_unique<DuplicateIndex>(CONFIG.DEDUP_WINDOW, CONFIG.DEDUP_DISTANCE) : nullptr;
+	DetectionCounts totals;
+	long long processed = 0, reused = 0, read = 0;
+
+	// Decoding the frames on their own thread while the detection runs on the previous ones
+	const auto START = chrono::steady_clock::now();
+	BoundedQueue<VideoFrame> frames(VIDEO_QUEUE_FRAMES);
+	thread decoder(decodeVideoFrames, ref(capture), CONFIG.FRAME_STRIDE, CONFIG.FRAME_INTERVAL_MS, ref(frames), ref(read));
+	VideoFrame frame;
+	Mat image;
+	DetectionBuffers detection_buffers;
+	while (frames.pop(frame)) {
+		const string FRAME_NAME = CONFIG.VIDEO_PATH + "#" + to_string(frame.index);
+		logger().log(LogLevel::INFO, "frame", FRAME_NAME);
+		if (deadline != nullptr) {
+			deadline->start(chrono::steady_clock::now());
+		}
+		// The frames are already decoded, so the decode scale shrinks them instead
+		if (CONFIG.DECODE_SCALE > 1) {
+			resize(frame.image, image, Size(), 1.0 / CONFIG.DECODE_SCALE, 1.0 / CONFIG.DECODE_SCALE, INTER_AREA);
+		}
+		else {
+			image = frame.image;
+		}
+
+		ImageResult result;
+		const uint64_t HASH = duplicates != nullptr ? duplicates->hash(image) : 0;
+		int distance = 0;
+		if (duplicates != nullptr && duplicates->find(HASH, image, CONFIG, result.faces, distance)) {
+			result.counts = countDecisions(result.faces, 0);
+			result.reused = true;
+			reused += 1;
+			logger().log(LogLevel::INFO, "frame_reused", FRAME_NAME, (long long)distance, true);
+		}
+		else {
+			const Mat PRE_PROCESSED_IMAGE = preProcessing<DEBUG_MODE>(image, CONFIG.PRE_PROCESSING);
+			result = maskDetection<DEBUG_MODE>(image, PRE_PROCESSED_IMAGE, 0, FACE_HAAR_CASCADE, FACE_LBP_CASCADE, LEFT_EYE_CASCADE, RIGHT_EYE_CASCADE, EYE_GLASS_CASCADE, shared_eye_cascades, CONFIG, nullptr, StageKeys{}, deadline.get(), detection_buffers);
+			if (duplicates != nullptr && result.degraded == NOT_DEGRADED) {
+				duplicates->add(HASH, image, CONFIG, result.faces);
+			}
+		}
+		if (result.degraded != NOT_DEGRADED) {
+			logger().log(LogLevel::INFO, "frame_degraded", FRAME_NAME, (long long)result.degraded, true);
+		}
+
+		// Without a ground truth, the faces that were not detected cannot be counted
+		const DetectionCounts& COUNTS = result.counts;
+		totals.eyes_skipped += COUNTS.eyes_skipped;
+		totals.masked += COUNTS.masked;
+		totals.not_masked += COUNTS.not_masked;
+		output << frame.index << "," << frame.timestamp_ms << "," << result.faces.size() << "," << COUNTS.eyes_skipped << "," << COUNTS.masked << "," << COUNTS.not_masked;
+		if (CONFIG.DEDUP) {
+			output << "," << (result.reused ? 1 : 0);
+		}
+		output << "\n";
+		processed += 1;
+	}
+	decoder.join();
+	const double SECONDS = chrono::duration<double>(chrono::steady_clock::now() - START).count();
+
+	// Printing the final counts after the log records of the run
+	logger().flush();
+	cout << endl;
+	cout << "Frames read: " << read << endl;
+	cout << "Frames processed: " << processed << endl;
+	cout << "Detected Masked faces: " << totals.masked << endl;
+	cout << "Detected Non-masked faces: " << totals.not_masked << endl;
+	cout << "Skipped Faces due to eye detection issue: " << totals.eyes_skipped << endl;
+	if (duplicates != nullptr) {
+		cout << "Results reused from near-duplicate frames: " << reused << endl;
+	}
+	cout << endl;
+	cout << "Throughput: " << (SECONDS > 0 ? processed / SECONDS : 0) << " frames/sec processed, " << (SECONDS > 0 ? read / SECONDS : 0) << " frames/sec read over " << SECONDS << " seconds" << endl;
+	return true;
+}
+
+#endif //MAIN_VIDEO_H
@@ -4,12 +4,37 @@
 // Authors: Saurav Jayakumar, Utkarsh Darbari
 
 // Import the necessary libraries for opencv and i/o
+#include <algorithm>
 #include <iostream>
 #include <fstream>
 #include <vector>
 #include <string>
+#include <tuple>
+#include <chrono>
+#include <memory>
+#include <filesystem>
 #include "headers/helper.h"
+#include "headers/allocator.h"
+#include "headers/annotation.h"
+#include "headers/batchreader.h"
+#include "headers/checkpoint.h"
+#include "headers/config.h"
+#include "headers/container.h"
+#include "headers/dedup.h"
+#include "headers/evaluation.h"
+#include "headers/imagesource.h"
+#include "headers/results.h"
+#include "headers/resultstore.h"
+#include "headers/resultcache.h"
+#include "headers/rescore.h"
+#include "headers/manifest.h"
 #include "headers/maskdetection.h"
+#include "headers/pixelcache.h"
+#include "headers/preprocessing.h"
+#include "headers/sampling.h"
+#include "headers/scanner.h"
+#include "headers/tuner.h"
+#include "headers/video.h"
 
 // Declaring the namespaces that would be used throughout the program
 // We can use 2 namespaces as long as there aren't any conflicts
@@ -17,85 +42,653 @@ using namespace std;
 using namespace cv;
 
 // Controls the display function calls to reduce the number of images displayed
-const bool DEBUG_MODE = false;
+// A compile-time constant, so with false the display, drawing, and debug console output are removed from the build
+constexpr bool DEBUG_MODE = false;
+
+// Opens the source of the test images
+// Parameters:
+//          CONFIG: Run-time options naming the dataset directory, the optional manifest, the optional container, and the read depth
+// Pre-condition:  N/A
+// Post-condition: Returns the container or the manifest if one was requested (refreshing the manifest if the dataset changed), otherwise a background scan of the directory;
+//                 with a read depth, the images of the manifest or the scan are read ahead of the detection
+unique_ptr<ImageSource> openImageSource(const Config& CONFIG) {
+	if (!CONFIG.CONTAINER_PATH.empty()) {
+		return make_unique<ContainerSource>(CONFIG.CONTAINER_PATH);
+	}
+	unique_ptr<ImageSource> images;
+	if (!CONFIG.MANIFEST_PATH.empty()) {
+		images = make_unique<ManifestSource>(CONFIG.DIRECTORY_PATH, CONFIG.MANIFEST_PATH);
+	}
+	else {
+		images = make_unique<DirectoryScanner>(CONFIG.DIRECTORY_PATH);
+	}
+	if (CONFIG.READ_DEPTH > 0) {
+		return make_unique<BatchedReader>(move(images), CONFIG.READ_DEPTH);
+	}
+	return images;
+}
+
+// Reads the encoded bytes of an image, unless the source already read them
+// Parameters:
+//          ENTRY:  The image
+//          buffer: Receives the bytes read from disk
+//          bytes:  Receives the encoded bytes, pointing into the entry or into the buffer
+// Pre-condition:  N/A
+// Post-condition: Returns false if the image cannot be read
+bool imageBytes(const ImageEntry& ENTRY, vector<char>& buffer, string_view& bytes) {
+	bytes = ENTRY.bytes;
+	if (!bytes.empty()) {
+		return true;
+	}
+	const int FD = open(ENTRY.path.c_str(), O_RDONLY | O_CLOEXEC);
+	const bool READ = FD >= 0 && readWholeFile(FD, buffer);
+	if (FD >= 0) {
+		close(FD);
+	}
+	if (!READ) {
+		logger().log(LogLevel::WARNING, "invalid_path", ENTRY.path);
+		return false;
+	}
+	bytes = string_view(buffer.data(), buffer.size());
+	return true;
+}
+
+// Decodes an image, or takes it along with its pre-processed image from the pixel cache
+// Parameters:
+//          ENTRY:         The image
+//          BYTES:         The encoded image, or empty to read it from disk
+//          CONFIG:        Run-time options of the image holding the decode scale and the pre-processing parameters
+//          pixel_cache:   Cache of decoded and pre-processed images, or nullptr to always decode
+//          image:         Receives the decoded image
+//          pre_processed: Receives the pre-processed image on a cache hit, and is emptied otherwise
+// Pre-condition:  The bytes are given when the pixel cache is used, since the cache is keyed by them
+// Post-condition: Returns false if the image cannot be read or decoded
+template <bool DEBUG_MODE>
+bool decodeImage(const ImageEntry& ENTRY, const string_view BYTES, const Config& CONFIG, PixelCache* pixel_cache, Mat& image, Mat& pre_processed) {
+	// Reading an image which might have faces from disk and displaying it
+	print<DEBUG_MODE>("Reading image from disk");
+	if (pixel_cache != nullptr && pixel_cache->load(BYTES, PixelCache::paramsHash(CONFIG), image, pre_processed)) {
+		display<DEBUG_MODE>("Image", image);
+		return true;
+	}
+	pre_processed.release();
+	// Images from a container, the batched reader, or the caches are decoded straight from memory
+	image = BYTES.empty() ? readDisplay<DEBUG_MODE>(ENTRY.path, "Image", CONFIG.DECODE_SCALE) : decodeDisplay<DEBUG_MODE>(BYTES, ENTRY.path, "Image", CONFIG.DECODE_SCALE);
+	return !image.empty();
+}
+
+// Pre-processes a decoded image and keeps both images in the pixel cache
+// Parameters:
+//          BYTES:         The encoded image the cache entry is keyed by
+//          CONFIG:        Run-time options of the image holding the pre-processing parameters
+//          pixel_cache:   Cache of decoded and pre-processed images, or nullptr to keep nothing
+//          IMAGE:         The decoded image
+//          pre_processed: Receives the pre-processed image
+// Pre-condition:  The image was decoded by decodeImage with the same bytes and options, and missed the cache
+// Post-condition: The pre-processed image is set and both images are stored in the cache
+template <bool DEBUG_MODE>
+void preProcessImage(const string_view BYTES, const Config& CONFIG, PixelCache* pixel_cache, const Mat& IMAGE, Mat& pre_processed) {
+	print<DEBUG_MODE>("Pre-processing");
+	pre_processed = preProcessing<DEBUG_MODE>(IMAGE, CONFIG.PRE_PROCESSING);
+	if (pixel_cache != nullptr) {
+		pixel_cache->store(BYTES, PixelCache::paramsHash(CONFIG), IMAGE, pre_processed);
+	}
+}
+
+// Decodes and pre-processes an image, or takes both from the pixel cache
+// Parameters:
+//          ENTRY:         The image
+//          BYTES:         The encoded image, or empty to read it from disk
+//          CONFIG:        Run-time options of the image holding the decode scale and the pre-processing parameters
+//          pixel_cache:   Cache of decoded and pre-processed images, or nullptr to always decode
+//          image:         Receives the decoded image
+//          pre_processed: Receives the pre-processed image
+// Pre-condition:  The bytes are given when the pixel cache is used, since the cache is keyed by them
+// Post-condition: Both images are set; on a cache miss they are computed and stored in the cache
+//                 Returns false if the image cannot be read or decoded
+template <bool DEBUG_MODE>
+bool loadImage(const ImageEntry& ENTRY, const string_view BYTES, const Config& CONFIG, PixelCache* pixel_cache, Mat& image, Mat& pre_processed) {
+	if (!decodeImage<DEBUG_MODE>(ENTRY, BYTES, CONFIG, pixel_cache, image, pre_processed)) {
+		return false;
+	}
+	if (pre_processed.empty()) {
+		preProcessImage<DEBUG_MODE>(BYTES, CONFIG, pixel_cache, image, pre_processed);
+	}
+	return true;
+}
+
+// Takes a checkpoint of the run, flushing the csv rows it covers first
+// Parameters:
+//          checkpoint: The checkpoint to update
+//          SUMMARY:    Tallies of the run so far
+//          SECONDS:    Time spent processing the images so far
+//          CONFIG:     Run-time options holding the location of the csv file
+//          output:     Stream receiving the csv rows, or nullptr if the run writes none
+// Pre-condition:  N/A
+// Post-condition: The checkpoint covers every image completed so far; if it cannot be taken, the previous one stays in place and the run goes on
+void saveCheckpoint(Checkpoint& checkpoint, RunSummary SUMMARY, const double SECONDS, const Config& CONFIG, ofstream* output) {
+	SUMMARY.seconds = SECONDS;
+	uint64_t csv_size = 0;
+	if (output != nullptr) {
+		// The size comes from the file itself, since a stream reopened for appending reports position 0 until its first write
+		output->flush();
+		error_code error;
+		csv_size = uint64_t(filesystem::file_size(CONFIG.OUTPUT_PATH, error));
+		if (error) {
+			logger().log(LogLevel::WARNING, "checkpoint_failed", CONFIG.OUTPUT_PATH);
+			return;
+		}
+	}
+	checkpoint.save(SUMMARY, output != nullptr ? CONFIG.OUTPUT_PATH : "", csv_size);
+}
+
+// Runs the mask detection algorithm on every image and optionally writes the per image results to a csv file or to the columnar results
+// Parameters:
+//          images:              Source of the image paths along with the label, image id, and number of faces of each image
+//          FACE_HAAR_CASCADE:   Haar Cascade classifier object for face detection
+//          FACE_LBP_CASCADE:    LBP Cascade classifier object for face detection
+//          LEFT_EYE_CASCADE:    Haar Cascade classifier object for left eye detection
+//          RIGHT_EYE_CASCADE:   Haar Cascade classifier object for right eye detection
+//          EYE_GLASS_CASCADE:   Haar Cascade classifier object for eyes (with or without glasses) detection
+//          shared_eye_cascades: The eye cascades loaded to be scanned together, used by the shared eye search
+//          CONFIG:              Run-time options of the mask detection algorithm, with the presets of the sources replacing them for their images
+//          output:              Stream receiving the csv rows, or nullptr to skip writing them
+//          results:             Writer receiving the per image and per face results along with their timings, or nullptr to skip writing them
+//          annotations:         Writer receiving the processed images for annotation, or nullptr to skip annotating them
+//          pixel_cache:         Cache of decoded and pre-processed images, or nullptr to decode every image
+//          result_cache:        Cache of the per face results, or nullptr to detect every image
+//          stages:              Store of the results of the face, eye, and skin stages, or nullptr to compute every stage
+//          checkpoint:          Checkpoint the run resumes from and keeps up to date, or nullptr to take no checkpoint
+//          sampler:             Sampler producing the images, which is told the counts of every image it produced, or nullptr when images is not sampled
+// Pre-condition:  Expects loaded cascade classifiers
+// Post-condition: Returns the tallies of the run along with the time it took, including those restored from the checkpoint;
+//                 images that cannot be read or decoded are quarantined instead of counted
+RunSummary runDataset(ImageSource& images, const CascadeClassifier& FACE_HAAR_CASCADE, const CascadeClassifier& FACE_LBP_CASCADE, const CascadeClassifier& LEFT_EYE_CASCADE, const CascadeClassifier& RIGHT_EYE_CASCADE, const CascadeClassifier& EYE_GLASS_CASCADE, MultiCascade& shared_eye_cascades, const Config& CONFIG, ofstream* output, ResultsWriter* results, AnnotationWriter* annotations, PixelCache* pixel_cache, ResultCache* result_cache, StageStore* stages, Checkpoint* checkpoint, StratifiedSampler* sampler) {
+	RunSummary summary = checkpoint != nullptr ? checkpoint->restoredSummary() : RunSummary();
+	const double RESTORED_SECONDS = summary.seconds;
+	// Heap allocation counts of this thread once the warm-up images are processed, and the number of images processed since the run started or resumed
+	// Only the thread running the detection is counted, so the scanner, reader, logger, and encoder threads working alongside it do not show up
+	long long warm_up_heap_allocations = 0, warm_up_new_calls = 0, warm_up_library_new_calls = 0;
+	int processed = 0;
+	const auto START = chrono::steady_clock::now();
+	const SourceConfigs SOURCES(CONFIG);
+	const unique_ptr<Deadline> deadline = CONFIG.DEADLINE_MS > 0 ? make_unique<Deadline>(CONFIG.DEADLINE_MS) : nullptr;
+	const unique_ptr<DuplicateIndex> duplicates = CONFIG.DEDUP ? make_unique<DuplicateIndex>(CONFIG.DEDUP_WINDOW, CONFIG.DEDUP_DISTANCE) : nullptr;
+	vector<char> buffer;
+	// The scratch vectors of the detection, reused from image to image so a warmed up run does not allocate them again
+	DetectionBuffers detection_buffers;
+	// The latencies of the images an allocation check covers are reserved up front; other runs let the vector grow as it goes
+	if (deadline != nullptr && CONFIG.ALLOCATION_CHECK > 0) {
+		summary.latencies_ms.reserve(summary.latencies_ms.size() + ALLOCATION_WARM_UP_IMAGES + CONFIG.ALLOCATION_CHECK);
+	}
+
+	// Running the mask detection algorithm through each of the image file as the source produces them
+	ImageEntry entry;
+	while (images.next(entry)) {
+		// Skipping the images completed before the checkpoint the run resumed from
+		if (checkpoint != nullptr && checkpoint->done(entry)) {
+			continue;
+		}
+		const string& FILE_PATH = entry.path;
+		const bool WITH_MASK = entry.with_mask;
+		const int image_id = entry.image_id;
+		const int faces = entry.faces;
+		const Config& IMAGE_CONFIG = SOURCES.select(FILE_PATH);
+
+		const auto LOAD_START = chrono::steady_clock::now();
+		if (deadline != nullptr) {
+			deadline->start(LOAD_START);
+		}
+		// The caches and the stage store are keyed by the encoded bytes, so they are read up front when any of them is on
+		string_view bytes = entry.bytes;
+		// Images the read-ahead could not read are quarantined like any other unreadable image
+		const bool READ = !entry.unreadable && ((pixel_cache == nullptr && result_cache == nullptr && stages == nullptr) || imageBytes(entry, buffer, bytes));
+		const StageKeys STAGE_KEYS = stages != nullptr && READ ? stages->keys(bytes, IMAGE_CONFIG) : StageKeys{};
+		const uint64_t CONFIG_HASH = result_cache != nullptr ? result_cache->configHash(IMAGE_CONFIG) : 0;
+
+		// A hit in the result cache skips the decoding (unless the image may be annotated) and the detection,
+		// and so does an image whose every stage is stored
+		ImageResult result;
+		const bool CACHED = READ && result_cache != nullptr && result_cache->lookup(bytes, CONFIG_HASH, result.faces);
+		const bool STORED = stages != nullptr && READ && stages->complete(STAGE_KEYS);
+		Mat image, pre_processed_image;
+		const bool DECODE = (!CACHED && !STORED) || CONFIG.ANNOTATION_SAMPLING != AnnotationSampling::NONE;
+		if (!READ || (DECODE && !decodeImage<DEBUG_MODE>(entry, bytes, IMAGE_CONFIG, pixel_cache, image, pre_processed_image))) {
+			// A corrupt or unreadable image is set aside rather than ending the run
+			logger().log(LogLevel::WARNING, "image_quarantined", FILE_PATH);
+			summary.quarantined.push_back(FILE_PATH);
+			if (checkpoint != nullptr) {
+				checkpoint->complete(entry, true);
+			}
+			continue;
+		}
+		logger().log(LogLevel::INFO, "image", FILE_PATH);
+		// Hashing the decoded image before it is pre-processed, so a recent near-duplicate stands in for the pre-processing as well as the detection
+		const bool HASHED = duplicates != nullptr && !CACHED && !image.empty();
+		const uint64_t HASH = HASHED ? duplicates->hash(image) : 0;
+		int distance = 0;
+		const bool REUSED = HASHED && duplicates->find(HASH, image, IMAGE_CONFIG, result.faces, distance);
+		// Neither a cached nor a reused result looks at the pre-processed image, and an image served by the pixel cache already has it
+		if (!CACHED && !REUSED && !image.empty() && pre_processed_image.empty()) {
+			preProcessImage<DEBUG_MODE>(bytes, IMAGE_CONFIG, pixel_cache, image, pre_processed_image);
+		}
+		const auto DETECT_START = chrono::steady_clock::now();
+		if (CACHED) {
+			result.counts = countDecisions(result.faces, faces);
+		}
+		else if (REUSED) {
+			result.counts = countDecisions(result.faces, faces);
+			result.reused = true;
+			summary.reused += 1;
+			logger().log(LogLevel::INFO, "image_reused", FILE_PATH, (long long)distance, true);
+		}
+		else {
+			result = maskDetection<DEBUG_MODE>(image, pre_processed_image, faces, FACE_HAAR_CASCADE, FACE_LBP_CASCADE, LEFT_EYE_CASCADE, RIGHT_EYE_CASCADE, EYE_GLASS_CASCADE, shared_eye_cascades, IMAGE_CONFIG, stages, STAGE_KEYS, deadline.get(), detection_buffers);
+			// Degraded results are not what the parameters would produce, so they are never cached
+			if (result_cache != nullptr && result.degraded == NOT_DEGRADED) {
+				result_cache->store(bytes, CONFIG_HASH, result.faces);
+			}
+			if (HASHED && result.degraded == NOT_DEGRADED) {
+				duplicates->add(HASH, image, IMAGE_CONFIG, result.faces);
+			}
+		}
+		const ImageResult& RESULT = result;
+		const auto DETECT_END = chrono::steady_clock::now();
+		const DetectionCounts& COUNTS = RESULT.counts;
+		if (deadline != nullptr) {
+			const float LATENCY_MS = chrono::duration<float, milli>(DETECT_END - LOAD_START).count();
+			summary.latencies_ms.push_back(LATENCY_MS);
+			summary.over_deadline += LATENCY_MS > CONFIG.DEADLINE_MS ? 1 : 0;
+			if (RESULT.degraded != NOT_DEGRADED) {
+				summary.degraded += 1;
+				logger().log(LogLevel::INFO, "image_degraded", FILE_PATH, (long long)RESULT.degraded, true);
+			}
+		}
+		if (annotations != nullptr && !image.empty()) {
+			annotations->submit(image, RESULT, filesystem::path(FILE_PATH).filename().string(), WITH_MASK, faces);
+		}
+
+		if (WITH_MASK) {
+			summary.ground_truth_masks += faces;
+			summary.masked_counts += COUNTS;
+		}
+		else {
+			summary.ground_truth_no_masks += faces;
+			summary.not_masked_counts += COUNTS;
+		}
+		if (sampler != nullptr) {
+			sampler->record(COUNTS);
+		}
+		if (output != nullptr) {
+			writeCsvRow(*output, WITH_MASK, image_id, faces, COUNTS, CONFIG.DEDUP, RESULT.reused);
+		}
+		if (results != nullptr) {
+			results->add(entry, RESULT, chrono::duration<float, milli>(DETECT_START - LOAD_START).count(), chrono::duration<float, milli>(DETECT_END - DETECT_START).count());
+		}
+		summary.images += 1;
+		processed += 1;
+		// The first images warm up the pool; every image after them should be served without the heap
+		if (processed == ALLOCATION_WARM_UP_IMAGES) {
+			warm_up_heap_allocations = pooledMatAllocator().threadHeapAllocationCount();
+			warm_up_new_calls = thread_new_calls;
+			warm_up_library_new_calls = thread_library_new_calls;
+		}
+		if (checkpoint != nullptr) {
+			checkpoint->complete(entry, false);
+			if (checkpoint->due()) {
+				saveCheckpoint(*checkpoint, summary, RESTORED_SECONDS + chrono::duration<double>(chrono::steady_clock::now() - START).count(), CONFIG, output);
+			}
+		}
+		// The allocation check stops once it has covered its images
+		if (CONFIG.ALLOCATION_CHECK > 0 && processed == ALLOCATION_WARM_UP_IMAGES + CONFIG.ALLOCATION_CHECK) {
+			break;
+		}
+	}
+	if (processed > ALLOCATION_WARM_UP_IMAGES) {
+		summary.warm_images = processed - ALLOCATION_WARM_UP_IMAGES;
+		summary.warm_heap_allocations = pooledMatAllocator().threadHeapAllocationCount() - warm_up_heap_allocations;
+		summary.warm_new_calls = thread_new_calls - warm_up_new_calls;
+		summary.warm_library_new_calls = thread_library_new_calls - warm_up_library_new_calls;
+	}
+
+	summary.seconds = RESTORED_SECONDS + chrono::duration<double>(chrono::steady_clock::now() - START).count();
+	// A final checkpoint, so resuming a finished run only recreates its summary
+	if (checkpoint != nullptr) {
+		saveCheckpoint(*checkpoint, summary, summary.seconds, CONFIG, output);
+	}
+	return summary;
+}
+
+// Returns true if two cascades found the same boxes, in any order
+// Parameters:
+//          first:  Boxes found by one cascade, sorted in place
+//          second: Boxes found by the other cascade, sorted in place
+// Pre-condition:  N/A
+// Post-condition: Both vectors are sorted by position and then size
+bool sameBoxes(vector<Rect>& first, vector<Rect>& second) {
+	const auto BEFORE = [](const Rect& A, const Rect& B) {
+		return tie(A.y, A.x, A.height, A.width) < tie(B.y, B.x, B.height, B.width);
+	};
+	sort(first.begin(), first.end(), BEFORE);
+	sort(second.begin(), second.end(), BEFORE);
+	return first == second;
+}
+
+// Checks that the shared eye search finds the same eyes as the eye cascades, on the faces the Haar face cascade finds in the first images of the dataset
+// Parameters:
+//          images:              Source of the images of the dataset
+//          FACE_HAAR_CASCADE:   Haar Cascade classifier object for face detection
+//          LEFT_EYE_CASCADE:    Haar Cascade classifier object for left eye detection
+//          RIGHT_EYE_CASCADE:   Haar Cascade classifier object for right eye detection
+//          EYE_GLASS_CASCADE:   Haar Cascade classifier object for eyes (with or without glasses) detection
+//          shared_eye_cascades: The same eye cascades loaded to be scanned together
+//          CONFIG:              Run-time options holding the number of images, the decode scale, the pre-processing and face detection parameters, and the canonical face size
+//          DEBUG_MODE:          To control the image display outputs
+// Pre-condition:  Expects loaded cascade classifiers
+// Post-condition: Returns false if a cascade found other boxes on any face, in which case the union of the eye boxes could differ between the two eye searches;
+//                 every face with a difference is logged, along with the number of faces checked
+template <bool DEBUG_MODE>
+bool checkEyeSearch(ImageSource& images, const CascadeClassifier& FACE_HAAR_CASCADE, const CascadeClassifier& LEFT_EYE_CASCADE, const CascadeClassifier& RIGHT_EYE_CASCADE, const CascadeClassifier& EYE_GLASS_CASCADE, MultiCascade& shared_eye_cascades, const Config& CONFIG) {
+	CascadeClassifier eye_cascades[] = {LEFT_EYE_CASCADE, RIGHT_EYE_CASCADE, EYE_GLASS_CASCADE};
+	const int CASCADES = 3;
+	vector<Rect> face_boxes, eyes;
+	vector<vector<Rect>> shared_eyes;
+	vector<Mat> cropped_faces, normalized_faces;
+	Mat image, pre_processed_image, gray_face;
+	long long faces = 0, mismatches = 0;
+	int checked_images = 0;
+
+	ImageEntry entry;
+	while (checked_images < CONFIG.CHECK_EYE_SEARCH && images.next(entry)) {
+		if (!loadImage<DEBUG_MODE>(entry, entry.bytes, CONFIG, nullptr, image, pre_processed_image)) {
+			logger().log(LogLevel::WARNING, "image_quarantined", entry.path);
+			continue;
+		}
+		checked_images += 1;
+		faceDetection<DEBUG_MODE>(image, pre_processed_image, FACE_HAAR_CASCADE, CONFIG.FACE_DETECTION, face_boxes, cropped_faces);
+		if (CONFIG.CANONICAL_FACE_SIZE > 0) {
+			normalizeFaceSize<DEBUG_MODE>(cropped_faces, CONFIG.CANONICAL_FACE_SIZE, normalized_faces);
+		}
+		for (auto &face: CONFIG.CANONICAL_FACE_SIZE > 0 ? normalized_faces : cropped_faces) {
+			// Both searches run on the same grayscale face, as in eyeNoseMouthDetection
+			cvtColor(face, gray_face, COLOR_BGR2GRAY);
+			shared_eye_cascades.detect(gray_face, CASCADES, shared_eyes);
+			bool same = true;
+			for (int j = 0; j < CASCADES; j++) {
+				eye_cascades[j].detectMultiScale(gray_face, eyes);
+				same = sameBoxes(eyes, shared_eyes[j]) && same;
+			}
+			faces += 1;
+			if (!same) {
+				mismatches += 1;
+				logger().log(LogLevel::WARNING, "eye_search_mismatch", entry.path, faces, true);
+			}
+		}
+	}
+	logger().log(LogLevel::INFO, "eye_search_checked", CONFIG.DIRECTORY_PATH, faces, true);
+	if (mismatches > 0) {
+		logger().log(LogLevel::ERROR, "eye_search_check_failed", CONFIG.DIRECTORY_PATH, mismatches, true);
+	}
+	return mismatches == 0;
+}
 
 // The main function runs the mask detection function on a set of images
-// Parameters: N/A
+// Parameters:
+//          argc: Number of command line arguments
+//          argv: Command line arguments (see printUsage in headers/config.h)
 // Pre-condition: Expects valid jpg images and cascade files in the specified locations
 // Post-condition:
 //              Prints the count of faces with masks, without masks, faces not detected, and eyes not detected for the set of masked and non-masked images
-//              Outputs the results per image to a csv file
-int main()
+//              Outputs the results per image to a csv file, or the results per image and per face to columnar files with --results
+//              With --compare-eye-search, prints the accuracy and throughput of every eye search strategy instead
+//              With --check-eye-search, checks that the shared eye search finds the same eyes as the eye cascades instead
+//              With --rescore, prints the metrics of an earlier run for every mask ratio of a sweep instead
+//              With --benchmark-presets, prints the accuracy and throughput of every preset instead
+//              With --video, outputs the results per frame of a video to the csv file and prints the throughput in frames per second instead
+//              With --tune, prints the throughput vs accuracy frontier of the face detection and blur parameters and writes the chosen ones to a config file instead
+int main(int argc, char* argv[])
 {
 	// Initial variables for the mask detection testing program
-	vector<int> masked_counts = {0, 0, 0, 0}, not_masked_counts = {0, 0, 0, 0};
-	vector<int> TEMP_COUNTS;
-	int ground_truth_masks = 0, ground_truth_no_masks = 0;
-	const string DIRECTORY_PATH = "Dataset";
+	const Config CONFIG = parseArguments(argc, argv);
+
+	// Debug builds always show the debug output of print
+	logger().setLevel(DEBUG_MODE ? LogLevel::DEBUG : CONFIG.LOG_LEVEL);
+
+	// Converting the columnar results of an earlier run into the csv layout instead of running the detection
+	if (CONFIG.EXPORT_CSV) {
+		return exportCsv(CONFIG.RESULTS_PATH, CONFIG.OUTPUT_PATH, CONFIG.DEDUP) ? 0 : 1;
+	}
+
+	// Sweeping the mask ratio over the stored skin counts of an earlier run instead of running the detection
+	if (CONFIG.RESCORE) {
+		return rescoreResults(CONFIG.RESULTS_PATH, CONFIG.SWEEP_FROM, CONFIG.SWEEP_TO, CONFIG.SWEEP_STEP) ? 0 : 1;
+	}
+
+	// Packing the dataset into a container for later runs instead of running the detection
+	if (!CONFIG.PACK_PATH.empty()) {
+		const unique_ptr<ImageSource> IMAGES = openImageSource(CONFIG);
+		const bool PACKED = packImages(*IMAGES, CONFIG.DIRECTORY_PATH, CONFIG.PACK_PATH);
+		if (!PACKED) {
+			logger().log(LogLevel::ERROR, "pack_failed", CONFIG.PACK_PATH);
+		}
+		return PACKED ? 0 : 1;
+	}
+
+	// Serving every Mat of the pipeline from the per-thread buffer pools
+	Mat::setDefaultAllocator(&pooledMatAllocator());
 	const string FACE_HAAR_CASCADE_FILENAME = "Haarcascades/haarcascade_frontalface_default.xml";
 	const string FACE_LBP_CASCADE_FILENAME = "LBPcascades/lbpcascade_frontalface_improved.xml";
 	const string LEFT_CASCADE_FILENAME = "Haarcascades/haarcascade_lefteye_2splits.xml";
 	const string RIGHT_CASCADE_FILENAME = "Haarcascades/haarcascade_righteye_2splits.xml";
 	const string GLASS_CASCADE_FILENAME = "Haarcascades/haarcascade_eye_tree_eyeglasses.xml";
+	const vector<string> CASCADE_FILENAMES = {FACE_HAAR_CASCADE_FILENAME, FACE_LBP_CASCADE_FILENAME, LEFT_CASCADE_FILENAME, RIGHT_CASCADE_FILENAME, GLASS_CASCADE_FILENAME};
 
-	// Loading the file names
-	print("Loading the file names", DEBUG_MODE);
-	const vector<vector<string>> FILES = getFileNames(DIRECTORY_PATH, DEBUG_MODE);
+	// Searching the face detection and blur parameters over a sample of the dataset instead of running the detection
+	if (!CONFIG.TUNE_PATH.empty()) {
+		const unique_ptr<ImageSource> IMAGES = openImageSource(CONFIG);
+		return tuneParameters(*IMAGES, CASCADE_FILENAMES, CONFIG) ? 0 : 1;
+	}
 
 	// Loading the cascade files
-	print("Loading the cascade files", DEBUG_MODE);
-	const CascadeClassifier FACE_HAAR_CASCADE = loadCascade(FACE_HAAR_CASCADE_FILENAME, DEBUG_MODE);
-	const CascadeClassifier FACE_LBP_CASCADE = loadCascade(FACE_LBP_CASCADE_FILENAME, DEBUG_MODE);
-	const CascadeClassifier LEFT_EYE_CASCADE = loadCascade(LEFT_CASCADE_FILENAME, DEBUG_MODE);
-	const CascadeClassifier RIGHT_EYE_CASCADE = loadCascade(RIGHT_CASCADE_FILENAME, DEBUG_MODE);
-	const CascadeClassifier EYE_GLASS_CASCADE = loadCascade(GLASS_CASCADE_FILENAME, DEBUG_MODE);
-
-	// Loading the file to store the detection results for all images
-	ofstream output;
-	output.open("output.csv", ofstream::trunc);
-	output << "File Type,Image ID,Ground Truth,Skipped Faces (Face issue),Skipped Faces (Eye issue),Masked Faces,Non-masked Faces\n";
-
-	// Running the mask detection algorithm through each of the image file
-	for (const auto & FILE : FILES){
-		const string& FILE_PATH = FILE.at(0);
-		const string& FILE_TYPE = FILE.at(1);
-		int image_id = stoi(FILE.at(2));
-		int faces = stoi(FILE.at(3));
-
-		if (FILE_TYPE == "With Mask") {
-			ground_truth_masks += faces;
-			TEMP_COUNTS = maskDetection(FILE_PATH, faces, FACE_HAAR_CASCADE, FACE_LBP_CASCADE, LEFT_EYE_CASCADE, RIGHT_EYE_CASCADE, EYE_GLASS_CASCADE, DEBUG_MODE);
-			masked_counts.at(0) += TEMP_COUNTS.at(0);
-			masked_counts.at(1) += TEMP_COUNTS.at(1);
-			masked_counts.at(2) += TEMP_COUNTS.at(2);
-			masked_counts.at(3) += TEMP_COUNTS.at(3);
-			output << FILE_TYPE << "," << image_id << "," << faces << "," << TEMP_COUNTS.at(3) * faces << "," << TEMP_COUNTS.at(0) << "," << TEMP_COUNTS.at(1) << "," << TEMP_COUNTS.at(2) << "\n";
+	print<DEBUG_MODE>("Loading the cascade files");
+	const CascadeClassifier FACE_HAAR_CASCADE = loadCascade<DEBUG_MODE>(FACE_HAAR_CASCADE_FILENAME);
+	const CascadeClassifier FACE_LBP_CASCADE = loadCascade<DEBUG_MODE>(FACE_LBP_CASCADE_FILENAME);
+	const CascadeClassifier LEFT_EYE_CASCADE = loadCascade<DEBUG_MODE>(LEFT_CASCADE_FILENAME);
+	const CascadeClassifier RIGHT_EYE_CASCADE = loadCascade<DEBUG_MODE>(RIGHT_CASCADE_FILENAME);
+	const CascadeClassifier EYE_GLASS_CASCADE = loadCascade<DEBUG_MODE>(GLASS_CASCADE_FILENAME);
+	MultiCascade shared_eye_cascades = loadMultiCascade<DEBUG_MODE>({LEFT_CASCADE_FILENAME, RIGHT_CASCADE_FILENAME, GLASS_CASCADE_FILENAME});
+
+	// Checking the shared eye search against the eye cascades instead of running the detection
+	if (CONFIG.CHECK_EYE_SEARCH > 0) {
+		const unique_ptr<ImageSource> IMAGES = openImageSource(CONFIG);
+		return checkEyeSearch<DEBUG_MODE>(*IMAGES, FACE_HAAR_CASCADE, LEFT_EYE_CASCADE, RIGHT_EYE_CASCADE, EYE_GLASS_CASCADE, shared_eye_cascades, CONFIG) ? 0 : 1;
+	}
+
+	// Running the detection on the frames of a video instead of the dataset
+	if (!CONFIG.VIDEO_PATH.empty()) {
+		return runVideo<DEBUG_MODE>(FACE_HAAR_CASCADE, FACE_LBP_CASCADE, LEFT_EYE_CASCADE, RIGHT_EYE_CASCADE, EYE_GLASS_CASCADE, shared_eye_cascades, CONFIG) ? 0 : 1;
+	}
+
+	// Comparing the eye search strategies on the same set of images without writing the csv file
+	if (CONFIG.COMPARE_EYE_SEARCH) {
+		cout << endl;
+		printMetricsHeader("Eye search");
+		for (const EyeSearch EYE_SEARCH : {EyeSearch::CASCADE, EyeSearch::SHARED, EyeSearch::GEOMETRY}) {
+			Config config = CONFIG;
+			config.EYE_SEARCH = EYE_SEARCH;
+			// A source preset would replace the strategy being measured for its images, and the caches would serve a strategy from what an earlier one stored
+			config.SOURCE_PRESETS.clear();
+			const unique_ptr<ImageSource> IMAGES = openImageSource(CONFIG);
+			const RunSummary SUMMARY = runDataset(*IMAGES, FACE_HAAR_CASCADE, FACE_LBP_CASCADE, LEFT_EYE_CASCADE, RIGHT_EYE_CASCADE, EYE_GLASS_CASCADE, shared_eye_cascades, config, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
+			logger().flush();
+			printMetricsRow(eyeSearchName(EYE_SEARCH), SUMMARY.images / SUMMARY.seconds, SUMMARY.confusionMatrix());
 		}
-		else {
-			ground_truth_no_masks += faces;
-			TEMP_COUNTS = maskDetection(FILE_PATH, faces, FACE_HAAR_CASCADE, FACE_LBP_CASCADE, LEFT_EYE_CASCADE, RIGHT_EYE_CASCADE, EYE_GLASS_CASCADE, DEBUG_MODE);
-			not_masked_counts.at(0) += TEMP_COUNTS.at(0);
-			not_masked_counts.at(1) += TEMP_COUNTS.at(1);
-			not_masked_counts.at(2) += TEMP_COUNTS.at(2);
-			not_masked_counts.at(3) += TEMP_COUNTS.at(3);
-			output << FILE_TYPE << "," << image_id << "," << faces << "," << TEMP_COUNTS.at(3) << "," << TEMP_COUNTS.at(0) << "," << TEMP_COUNTS.at(1) << "," << TEMP_COUNTS.at(2) << "\n";
+		return 0;
+	}
+
+	// Comparing the presets on the same set of images without writing the csv file
+	if (CONFIG.BENCHMARK_PRESETS) {
+		cout << endl;
+		printMetricsHeader("Preset");
+		for (auto &preset: PRESET_NAMES) {
+			Config config = CONFIG;
+			applyPreset(preset, config);
+			config.SOURCE_PRESETS.clear();
+			// Every preset is timed without the caches, so no preset is served from what an earlier one or an earlier invocation stored
+			const unique_ptr<ImageSource> IMAGES = openImageSource(CONFIG);
+			const RunSummary SUMMARY = runDataset(*IMAGES, FACE_HAAR_CASCADE, FACE_LBP_CASCADE, LEFT_EYE_CASCADE, RIGHT_EYE_CASCADE, EYE_GLASS_CASCADE, shared_eye_cascades, config, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr, nullptr);
+			logger().flush();
+			printMetricsRow(preset, SUMMARY.images / SUMMARY.seconds, SUMMARY.confusionMatrix());
 		}
+		return 0;
 	}
 
-	// Printing the final counts
+	// Keeping the decoded and pre-processed images between runs, if enabled
+	const unique_ptr<PixelCache> pixel_cache = CONFIG.PIXEL_CACHE_PATH.empty() ? nullptr : make_unique<PixelCache>(CONFIG.PIXEL_CACHE_PATH);
+	// Keeping the per face results between runs, keyed by the images and by the cascades and parameters, if enabled
+	const unique_ptr<ResultCache> result_cache = CONFIG.RESULT_CACHE_PATH.empty() ? nullptr : make_unique<ResultCache>(CONFIG.RESULT_CACHE_PATH, size_t(CONFIG.RESULT_CACHE_SIZE), CASCADE_FILENAMES);
+	// Keeping the results of every stage between runs, so a run with changed parameters only recomputes the stages they affect, if enabled
+	const unique_ptr<StageStore> stages = CONFIG.STAGE_STORE_PATH.empty() ? nullptr : make_unique<StageStore>(CONFIG.STAGE_STORE_PATH, vector<string>{FACE_HAAR_CASCADE_FILENAME, FACE_LBP_CASCADE_FILENAME}, vector<string>{LEFT_CASCADE_FILENAME, RIGHT_CASCADE_FILENAME, GLASS_CASCADE_FILENAME});
+
+	// Loading the file to store the detection results for all images, either as csv rows or as columnar results written in the background
+	// Resuming from the checkpoint drops the csv rows written after it and appends to the rest
+	unique_ptr<Checkpoint> checkpoint;
+	bool resumed = false;
+	if (!CONFIG.CHECKPOINT_PATH.empty()) {
+		checkpoint = make_unique<Checkpoint>(CONFIG.CHECKPOINT_PATH, CONFIG.CHECKPOINT_EVERY);
+		resumed = CONFIG.RESUME && checkpoint->resume();
+		if (CONFIG.RESUME && !resumed) {
+			logger().log(LogLevel::WARNING, "checkpoint_missing", CONFIG.CHECKPOINT_PATH);
+		}
+		if (resumed) {
+			// The csv header is written before any checkpoint, so a checkpoint covering no csv bytes is corrupt rather than a reason to empty the file
+			error_code error;
+			if (checkpoint->restoredCsvSize() == 0 || filesystem::file_size(CONFIG.OUTPUT_PATH, error) < checkpoint->restoredCsvSize() || error) {
+				logger().log(LogLevel::ERROR, "checkpoint_csv_mismatch", CONFIG.OUTPUT_PATH);
+				return 1;
+			}
+			filesystem::resize_file(CONFIG.OUTPUT_PATH, checkpoint->restoredCsvSize());
+		}
+		if (!checkpoint->start(resumed)) {
+			return 1;
+		}
+	}
+	ofstream output;
+	unique_ptr<ResultsWriter> results;
+	if (CONFIG.RESULTS_PATH.empty()) {
+		output.open(CONFIG.OUTPUT_PATH, resumed ? ofstream::app : ofstream::trunc);
+		if (!resumed) {
+			writeCsvHeader(output, CONFIG.DEDUP);
+		}
+	}
+	else {
+		results = make_unique<ResultsWriter>(CONFIG.RESULTS_PATH);
+	}
+
+	// Annotating the sampled images on the encoder threads while the run goes on
+	AnnotationWriter annotations(CONFIG.ANNOTATION_PATH, CONFIG.ANNOTATION_SAMPLING, CONFIG.ANNOTATION_EVERY);
+	// Reading the image list from the manifest, or walking the dataset in the background so the first image is processed as soon as it is found
+	print<DEBUG_MODE>("Loading the file names");
+	const unique_ptr<ImageSource> IMAGES = openImageSource(CONFIG);
+	// Listing every image up front and producing a stratified random sample of them instead, when sampling
+	const unique_ptr<StratifiedSampler> sampler = CONFIG.SAMPLE_CI > 0 ? make_unique<StratifiedSampler>(*IMAGES, CONFIG) : nullptr;
+	const RunSummary SUMMARY = runDataset(sampler != nullptr ? *sampler : *IMAGES, FACE_HAAR_CASCADE, FACE_LBP_CASCADE, LEFT_EYE_CASCADE, RIGHT_EYE_CASCADE, EYE_GLASS_CASCADE, shared_eye_cascades, CONFIG, results == nullptr ? &output : nullptr, results.get(), &annotations, pixel_cache.get(), result_cache.get(), stages.get(), checkpoint.get(), sampler.get());
+	annotations.finish();
+	if (result_cache != nullptr) {
+		result_cache->save();
+	}
+	if (results != nullptr && !results->finish()) {
+		return 1;
+	}
+
+	// Printing the final counts after the log records of the run
+	logger().flush();
 	cout << endl;
-	cout << "Number of Masked faces: " << ground_truth_masks << endl;
-	cout << "Detected Masked faces: " << masked_counts.at(1) << endl;
-	cout << "Detected Non-masked faces: " << masked_counts.at(2) << endl;
-	cout << "Skipped Faces due to eye detection issue: " << masked_counts.at(0) << endl;
-	cout << "Skipped Faces due to face detection issue: " << masked_counts.at(3) << endl;
+	cout << "Number of Masked faces: " << SUMMARY.ground_truth_masks << endl;
+	cout << "Detected Masked faces: " << SUMMARY.masked_counts.masked << endl;
+	cout << "Detected Non-masked faces: " << SUMMARY.masked_counts.not_masked << endl;
+	cout << "Skipped Faces due to eye detection issue: " << SUMMARY.masked_counts.eyes_skipped << endl;
+	cout << "Skipped Faces due to face detection issue: " << SUMMARY.masked_counts.faces_skipped << endl;
 
 	cout << endl;
-	cout << "Number of Non-masked faces: " << ground_truth_no_masks << endl;
-	cout << "Detected Masked faces: " << not_masked_counts.at(1) << endl;
-	cout << "Detected Non-masked faces: " << not_masked_counts.at(2) << endl;
-	cout << "Skipped Faces due to eye detection issue: " << not_masked_counts.at(0) << endl;
-	cout << "Skipped Faces due to face detection issue: " << not_masked_counts.at(3) << endl;
+	cout << "Number of Non-masked faces: " << SUMMARY.ground_truth_no_masks << endl;
+	cout << "Detected Masked faces: " << SUMMARY.not_masked_counts.masked << endl;
+	cout << "Detected Non-masked faces: " << SUMMARY.not_masked_counts.not_masked << endl;
+	cout << "Skipped Faces due to eye detection issue: " << SUMMARY.not_masked_counts.eyes_skipped << endl;
+	cout << "Skipped Faces due to face detection issue: " << SUMMARY.not_masked_counts.faces_skipped << endl;
+
+	// Listing the images left out of the counts
+	if (!SUMMARY.quarantined.empty()) {
+		ofstream quarantine(CONFIG.QUARANTINE_PATH, ofstream::trunc);
+		for (auto &path: SUMMARY.quarantined) {
+			quarantine << path << "\n";
+		}
+		cout << endl;
+		cout << "Quarantined images: " << SUMMARY.quarantined.size() << " (listed in " << CONFIG.QUARANTINE_PATH << ")" << endl;
+	}
+
+	// Reporting the masked face rate estimated from the sample, with its interval and the rate within every stratum
+	if (sampler != nullptr) {
+		const RateEstimate ESTIMATE = sampler->estimate();
+		cout << endl;
+		cout << "Sampled images: " << sampler->sampledCount() << " of " << sampler->populationCount() << endl;
+		cout << "Masked face rate: " << fixed << setprecision(1) << 100 * ESTIMATE.rate << "% +/- " << 100 * ESTIMATE.half_width << "% at "
+		     << setprecision(0) << 100 * CONFIG.SAMPLE_CONFIDENCE << "% confidence" << endl;
+		cout.unsetf(ios::fixed);
+		cout << setprecision(6);
+		sampler->printStrata();
+	}
+
+	if (CONFIG.DEADLINE_MS > 0 && !SUMMARY.latencies_ms.empty()) {
+		vector<float> latencies = SUMMARY.latencies_ms;
+		sort(latencies.begin(), latencies.end());
+		const auto PERCENTILE = [&latencies](const double P) { return latencies[min(latencies.size() - 1, size_t(P * latencies.size()))]; };
+		cout << endl;
+		cout << "Degraded images: " << SUMMARY.degraded << endl;
+		cout << "Images over the deadline: " << SUMMARY.over_deadline << endl;
+		cout << "Latency p50: " << PERCENTILE(0.5) << " ms, p99: " << PERCENTILE(0.99) << " ms, max: " << latencies.back() << " ms" << endl;
+	}
+
+	if (CONFIG.DEDUP) {
+		cout << endl;
+		cout << "Results reused from near-duplicate images: " << SUMMARY.reused << endl;
+	}
+
+	if (pixel_cache != nullptr) {
+		cout << endl;
+		cout << "Pixel cache hits: " << pixel_cache->hitCount() << endl;
+		cout << "Pixel cache misses: " << pixel_cache->missCount() << endl;
+	}
+
+	if (result_cache != nullptr) {
+		const long long LOOKUPS = result_cache->hitCount() + result_cache->missCount();
+		cout << endl;
+		cout << "Result cache hits: " << result_cache->hitCount() << " (" << (LOOKUPS == 0 ? 0 : 100 * result_cache->hitCount() / LOOKUPS) << "%)" << endl;
+		cout << "Result cache misses: " << result_cache->missCount() << endl;
+		cout << "Result cache evictions: " << result_cache->evictionCount() << endl;
+	}
+
+	if (stages != nullptr) {
+		cout << endl;
+		cout << "Stored face stage hits: " << stages->hitCount(FACE_STAGE) << ", misses: " << stages->missCount(FACE_STAGE) << endl;
+		cout << "Stored eye stage hits: " << stages->hitCount(EYE_STAGE) << ", misses: " << stages->missCount(EYE_STAGE) << endl;
+		cout << "Stored skin stage hits: " << stages->hitCount(SKIN_STAGE) << ", misses: " << stages->missCount(SKIN_STAGE) << endl;
+	}
+
+	if (CONFIG.ALLOCATION_REPORT || CONFIG.ALLOCATION_CHECK > 0) {
+		cout << endl;
+		cout << "Mat allocations: " << pooledMatAllocator().allocationCount() << endl;
+		cout << "Heap allocations by the Mat pool: " << pooledMatAllocator().heapAllocationCount() << endl;
+		cout << "Images after the first " << ALLOCATION_WARM_UP_IMAGES << " (warm-up): " << SUMMARY.warm_images << endl;
+		cout << "Heap allocations by the Mat pool on the detection thread over these images: " << SUMMARY.warm_heap_allocations << endl;
+		cout << "Calls to operator new on the detection thread over these images: " << SUMMARY.warm_new_calls << endl;
+		cout << "Calls to operator new inside OpenCV's decoding and cascade scans over these images (not checked): " << SUMMARY.warm_library_new_calls << endl;
+	}
+	// The check fails if the dataset was too small to cover its images, or if any of them allocated from the heap
+	if (CONFIG.ALLOCATION_CHECK > 0 && (SUMMARY.warm_images < CONFIG.ALLOCATION_CHECK || SUMMARY.warm_heap_allocations > 0 || SUMMARY.warm_new_calls > 0)) {
+		logger().log(LogLevel::ERROR, "allocation_check_failed", CONFIG.DIRECTORY_PATH, SUMMARY.warm_heap_allocations + SUMMARY.warm_new_calls, true);
+		return 1;
+	}
 
 	return 0;
 }